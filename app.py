@@ -2,9 +2,11 @@ import pandas as pd
 import matplotlib.pyplot as plt
 from flask import Flask, render_template, send_file, request, jsonify
 import os
+import io
 import json
 # import joblib
 import subprocess
+import socket
 
 plt.switch_backend('Agg')
 app = Flask(__name__)
@@ -12,12 +14,34 @@ app = Flask(__name__)
 # Load the trained model
 # model = joblib.load('crop_prediction_model.pkl')
 
-def generate_plot():
-    df = pd.read_csv("sensor_data.csv")
+# Seconds of sensor history shown on the dashboard plot, and the number of points it is drawn with
+PLOT_WINDOW = 3600
+PLOT_POINTS = 300
+
+def read_sensor_data(window=PLOT_WINDOW):
+    # A fixed number of points from chms's rollups, whatever the window: a month costs the same as a minute
+    try:
+        result = subprocess.run(['./tsdb', 'query', '--last', str(window), '--points', str(PLOT_POINTS)],
+                                capture_output=True, text=True)
+        if result.returncode == 0:
+            df = pd.read_csv(io.StringIO(result.stdout))
+            df.index = pd.to_datetime(df['time'], unit='ms')
+            return df.rename(columns={'soil_moisture_mean': 'soil_moisture_level', 'ph_mean': 'ph_level'})
+    except OSError:
+        pass
+    # Logs written with `./chms --csv-log`, which have no timestamps
+    return pd.read_csv("sensor_data.csv")
+
+def generate_plot(window=PLOT_WINDOW):
+    df = read_sensor_data(window)
 
     plt.figure(figsize=(6, 4))
     plt.plot(df.index, df['soil_moisture_level'], label = 'Soil Moisture Level')
     plt.plot(df.index, df['ph_level'], label = 'PH Level')
+    if 'soil_moisture_min' in df:
+        # Range of the readings behind each point
+        plt.fill_between(df.index, df['soil_moisture_min'], df['soil_moisture_max'], alpha=0.2)
+        plt.fill_between(df.index, df['ph_min'], df['ph_max'], alpha=0.2)
     plt.xlabel('Time')
     plt.ylabel('Value')
     plt.legend()
@@ -33,22 +57,55 @@ def generate_plot():
 #     generate_plot()
 #     return render_template("index.html")
 
+def read_status():
+    # A consistent snapshot of chms's live levels from shared memory
+    try:
+        result = subprocess.run(['./status', '--json'], capture_output=True, text=True)
+        if result.returncode == 0:
+            return json.loads(result.stdout)
+    except OSError:
+        pass
+    # Written by `./chms --json-status`
+    with open('data.json') as f:
+        return json.load(f)
+
 @app.route('/')
 def index():
-    with open('data.json') as f:
-        data = json.load(f)
+    data = read_status()
     generate_plot()
     return render_template('index.html', data=data)
 
 @app.route('/plot.png')
 def plot_png():
-    plot_filename = generate_plot()
+    # ?window=<seconds> plots a longer or shorter history
+    plot_filename = generate_plot(request.args.get('window', PLOT_WINDOW, type=int))
     return send_file(plot_filename, mimetype='image/png')
 
 # @app.route('/')
 # def index():
 #     return render_template('crop_prediction.html')
 
+# Socket of the resident predictor started with `./predict --serve`
+PREDICT_SOCKET = 'crop_predict.sock'
+
+def predict_crop(instance_data):
+    # Ask the resident predictor over its socket (one JSON line each way)
+    request_line = json.dumps(instance_data) + '\n'
+    try:
+        with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as client:
+            client.settimeout(5)
+            client.connect(PREDICT_SOCKET)
+            client.sendall(request_line.encode('utf-8'))
+            response = client.makefile('r').readline()
+        return json.loads(response).get('predicted_crop', 'Prediction failed')
+    except (OSError, ValueError, AttributeError):
+        # No predictor running: score this one instance with a one-off batch run, fed on stdin
+        result = subprocess.run(['./predict', '--batch', '-'], input=request_line, capture_output=True, text=True)
+        try:
+            return json.loads(result.stdout.splitlines()[0]).get('predicted_crop', 'Prediction failed')
+        except (IndexError, ValueError):
+            return 'Prediction failed'
+
 @app.route('/predict', methods=['GET', 'POST'])
 def predict():
     if request.method == 'POST':
@@ -72,22 +129,8 @@ def predict():
             'rainfall': rainfall
         }
 
-        # Write the data to a JSON file
-        with open('instance.json', 'w') as f:
-            json.dump(instance_data, f)
-
-        # Compile and execute the C++ program
-        cpp_file = 'predict.cpp'
-        executable_file = cpp_file[:-4]  # Remove .cpp extension
-        compile_command = f"g++ {cpp_file} -o {executable_file}"
-        subprocess.run(compile_command, shell=True)
-
-        # Run the compiled C++ program in a subprocess
-        terminal_command = f"./{executable_file}"
-        result = subprocess.run(terminal_command, capture_output=True, text=True)
-
-        # Parse the result from C++ program output
-        predicted_crop = result.stdout.strip()  # Assuming C++ program outputs the predicted crop
+        # Get the prediction from the resident C++ predictor
+        predicted_crop = predict_crop(instance_data)
 
         # Return the predicted crop as JSON response
         # return jsonify({'predicted_crop': predicted_crop})
@@ -104,15 +147,40 @@ with open('price_avg.csv', 'r') as f:
         crop_name, _ = line.strip().split(',')
         crop_names.add(crop_name)
 
+# Socket of the resident price lookup started with `./profit_predict --serve`
+PROFIT_SOCKET = 'crop_profit.sock'
+
+def crop_profits(names):
+    # Statistics of any number of crops ('*' for all) in one request: {crop: {"mean": ..., ...} or None}
+    request_line = ','.join(names) + '\n'
+    try:
+        with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as client:
+            client.settimeout(5)
+            client.connect(PROFIT_SOCKET)
+            client.sendall(request_line.encode('utf-8'))
+            return json.loads(client.makefile('r').readline())
+    except (OSError, ValueError):
+        # No lookup service running: answer this one request with a one-off batch run, fed on stdin
+        result = subprocess.run(['./profit_predict', '--batch', '-'], input=request_line, capture_output=True, text=True)
+        try:
+            return json.loads(result.stdout.splitlines()[0])
+        except (IndexError, ValueError):
+            return {}
+
 @app.route('/profit', methods=['GET', 'POST'])
 def profit():
     if request.method == 'POST':
         crop_name = request.form['crop_name']
-        # Run the C++ program with the selected crop name
-        output = subprocess.check_output(['./profit_predict', crop_name])
-        return render_template('crop_profit.html', output=output.decode('utf-8'))
+        stats = crop_profits([crop_name]).get(crop_name)
+        output = f"{crop_name}: {stats['mean']:g}" if stats else f"Crop not found: {crop_name}"
+        return render_template('crop_profit.html', output=output)
     return render_template('crop_profit.html', crop_names=crop_names)
 
+@app.route('/profits')
+def profits():
+    # Every crop's profit statistics in one call, for dashboards
+    return jsonify(crop_profits(['*']))
+
 if __name__ == '__main__':
     if not os.path.exists('static'):
         os.makedirs('static')
@@ -0,0 +1,360 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <filesystem>
+#include <functional>
+#include <sstream>
+#include <iomanip>
+#include <thread>
+#include <nlohmann/json.hpp>
+#include "decision_tree.h"
+#include "predictor.h"
+
+using json = nlohmann::json;
+using namespace std;
+
+// crop names used for the first synthetic classes; further classes are called crop22, crop23, ...
+const vector<string> CROP_NAMES = {
+    "rice", "maize", "chickpea", "kidneybeans", "pigeonpeas", "mothbeans", "mungbean", "blackgram", "lentil",
+    "pomegranate", "banana", "mango", "grapes", "watermelon", "muskmelon", "apple", "orange", "papaya", "coconut",
+    "cotton", "jute", "coffee"
+};
+
+// Crop_recommendation.csv attributes with the range of values they take in the real data.
+struct AttributeRange {
+    string name;
+    double low;
+    double high;
+};
+
+const vector<AttributeRange> ATTRIBUTE_RANGES = {
+    {"N", 0, 140}, {"P", 5, 145}, {"K", 5, 205}, {"temperature", 8, 44}, {"humidity", 14, 100},
+    {"ph", 3.5, 9.9}, {"rainfall", 20, 300}
+};
+
+const int BASE_ROWS = 2200;     // rows of Crop_recommendation.csv, the 1x scale.
+
+/*
+`SyntheticDataset` writes CSV files with the schema of Crop_recommendation.csv. Every class gets a random centre per
+attribute and rows are drawn around the centre of their class, so the data has learnable structure like the real
+file. `cardinality` > 0 rounds every attribute onto that many evenly spaced values (fewer distinct values make
+cheaper splits); 0 keeps full precision. The same seed always produces the same file.
+*/
+class SyntheticDataset {
+public:
+    SyntheticDataset(int classCount, int cardinality, unsigned seed)
+        : classCount(classCount), cardinality(cardinality), random(seed) {
+        for (int c = 0; c < classCount; c++) {
+            vector<double> centre;
+            for (const AttributeRange& range : ATTRIBUTE_RANGES) {
+                centre.push_back(uniform_real_distribution<double>(range.low, range.high)(random));
+            }
+            centres.push_back(centre);
+        }
+    }
+
+    // write(): `rowCount` rows to `path`; the first `keepCount` rows are also returned as attribute strings.
+    bool write(const string& path, int rowCount, int keepCount, vector<vector<string>>& kept) {
+        ofstream fout(path, ios::binary);
+        fout << "N,P,K,temperature,humidity,ph,rainfall,label\n";
+        kept.clear();
+        string line;
+        vector<string> fields(ATTRIBUTE_RANGES.size());
+        for (int i = 0; i < rowCount; i++) {
+            int c = i % classCount;
+            line.clear();
+            for (int j = 0; j < ATTRIBUTE_RANGES.size(); j++) {
+                fields[j] = value(j, centres[c][j]);
+                line += fields[j];
+                line += ',';
+            }
+            line += className(c);
+            line += '\n';
+            fout << line;
+            if (i < keepCount) {
+                kept.push_back(fields);
+            }
+        }
+        fout.close();
+        return (bool)fout;
+    }
+
+private:
+    int classCount;
+    int cardinality;
+    mt19937 random;
+    normal_distribution<double> normal{0.0, 1.0};
+    vector<vector<double>> centres;     // centres[c][j]: centre of class c on attribute j.
+
+    string value(int attr, double centre) {
+        const AttributeRange& range = ATTRIBUTE_RANGES[attr];
+        double width = range.high - range.low;
+        double x = normal(random) * width * 0.08 + centre;
+        x = min(range.high, max(range.low, x));
+        ostringstream text;
+        if (cardinality > 1) {
+            double step = width / (cardinality - 1);
+            text << setprecision(10) << range.low + round((x - range.low) / step) * step;
+        } else {
+            text << setprecision(10) << x;
+        }
+        return text.str();
+    }
+
+    static string className(int c) {
+        return c < CROP_NAMES.size() ? CROP_NAMES[c] : "crop" + to_string(c);
+    }
+};
+
+/*
+`Timings` holds the samples of one measured stage in milliseconds and summarizes them. Percentiles are nearest-rank,
+so with few samples p99 is the slowest one.
+*/
+class Timings {
+public:
+    vector<double> samples;
+
+    double percentile(double p) const {
+        if (samples.empty()) {
+            return 0.0;
+        }
+        vector<double> sorted = samples;
+        sort(sorted.begin(), sorted.end());
+        size_t rank = (size_t)ceil(p / 100.0 * sorted.size());
+        return sorted[min(sorted.size() - 1, rank == 0 ? 0 : rank - 1)];
+    }
+
+    double mean() const {
+        double sum = 0.0;
+        for (double sample : samples) {
+            sum += sample;
+        }
+        return samples.empty() ? 0.0 : sum / samples.size();
+    }
+};
+
+// milliseconds taken by one call of `work`.
+double timeMs(const function<void()>& work) {
+    auto start = chrono::steady_clock::now();
+    work();
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+/*
+`Benchmark` runs every stage of the pipeline on one synthetic dataset per scale: CSV parsing (`InputReader`), tree
+construction (`DecisionTree`), JSON serialization (`serializeTreeToJson()` plus `dump(4)`, as decision.cpp writes
+it), model loading as predict.cpp does it (binary and JSON) and the latency of single-row `Predictor::predict()`
+calls. Whole stages are repeated `repeat` times; prediction latency is sampled per row. Results are printed as a
+table and collected as JSON.
+*/
+class Benchmark {
+public:
+    vector<int> scales = {1, 10, 100, 1000};
+    int classCount = 22;
+    int cardinality = 1000;
+    int repeat = 5;
+    int predictRows = 10000;        // rows whose prediction latency is sampled.
+    int threadCount = 1;            // InputReader and DecisionTree threads.
+    unsigned seed = 42;
+    json results = json::array();
+
+    bool run() {
+        filesystem::path directory = filesystem::temp_directory_path() / ("crop_bench_" + to_string(seed));
+        filesystem::create_directories(directory);
+        string csvPath = (directory / "data.csv").string();
+        string jsonPath = (directory / "model.json").string();
+        string binaryPath = (directory / "model.bin").string();
+
+        cout << left << setw(8) << "scale" << setw(10) << "rows" << setw(14) << "stage" << right << setw(8) << "n"
+             << setw(12) << "p50 ms" << setw(12) << "p99 ms" << setw(12) << "mean ms" << "\n";
+        for (int scale : scales) {
+            int rowCount = BASE_ROWS * scale;
+            SyntheticDataset dataset(classCount, cardinality, seed);
+            vector<vector<string>> instances;
+            if (!dataset.write(csvPath, rowCount, predictRows, instances)) {
+                cerr << csvPath << " could not be written\n";
+                return false;
+            }
+
+            Timings parse;
+            for (int r = 0; r < repeat; r++) {
+                parse.samples.push_back(timeMs([&] { InputReader reader(csvPath, threadCount); }));
+            }
+            InputReader reader(csvPath, threadCount);
+            const Table& table = reader.getTable();
+            report(scale, rowCount, "parse", parse);
+
+            Timings train;
+            unique_ptr<DecisionTree> tree;
+            TreeOptions options;
+            options.threadCount = threadCount;
+            for (int r = 0; r < repeat; r++) {
+                tree.reset();
+                train.samples.push_back(timeMs([&] { tree.reset(new DecisionTree(table, options)); }));
+            }
+            report(scale, rowCount, "train", train, {{"nodes", tree->tree.size()}});
+
+            Timings serialize;
+            string text;
+            for (int r = 0; r < repeat; r++) {
+                serialize.samples.push_back(timeMs([&] { text = tree->serializeTreeToJson().dump(4); }));
+            }
+            report(scale, rowCount, "serialize", serialize, {{"bytes", text.size()}});
+            ofstream(jsonPath) << text;
+            tree->serializeTreeToBinary(binaryPath);
+
+            Timings loadBinary;
+            Timings loadJson;
+            Predictor predictor;
+            for (int r = 0; r < repeat; r++) {
+                loadBinary.samples.push_back(timeMs([&] { predictor.loadBinary(binaryPath); }));
+                loadJson.samples.push_back(timeMs([&] { predictor.loadJson(jsonPath); }));
+            }
+            report(scale, rowCount, "load_binary", loadBinary);
+            report(scale, rowCount, "load_json", loadJson);
+
+            Timings predict;
+            size_t matched = 0;
+            for (const vector<string>& instance : instances) {
+                auto start = chrono::steady_clock::now();
+                int label = predictor.predictLabel(instance);
+                predict.samples.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+                matched += label != Predictor::FAILED;
+            }
+            report(scale, rowCount, "predict_row", predict, {{"predicted", matched}});
+        }
+        filesystem::remove_all(directory);
+        return true;
+    }
+
+private:
+    void report(int scale, int rowCount, const string& stage, const Timings& timings, json extra = json::object()) {
+        cout << left << setw(8) << (to_string(scale) + "x") << setw(10) << rowCount << setw(14) << stage << right
+             << setw(8) << timings.samples.size() << fixed << setprecision(4) << setw(12) << timings.percentile(50)
+             << setw(12) << timings.percentile(99) << setw(12) << timings.mean() << defaultfloat << "\n";
+        json result = {
+            {"scale", scale}, {"rows", rowCount}, {"stage", stage}, {"samples", timings.samples.size()},
+            {"p50_ms", timings.percentile(50)}, {"p99_ms", timings.percentile(99)}, {"mean_ms", timings.mean()}
+        };
+        result.update(extra);
+        results.push_back(result);
+    }
+};
+
+// parseScales(): "1,10,100" -> {1, 10, 100}.
+vector<int> parseScales(const string& text) {
+    vector<int> scales;
+    stringstream ss(text);
+    string item;
+    while (getline(ss, item, ',')) {
+        scales.push_back(max(1, stoi(item)));
+    }
+    return scales;
+}
+
+/*
+compareWithBaseline(): prints every stage whose p50 grew by more than `tolerance` (a fraction) against the same scale
+and stage in an earlier --json output, and returns the number of such regressions.
+*/
+int compareWithBaseline(const json& results, const json& baseline, double tolerance) {
+    int regressions = 0;
+    for (const json& result : results) {
+        for (const json& before : baseline["results"]) {
+            if (before["scale"] != result["scale"] || before["stage"] != result["stage"]) {
+                continue;
+            }
+            double old = before["p50_ms"];
+            double now = result["p50_ms"];
+            if (old > 0 && now > old * (1.0 + tolerance)) {
+                cout << "REGRESSION " << result["scale"].get<int>() << "x " << result["stage"].get<string>()
+                     << ": p50 " << old << " ms -> " << now << " ms\n";
+                regressions++;
+            }
+        }
+    }
+    return regressions;
+}
+
+/*
+main program times training and inference on synthetic datasets scaled from 1x to 1000x the rows of
+Crop_recommendation.csv, prints a table and optionally writes the results as JSON for comparison across commits.
+*/
+int main(int argc, char* argv[]) {
+    Benchmark benchmark;
+    string jsonPath;            // --json <file>: machine-readable results.
+    string baselinePath;        // --baseline <file>: earlier --json output to check for regressions.
+    string tag;                 // --tag <text>: recorded in the JSON, e.g. a commit id.
+    double tolerance = 0.2;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--scales" && i + 1 < argc) {
+            benchmark.scales = parseScales(argv[++i]);
+        } else if (arg == "--classes" && i + 1 < argc) {
+            benchmark.classCount = max(1, stoi(argv[++i]));
+        } else if (arg == "--cardinality" && i + 1 < argc) {
+            benchmark.cardinality = max(0, stoi(argv[++i]));
+        } else if (arg == "--repeat" && i + 1 < argc) {
+            benchmark.repeat = max(1, stoi(argv[++i]));
+        } else if (arg == "--predict-rows" && i + 1 < argc) {
+            benchmark.predictRows = max(1, stoi(argv[++i]));
+        } else if (arg == "--threads" && i + 1 < argc) {
+            benchmark.threadCount = stoi(argv[++i]);
+            if (benchmark.threadCount <= 0) {
+                benchmark.threadCount = max(1, (int)thread::hardware_concurrency());
+            }
+        } else if (arg == "--seed" && i + 1 < argc) {
+            benchmark.seed = (unsigned)stoul(argv[++i]);
+        } else if (arg == "--json" && i + 1 < argc) {
+            jsonPath = argv[++i];
+        } else if (arg == "--baseline" && i + 1 < argc) {
+            baselinePath = argv[++i];
+        } else if (arg == "--tolerance" && i + 1 < argc) {
+            tolerance = stod(argv[++i]);
+        } else if (arg == "--tag" && i + 1 < argc) {
+            tag = argv[++i];
+        } else {
+            cerr << "Usage: " << argv[0] << " [--scales 1,10,100,1000] [--classes C] [--cardinality K] [--repeat R]"
+                 << " [--predict-rows N] [--threads N] [--seed s] [--json <file>] [--tag <text>]"
+                 << " [--baseline <file> [--tolerance 0.2]]\n";
+            return 1;
+        }
+    }
+
+    if (!benchmark.run()) {
+        return 1;
+    }
+
+    json output = {
+        {"tag", tag},
+        {"config", {
+            {"scales", benchmark.scales}, {"classes", benchmark.classCount}, {"cardinality", benchmark.cardinality},
+            {"repeat", benchmark.repeat}, {"predict_rows", benchmark.predictRows}, {"threads", benchmark.threadCount},
+            {"seed", benchmark.seed}
+        }},
+        {"results", benchmark.results}
+    };
+    if (!jsonPath.empty()) {
+        ofstream fout(jsonPath);
+        fout << output.dump(2) << "\n";
+        fout.close();
+        if (!fout) {
+            cerr << jsonPath << " could not be written\n";
+            return 1;
+        }
+    }
+
+    if (!baselinePath.empty()) {
+        ifstream fin(baselinePath);
+        json baseline = json::parse(fin, nullptr, false);
+        if (!baseline.is_object() || !baseline.contains("results")) {
+            cerr << baselinePath << " is not a benchmark result file\n";
+            return 1;
+        }
+        return compareWithBaseline(benchmark.results, baseline, tolerance) == 0 ? 0 : 1;
+    }
+    return 0;
+}
@@ -1,100 +1,161 @@
 #include <iostream>
 #include <fstream>
 #include <chrono>
+#include <csignal>
+#include <thread>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <atomic>
+#include <random>
+#include <cstdlib>
+#include <filesystem>
+#include "event_scheduler.h"
+#include "fleet.h"
+#include "ingest.h"
+#include "log_writer.h"
+#include "rule_engine.h"
+#include "status_shm.h"
+
+#ifdef _WIN32
 #include <windows.h>
+#endif
+
+// How often each part of the simulation runs.
+const std::chrono::seconds SENSOR_PERIOD(1);            // soil moisture decay and sensor logging.
+const std::chrono::seconds PH_DECAY_PERIOD(3);          // pH decay.
+const std::chrono::seconds HEALTH_CHECK_PERIOD(1);      // threshold checks.
+const std::chrono::seconds IRRIGATION_TIME(3);          // how long the irrigation system runs.
+const std::chrono::seconds FERTILIZER_TIME(5);          // how long fertilizers are sprayed.
+const std::chrono::milliseconds SHUTDOWN_POLL(200);     // how often the event loop checks for SIGINT/SIGTERM.
+const std::chrono::hours SIMULATED_SHUTDOWN_POLL(1);    // the same, in simulated time.
+
+volatile std::sig_atomic_t shutdownRequested = 0;
+
+void requestShutdown(int) {
+    shutdownRequested = 1;
+}
+
+// Rules used when there is no alert_rules.conf: the original fixed thresholds, with some hysteresis.
+const char* const DEFAULT_ALERT_RULES =
+    "dry     moisture  below  30  35  0  alarm,irrigate\n"
+    "acidic  ph        below  4   5   0  alarm,fertilize\n";
+
+// soundAlarm(): audible alert; it runs on the action queue's thread, so it does not hold up the monitoring loop.
+void soundAlarm() {
+#ifdef _WIN32
+    Beep(2500, 1000);
+    // PlaySound(TEXT("soilMoisture.mp3"), NULL, SND_ASYNC);
+#else
+    std::cout << '\a' << std::flush;
+#endif
+}
 
 // CropHealthMonitoringSystem class definition
 /*
 The CropHealthMonitoringSystem class simulates a monitoring system for crop health.
-It tracks soil moisture levels and pH levels, and can control an irrigation system and fertilizer application based on 
-these levels. The class also logs sensor data to CSV and JSON files.
+It tracks soil moisture levels and pH levels, and can control an irrigation system and fertilizer application based on
+these levels. The class also logs sensor data and publishes the current levels to the shared-memory status.
+
+Sensor decay, health checks and the end of an actuator run are timed events on an `EventScheduler`, which sleeps
+until the next one is due. Irrigation and fertilizing therefore run in the background: monitoring carries on while
+they are active, and a second alert for the same actuator is ignored until the running one has finished.
+Sensor data goes to a `SensorLogWriter`, which does the file I/O on its own thread, so no event waits on the disk.
+Health checks evaluate the alert rules of a `RuleEngine` and hand the actions of the rules that fire to an
+`AlertActionQueue`; the alarm runs on the queue's thread, and the actuators are started back on the scheduler's.
+
+A `simulated` system runs on a scheduler with a SimulatedClock. It runs the actions on the scheduler's thread and
+waits for room in the log writer's buffer rather than dropping samples, so a run only depends on its start time and
+length, and it does not sound the alarm.
 */
 class CropHealthMonitoringSystem {
 
 public:
-    CropHealthMonitoringSystem() : soilMoistureLevel(100.0), phLevel(12.0), irrigationSystem(false) {
-        std::ofstream file("sensor_data.csv", std::ios::app);
-        file << "soil_moisture_level,ph_level\n";
-        file.close();
+    CropHealthMonitoringSystem(EventScheduler& scheduler, SensorLogWriter& log, StatusPublisher& status,
+                               RuleEngine& rules, AlertActionQueue& actions, bool simulated = false)
+        : scheduler(scheduler), log(log), status(status), rules(rules), actions(actions), simulated(simulated),
+          soilMoistureLevel(100.0), phLevel(12.0), irrigationSystem(false), fertilizing(false) {
+        registerActions();
+    }
+
+    // Method to start monitoring
+    /*
+    Schedules the periodic events: soil moisture decay every second, pH decay every 3 seconds and a health check every
+    second, starting one period from now.
+    */
+    void start() {
+        writeDataToFile(soilMoistureLevel, phLevel);
+        updateJsonData();
+        scheduler.scheduleEvery(SENSOR_PERIOD, [this] { updateCropParameters(); }, SENSOR_PERIOD);
+        scheduler.scheduleEvery(PH_DECAY_PERIOD, [this] { updatePhLevel(); }, PH_DECAY_PERIOD);
+        scheduler.scheduleEvery(HEALTH_CHECK_PERIOD, [this] { checkCropHealth(); }, HEALTH_CHECK_PERIOD);
     }
 
     // Method to update crop parameters
     /*
-    Updates the soil moisture and pH levels, logging the changes every second. It decreases soil moisture by 5% every second and pH level by 1 every 3 seconds. Updates the JSON data after each change.
+    Decreases soil moisture by 5% (run every second), logs the new levels and updates the JSON data.
     */
 
     void updateCropParameters() {
-        writeDataToFile(soilMoistureLevel, phLevel);
-        auto startTime = std::chrono::steady_clock::now();
-        while (std::chrono::steady_clock::now() - startTime < std::chrono::seconds(1)) {
-            // Wait for 1 second
-        }
-
-        // Drop soil moisture level by 5% every 1 second
         soilMoistureLevel -= 5.0;
         if (soilMoistureLevel < 0.0) {
             soilMoistureLevel = 0.0;
         }
-
-        // Drop pH level by 1 every 3 seconds
-        if (std::chrono::steady_clock::now() - lastPhUpdate >= std::chrono::seconds(3)) {
-            lastPhUpdate = std::chrono::steady_clock::now();
-            phLevel -= 1.0;
-            if (phLevel < 0.0) {
-                phLevel = 0.0;
-            }
-        }
+        writeDataToFile(soilMoistureLevel, phLevel);
 
         // Update JSON data
         updateJsonData();
     }
 
+    // Method to update the pH level
+    /*
+    Drops the pH level by 1 (run every 3 seconds) and updates the JSON data.
+    */
+    void updatePhLevel() {
+        phLevel -= 1.0;
+        if (phLevel < 0.0) {
+            phLevel = 0.0;
+        }
+        updateJsonData();
+    }
+
     // Method to check crop health
     /*
-    Checks the current soil moisture and pH levels, and triggers alerts if levels drop below thresholds (30% for soil moisture and 4 for pH). It starts the irrigation system or applies fertilizers if necessary. Logs data and updates JSON after each check.
+    Evaluates the alert rules (by default: soil moisture below 30% or pH below 4) against the current levels and
+    queues the actions of the rules that fire.
     */
 
     void checkCropHealth() {
         std::cout << "Soil Moisture Level: " << soilMoistureLevel << std::endl;
         std::cout << "pH Level: " << phLevel << std::endl;
-        writeDataToFile(soilMoistureLevel, phLevel);
-        auto startTime = std::chrono::steady_clock::now();
-        while (std::chrono::steady_clock::now() - startTime < std::chrono::seconds(1)) {
-            // Wait for 1 second
-        }
 
-        if (soilMoistureLevel < 30.0) {
-            std::cout << "Alert: Soil moisture level is below threshold!" << std::endl;
-            Beep(2500, 1000);
-            // PlaySound(TEXT("soilMoisture.mp3"), NULL, SND_SYNC);
-            startIrrigationSystem();
+        float moisture = (float)soilMoistureLevel;
+        float ph = (float)phLevel;
+        const float* metrics[] = {&moisture, &ph};
+        fired.clear();
+        rules.evaluate(metrics, 1, fired);
+        if (simulated) {
+            actions.runNow(fired);
+        } else {
+            actions.push(fired);
         }
-        if (phLevel < 4.0) {
-            std::cout << "Alert: pH level is below threshold!" << std::endl;
-            Beep(2500, 1000);
-            // PlaySound(TEXT("phLevel.mp3"), NULL, SND_SYNC);
-            giveFertilizers();
-        }
-
-        // Update JSON data
-        updateJsonData();
     }
 
 
     // Method to start the irrigation system
     /*
-    Activates the irrigation system for 3 seconds, replenishing soil moisture to 100%. Logs the action and updates JSON data.
+    Switches the irrigation system on and schedules it to stop 3 seconds later, replenishing soil moisture to 100%.
     */
 
     void startIrrigationSystem() {
         std::cout << "Irrigation system started!" << std::endl;
+        irrigationSystem = true;
+        scheduler.scheduleAfter(IRRIGATION_TIME, [this] { stopIrrigationSystem(); });
+    }
 
-        auto startTime = std::chrono::steady_clock::now();
-        while (std::chrono::steady_clock::now() - startTime < std::chrono::seconds(3)) {
-            // Wait for 3 seconds
-        }
-
+    void stopIrrigationSystem() {
         soilMoistureLevel = 100.0;
+        irrigationSystem = false;
         std::cout << "Irrigation system stopped!" << std::endl;
 
         // Update JSON data
@@ -103,15 +164,17 @@ public:
 
     // Method to apply fertilizers
     /*
-    Sprays fertilizers for 5 seconds, resetting pH levels to 12. Logs the action and updates JSON data.
+    Starts spraying fertilizers and schedules the spraying to stop 5 seconds later, resetting pH levels to 12.
     */
     void giveFertilizers() {
         std::cout << "Sprinking Fertilizers!" << std::endl;
-        auto startTime = std::chrono::steady_clock::now();
-        while (std::chrono::steady_clock::now() - startTime < std::chrono::seconds(5)) {
-            // Wait for 5 seconds
-        }
+        fertilizing = true;
+        scheduler.scheduleAfter(FERTILIZER_TIME, [this] { stopFertilizers(); });
+    }
+
+    void stopFertilizers() {
         phLevel = 12.0;
+        fertilizing = false;
         std::cout << "Fertilizers stopped!" << std::endl;
 
         // Update JSON data
@@ -119,46 +182,518 @@ public:
     }
 
 private:
+    EventScheduler& scheduler;                              // runs the timed events of this system
+    SensorLogWriter& log;                                   // writes the sensor log in the background
+    StatusPublisher& status;                                // live levels for readers, in shared memory
+    RuleEngine& rules;                                      // alert rules over (moisture, ph)
+    AlertActionQueue& actions;                              // runs the actions of the rules that fire
+    bool simulated;                                         // runs in simulated time
+    std::vector<AlertAction> fired;                         // actions of the current health check
     double soilMoistureLevel;                               // stores current soil moisture level
     double phLevel;                                         // stores current pH level
     bool irrigationSystem;                                  // State of the irrigation system
-    std::chrono::steady_clock::time_point lastPhUpdate;     // Time point for last pH level update
+    bool fertilizing;                                       // State of the fertilizer sprinkler
+
+    // Method to register the alert actions
+    /*
+    Connects the action names the rules may use: `alarm` reports the rule and sounds the alarm, `irrigate` and
+    `fertilize` start the actuator on the scheduler's thread unless it is already running.
+    */
+    void registerActions() {
+        actions.setHandler(rules.actionId("alarm"), [this](const AlertAction& action) {
+            std::cout << "Alert: " << rules.ruleName(action.rule) << " (" << action.value << ")" << std::endl;
+            if (!simulated) {
+                soundAlarm();
+            }
+        });
+        actions.setHandler(rules.actionId("irrigate"), [this](const AlertAction&) {
+            scheduler.scheduleAfter(EventScheduler::Clock::duration::zero(), [this] {
+                if (!irrigationSystem) {
+                    startIrrigationSystem();
+                }
+            });
+        });
+        actions.setHandler(rules.actionId("fertilize"), [this](const AlertAction&) {
+            scheduler.scheduleAfter(EventScheduler::Clock::duration::zero(), [this] {
+                if (!fertilizing) {
+                    giveFertilizers();
+                }
+            });
+        });
+    }
 
     // Method to update JSON data
     /*
-    Writes the current soil moisture and pH levels to a JSON file.
+    Publishes the current soil moisture and pH levels to the shared-memory status (see status_shm.h), and hands them
+    to the log writer, which rewrites the JSON status file on its next flush if there is one.
     */
     void updateJsonData() {
-        std::ofstream outFile("data.json");
-        outFile << "{\n";
-        outFile << "  \"soil_moisture_level\": " << soilMoistureLevel << ",\n";
-        outFile << "  \"ph_level\": " << phLevel << "\n";
-        outFile << "}\n";
+        float moisture = (float)soilMoistureLevel;
+        float ph = (float)phLevel;
+        status.publish(&moisture, &ph, now());
+        log.publishStatus(soilMoistureLevel, phLevel);
     }
 
     // Method to write data to CSV file
     /*
-    Logs the current soil moisture and pH levels to a CSV file.
+    Queues the current soil moisture and pH levels, stamped with the scheduler's wall-clock time, for the sensor log.
     */
-    void writeDataToFile(float soilMoistureLevel, float phLevel){
-        std::ofstream file("sensor_data.csv", std::ios::app);
-        file << soilMoistureLevel << "," << phLevel << "\n";
-        file.close();
+    void writeDataToFile(double soilMoistureLevel, double phLevel) {
+        SensorSample sample{now(), soilMoistureLevel, phLevel};
+        if (simulated) {
+            log.appendWaiting(sample);
+        } else if (!log.append(sample)) {
+            std::cerr << "Warning: sensor log buffer full, sample dropped" << std::endl;
+        }
+    }
+
+    // now(): milliseconds since the Unix epoch on the scheduler's clock.
+    int64_t now() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(scheduler.wallNow().time_since_epoch()).count();
+    }
+};
+
+// Fleet benchmark
+/*
+Simulates `fieldCount` plots with FieldFleet for `tickCount` ticks as fast as possible and reports ticks per second.
+With `rules`, every tick also evaluates the alert rules over all plots and queues their actions; the report then
+includes the evaluation time per tick against the one-second tick budget, and the actions queued and dropped. Every
+tick also publishes the levels of all plots to `status`, and the report includes the time that takes per tick.
+*/
+void runFleet(size_t fieldCount, int tickCount, RuleEngine* rules, StatusPublisher& status) {
+    FieldFleet fleet(fieldCount, 1);
+    AlertActionQueue actions;
+    std::vector<AlertAction> fired;
+    double ruleSeconds = 0.0;
+    double statusSeconds = 0.0;
+    if (rules != nullptr) {
+        actions.start();
     }
+    auto startTime = std::chrono::steady_clock::now();
+    for (int t = 0; t < tickCount; t++) {
+        fleet.tick();
+        auto statusStart = std::chrono::steady_clock::now();
+        status.publish(fleet.moisture.data(), fleet.ph.data(), std::chrono::duration_cast<std::chrono::milliseconds>(
+                                                                   std::chrono::system_clock::now().time_since_epoch()).count());
+        statusSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - statusStart).count();
+        if (rules != nullptr) {
+            auto ruleStart = std::chrono::steady_clock::now();
+            const float* metrics[] = {fleet.moisture.data(), fleet.ph.data()};
+            fired.clear();
+            rules->evaluate(metrics, fieldCount, fired);
+            actions.push(fired);
+            ruleSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - ruleStart).count();
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    actions.stop();
+    std::cout << fieldCount << " fields: " << tickCount << " ticks in " << seconds << " s, "
+              << tickCount / seconds << " ticks/s, " << fieldCount * (double)tickCount / seconds << " field updates/s ("
+              << fleet.irrigationStarts << " irrigations, " << fleet.fertilizerStarts << " fertilizations)" << std::endl;
+    std::cout << "  status: " << statusSeconds * 1000.0 / tickCount << " ms/tick to publish" << std::endl;
+    if (rules != nullptr) {
+        std::cout << "  " << rules->ruleCount() << " rules: " << ruleSeconds * 1000.0 / tickCount
+                  << " ms/tick of the " << std::chrono::milliseconds(HEALTH_CHECK_PERIOD).count() << " ms budget, "
+                  << actions.queuedCount() << " actions queued, " << actions.droppedCount() << " dropped" << std::endl;
+    }
+}
+
+// Ingest pipeline
+/*
+Options of `--ingest` mode: `fieldCount` plots report through `producerCount` gateway threads, each sending a reading
+for every plot it serves `rate` times per second, for `seconds` seconds (0: until Ctrl+C). With `replayPath` (a
+time-series store directory, or a CSV file of `time,soil_moisture_level,ph_level` or `soil_moisture_level,ph_level`
+lines) every gateway instead replays the recorded readings as one plot, as fast as the pipeline takes them.
+*/
+struct IngestOptions {
+    size_t fieldCount = 1000;
+    int producerCount = 4;
+    double rate = 1.0;
+    double seconds = 10.0;
+    size_t queueCapacity = 1 << 16;
+    std::string replayPath;
 };
 
+// loadReplay(): the readings of a time-series store or CSV file, in time order.
+bool loadReplay(const std::string& path, std::vector<SensorSample>& samples) {
+    if (std::filesystem::is_directory(path)) {
+        TimeSeriesStore store(path);
+        if (!store.load()) {
+            return false;
+        }
+        store.scan(INT64_MIN, INT64_MAX, [&samples](const SensorSample& sample) { samples.push_back(sample); });
+        return true;
+    }
+    std::ifstream fin(path);
+    if (!fin) {
+        return false;
+    }
+    std::string line;
+    int64_t time = 0;
+    while (std::getline(fin, line)) {
+        std::vector<double> values;
+        std::stringstream fields(line);
+        std::string value;
+        while (std::getline(fields, value, ',')) {
+            char* end;
+            values.push_back(std::strtod(value.c_str(), &end));
+            if (end == value.c_str()) {
+                values.clear();         // a header row
+                break;
+            }
+        }
+        if (values.size() == 3) {
+            samples.push_back(SensorSample{(int64_t)values[0], values[1], values[2]});
+        } else if (values.size() == 2) {
+            samples.push_back(SensorSample{time, values[0], values[1]});
+            time += 1000;
+        }
+    }
+    return true;
+}
+
+/*
+Runs the ingest pipeline (see ingest.h): gateway threads push readings into the lock-free ingest queue, and three
+stages consume them on their own threads. `health` keeps the latest levels of every plot, evaluates the alert rules
+over all of them and publishes them to the shared-memory status `statusName` every second; `log` writes plot 0's
+readings to the sensor log (the store holds one series); `status` hands plot 0's levels to the JSON status file and
+prints the queue depth and counters every second. The health and log stages never lose a reading; the status stage
+only needs the latest ones and drops readings when it falls behind.
+*/
+int runIngest(const IngestOptions& options, RuleEngine& rules, SensorLogWriter& log, const std::string& statusName) {
+    std::vector<SensorSample> replay;
+    if (!options.replayPath.empty() && !loadReplay(options.replayPath, replay)) {
+        std::cerr << "Cannot read " << options.replayPath << std::endl;
+        return 1;
+    }
+    size_t fieldCount = options.replayPath.empty() ? options.fieldCount : (size_t)options.producerCount;
+    StatusPublisher status;
+    if (!status.open(statusName, fieldCount)) {
+        std::cerr << "Cannot create the shared-memory status " << statusName << std::endl;
+        return 1;
+    }
+
+    IngestPipeline pipeline(options.queueCapacity);
+    AlertActionQueue actions;
+    std::vector<std::atomic<uint64_t>> actionCounts(rules.actionNames().size());
+    for (size_t a = 0; a < actionCounts.size(); a++) {
+        actions.setHandler((int)a, [&actionCounts, a](const AlertAction&) { actionCounts[a]++; });
+    }
+
+    std::vector<float> moisture(fieldCount, 100.0f);
+    std::vector<float> ph(fieldCount, 12.0f);
+    std::vector<AlertAction> fired;
+    pipeline.addStage("health", 1 << 16, StageOverflow::Block,
+        [&](const FieldReading* batch, size_t count) {
+            for (size_t i = 0; i < count; i++) {
+                moisture[batch[i].field] = (float)batch[i].sample.soilMoistureLevel;
+                ph[batch[i].field] = (float)batch[i].sample.phLevel;
+            }
+        },
+        std::chrono::duration_cast<std::chrono::milliseconds>(HEALTH_CHECK_PERIOD), [&] {
+            const float* metrics[] = {moisture.data(), ph.data()};
+            fired.clear();
+            rules.evaluate(metrics, fieldCount, fired);
+            actions.push(fired);
+            status.publish(moisture.data(), ph.data(), std::chrono::duration_cast<std::chrono::milliseconds>(
+                                                           std::chrono::system_clock::now().time_since_epoch()).count());
+        });
+    pipeline.addStage("log", 1 << 16, StageOverflow::Block, [&log](const FieldReading* batch, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            if (batch[i].field != 0) {
+                continue;
+            }
+            log.appendWaiting(batch[i].sample);
+        }
+    });
+    SensorSample latest{0, 100.0, 12.0};
+    auto startTime = std::chrono::steady_clock::now();
+    auto printStats = [&] {
+        IngestStats stats = pipeline.stats();
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        std::cout << "[" << elapsed << " s] ingested " << stats.pushed << " (" << stats.pushed / elapsed << "/s), queue "
+                  << stats.depth << "/" << stats.capacity << " (max " << stats.maxDepth << "), producer waits "
+                  << stats.producerWaits << ", dropped " << stats.dropped;
+        for (const IngestStageStats& stage : stats.stages) {
+            std::cout << ", " << stage.name << " " << stage.consumed << " (inbox " << stage.depth << ", dropped "
+                      << stage.dropped << ")";
+        }
+        std::cout << std::endl;
+    };
+    pipeline.addStage("status", 1 << 12, StageOverflow::Drop,
+        [&latest](const FieldReading* batch, size_t count) {
+            for (size_t i = 0; i < count; i++) {
+                if (batch[i].field == 0) {
+                    latest = batch[i].sample;
+                }
+            }
+        },
+        std::chrono::milliseconds(1000), [&] {
+            log.publishStatus(latest.soilMoistureLevel, latest.phLevel);
+            printStats();
+        });
+
+    actions.start();
+    pipeline.start();
+    std::atomic<bool> producing{true};
+    std::atomic<int> producersDone{0};
+    std::vector<std::thread> producers;
+    for (int p = 0; p < options.producerCount; p++) {
+        producers.emplace_back([&, p] {
+            if (!replay.empty()) {
+                for (size_t i = 0; i < replay.size() && producing.load(); i++) {
+                    pipeline.push(FieldReading{(uint32_t)p, replay[i]});
+                }
+                producersDone++;
+                return;
+            }
+            // a gateway serving plots [first, last): every period it sends one burst with a reading of each.
+            size_t first = fieldCount * p / options.producerCount;
+            size_t last = fieldCount * (p + 1) / options.producerCount;
+            std::mt19937 random(p + 1);
+            std::uniform_real_distribution<double> decay(4.0, 6.0);
+            std::vector<double> fieldMoisture(last - first, 100.0);
+            std::vector<double> fieldPh(last - first, 12.0);
+            auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(1.0 / options.rate));
+            auto next = std::chrono::steady_clock::now();
+            for (uint64_t tick = 0; producing.load(); tick++) {
+                int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+                                  std::chrono::system_clock::now().time_since_epoch()).count();
+                for (size_t f = first; f < last; f++) {
+                    double& m = fieldMoisture[f - first];
+                    double& h = fieldPh[f - first];
+                    m = m < 20.0 ? 100.0 : m - decay(random) / options.rate;
+                    h = h < 3.0 ? 12.0 : h - (random() % 3 == 0 ? 1.0 / options.rate : 0.0);
+                    pipeline.push(FieldReading{(uint32_t)f, SensorSample{now, m, h}});
+                }
+                next += period;
+                std::this_thread::sleep_until(next);
+            }
+        });
+    }
+
+    while (!shutdownRequested) {
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        if (options.seconds > 0 && elapsed >= options.seconds) {
+            break;
+        }
+        if (producersDone.load() == options.producerCount) {
+            break;              // a replay has been pushed in full.
+        }
+        std::this_thread::sleep_for(SHUTDOWN_POLL);
+    }
+    producing.store(false);
+    for (std::thread& producer : producers) {
+        producer.join();
+    }
+    pipeline.stop();          // the status stage prints the final counters as it exits.
+    actions.stop();
+    std::cout << "Alert actions:";
+    for (size_t a = 0; a < actionCounts.size(); a++) {
+        std::cout << " " << rules.actionNames()[a] << " " << actionCounts[a].load();
+    }
+    std::cout << " (" << actions.droppedCount() << " dropped)" << std::endl;
+    return 0;
+}
+
+// parseDuration(): "90d", "12h", "30m" or "45s" (or plain seconds); false if it is none of these.
+bool parseDuration(const std::string& text, std::chrono::milliseconds& duration) {
+    char* end;
+    double value = std::strtod(text.c_str(), &end);
+    std::string unit = end;
+    double scale = unit == "d" ? 86400.0 : unit == "h" ? 3600.0 : unit == "m" ? 60.0 : unit == "s" || unit.empty() ? 1.0 : 0.0;
+    if (end == text.c_str() || scale == 0.0 || value <= 0.0) {
+        return false;
+    }
+    duration = std::chrono::milliseconds((int64_t)(value * scale * 1000.0));
+    return true;
+}
+
 // Main function
 /*
-Initializes the CropHealthMonitoringSystem and continuously updates crop parameters and checks crop health in an
-infinite loop.
+Initializes the CropHealthMonitoringSystem, schedules its periodic events and runs the event loop until SIGINT or
+SIGTERM, then flushes the sensor log before exiting. The loop sleeps between events instead of spinning. Readings are
+logged to the time-series store in `--tsdb dir` (default `sensor_tsdb`), and also to a plain CSV file with
+`--csv-log [file]`. `--fsync never|flush|close` sets when the log is forced to disk, `--flush-ms M` the longest time
+a sample stays buffered and `--batch B` the number of buffered samples that triggers an early flush. Alert rules are
+read from `--rules file` (default `alert_rules.conf`, or the built-in rules if that does not exist). The current
+levels are published to the shared-memory status `--status name` (default `crop_status`; read it with `./status`),
+and also written to a JSON file with `--json-status [file]` (default `data.json`). With `--fleet
+N[,N...]` it instead benchmarks the fleet simulation for each fleet size (`--ticks T` ticks each, default 1000),
+evaluating the rules too if `--rules` is given. With `--ingest` it runs the ingest pipeline (see runIngest()).
+
+`--simulate DURATION` (e.g. `90d`) runs the monitor in simulated time instead: the scheduler jumps from one event to
+the next without waiting, so a season takes seconds, and stops after DURATION of simulated time. Readings are
+timestamped from `--start MS` (milliseconds since the Unix epoch, default now), so a run with the same start and
+duration always writes the same log and status; the values are those a real-time run of the same length produces.
 */
-int main() {
-    CropHealthMonitoringSystem system;
+int main(int argc, char* argv[]) {
+    std::vector<size_t> fleetSizes;
+    int tickCount = 1000;
+    LogWriterOptions logOptions;
+    std::string rulesPath;
+    std::string statusName = DEFAULT_STATUS_NAME;
+    bool ingest = false;
+    IngestOptions ingestOptions;
+    std::chrono::milliseconds simulatedDuration(0);
+    int64_t simulatedStart = std::chrono::duration_cast<std::chrono::milliseconds>(
+                                 std::chrono::system_clock::now().time_since_epoch()).count();
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--fleet" && i + 1 < argc) {
+            std::stringstream sizes(argv[++i]);
+            std::string size;
+            while (std::getline(sizes, size, ',')) {
+                fleetSizes.push_back(std::stoul(size));
+            }
+        } else if (arg == "--ticks" && i + 1 < argc) {
+            tickCount = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--fsync" && i + 1 < argc) {
+            std::string policy = argv[++i];
+            if (policy == "never") {
+                logOptions.fsync = FsyncPolicy::Never;
+            } else if (policy == "flush") {
+                logOptions.fsync = FsyncPolicy::EveryFlush;
+            } else if (policy == "close") {
+                logOptions.fsync = FsyncPolicy::OnClose;
+            } else {
+                std::cerr << "Unknown fsync policy: " << policy << " (never, flush or close)\n";
+                return 1;
+            }
+        } else if (arg == "--flush-ms" && i + 1 < argc) {
+            logOptions.flushInterval = std::chrono::milliseconds(std::max(1, std::stoi(argv[++i])));
+        } else if (arg == "--batch" && i + 1 < argc) {
+            logOptions.batchSize = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--tsdb" && i + 1 < argc) {
+            logOptions.tsdbPath = argv[++i];
+        } else if (arg == "--rules" && i + 1 < argc) {
+            rulesPath = argv[++i];
+        } else if (arg == "--simulate" && i + 1 < argc) {
+            if (!parseDuration(argv[++i], simulatedDuration)) {
+                std::cerr << "Bad duration: " << argv[i] << " (e.g. 90d, 12h, 30m or 45s)\n";
+                return 1;
+            }
+        } else if (arg == "--start" && i + 1 < argc) {
+            simulatedStart = std::stoll(argv[++i]);
+        } else if (arg == "--ingest") {
+            ingest = true;
+        } else if (arg == "--fields" && i + 1 < argc) {
+            ingestOptions.fieldCount = std::max(1UL, std::stoul(argv[++i]));
+        } else if (arg == "--producers" && i + 1 < argc) {
+            ingestOptions.producerCount = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--rate" && i + 1 < argc) {
+            ingestOptions.rate = std::max(0.001, std::stod(argv[++i]));
+        } else if (arg == "--seconds" && i + 1 < argc) {
+            ingestOptions.seconds = std::max(0.0, std::stod(argv[++i]));
+        } else if (arg == "--queue" && i + 1 < argc) {
+            ingestOptions.queueCapacity = std::max(2UL, std::stoul(argv[++i]));
+        } else if (arg == "--replay" && i + 1 < argc) {
+            ingestOptions.replayPath = argv[++i];
+        } else if (arg == "--status" && i + 1 < argc) {
+            statusName = argv[++i];
+        } else if (arg == "--json-status") {
+            logOptions.jsonPath = (i + 1 < argc && argv[i + 1][0] != '-') ? argv[++i] : "data.json";
+        } else if (arg == "--csv-log") {
+            logOptions.csvPath = (i + 1 < argc && argv[i + 1][0] != '-') ? argv[++i] : "sensor_data.csv";
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--rules file] [--fsync never|flush|close] [--flush-ms M] [--batch B]"
+                      << " [--tsdb dir] [--csv-log [file]] [--status name] [--json-status [file]]"
+                      << " [--simulate DURATION [--start MS]]\n"
+                      << "       " << argv[0] << " --fleet N[,N...] [--ticks T] [--rules file]\n"
+                      << "       " << argv[0] << " --ingest [--fields F] [--producers P] [--rate R] [--seconds S]"
+                      << " [--queue N] [--replay <tsdb dir|csv>] [--rules file] [--tsdb dir]\n";
+            return 1;
+        }
+    }
+
+    RuleEngine rules({"moisture", "ph"}, std::chrono::duration<double>(HEALTH_CHECK_PERIOD).count());
+    std::string error;
+    bool rulesLoaded;
+    if (!rulesPath.empty()) {
+        rulesLoaded = rules.load(rulesPath, error);
+    } else if (std::ifstream("alert_rules.conf")) {
+        rulesLoaded = rules.load("alert_rules.conf", error);
+    } else {
+        rulesLoaded = rules.compile(DEFAULT_ALERT_RULES, error);
+    }
+    if (!rulesLoaded) {
+        std::cerr << "Alert rules: " << error << std::endl;
+        return 1;
+    }
 
-    while (true) {
-        system.updateCropParameters();
-        system.checkCropHealth();
+    if (!fleetSizes.empty()) {
+        for (size_t fieldCount : fleetSizes) {
+            StatusPublisher status;
+            if (!status.open(statusName, fieldCount)) {
+                std::cerr << "Cannot create the shared-memory status " << statusName << std::endl;
+                return 1;
+            }
+            runFleet(fieldCount, tickCount, rulesPath.empty() ? nullptr : &rules, status);
+        }
+        return 0;
     }
 
+    SensorLogWriter log(logOptions);
+    if (!log.open("soil_moisture_level,ph_level\n")) {
+        std::cerr << "Cannot open the sensor log in " << logOptions.tsdbPath << std::endl;
+        return 1;
+    }
+    std::signal(SIGINT, requestShutdown);
+    std::signal(SIGTERM, requestShutdown);
+    if (ingest) {
+        int status = runIngest(ingestOptions, rules, log, statusName);
+        log.close();
+        std::cout << "Logged " << log.writtenCount() << " samples" << std::endl;
+        return status;
+    }
+    StatusPublisher status;
+    if (!status.open(statusName, 1)) {
+        std::cerr << "Cannot create the shared-memory status " << statusName << std::endl;
+        return 1;
+    }
+    bool simulated = simulatedDuration.count() > 0;
+    std::unique_ptr<SchedulerClock> clock(new RealClock());
+    if (simulated) {
+        clock.reset(new SimulatedClock(std::chrono::system_clock::time_point(std::chrono::milliseconds(simulatedStart))));
+    }
+    EventScheduler scheduler(std::move(clock));
+    AlertActionQueue actions;
+    CropHealthMonitoringSystem system(scheduler, log, status, rules, actions, simulated);
+    for (const std::string& action : rules.actionNames()) {
+        if (!actions.hasHandler(rules.actionId(action))) {
+            std::cerr << "Alert rules: unknown action " << action << " (alarm, irrigate or fertilize)" << std::endl;
+            return 1;
+        }
+    }
+    std::chrono::milliseconds shutdownPoll = SHUTDOWN_POLL;
+    if (simulated) {
+        shutdownPoll = SIMULATED_SHUTDOWN_POLL;
+        scheduler.scheduleAfter(simulatedDuration, [&scheduler] { scheduler.stop(); });
+    } else {
+        actions.start();
+    }
+    scheduler.scheduleEvery(shutdownPoll, [&scheduler] {
+        if (shutdownRequested) {
+            scheduler.stop();
+        }
+    }, shutdownPoll);
+
+    auto startTime = std::chrono::steady_clock::now();
+    system.start();
+    scheduler.run();
+    if (simulated) {
+        double simulatedSeconds = std::chrono::duration<double>(scheduler.now().time_since_epoch()).count();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        std::cerr << "Simulated " << simulatedSeconds << " s in " << seconds << " s" << std::endl;
+    }
+
+    actions.stop();
+    log.close();
+    std::cout << "Logged " << log.writtenCount() << " samples";
+    if (log.droppedCount() > 0) {
+        std::cout << ", dropped " << log.droppedCount();
+    }
+    std::cout << std::endl;
     return 0;
 }
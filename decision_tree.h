@@ -0,0 +1,1316 @@
+#ifndef DECISION_TREE_H
+#define DECISION_TREE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "mapped_file.h"
+#include "model_format.h"
+#include "task_scheduler.h"
+
+/*
+Training side of the crop predictor: the encoded `Table`, the `DecisionTree` builder and its `RandomForest` ensemble,
+and the `InputReader` that loads Crop_recommendation.csv. decision.cpp trains and saves the models; bench.cpp times
+the same code on synthetic data.
+*/
+
+class Table {
+public:
+    std::vector<std::string> attrName;                      // stores attribute names.
+    std::vector<std::vector<std::string>> data;             // stores the raw data rows until they are encoded.
+    std::vector<std::vector<std::string>> attrValueList;    // store unique attribute values for each attribute (sorted).
+    std::vector<std::vector<int>> columns;                  // columns[j][i] is the code of row i for attribute j.
+    // a byte per attribute rather than vector<bool>'s shared bits, since attributes are encoded concurrently.
+    std::vector<uint8_t> isNumeric;                         // whether every value of attribute j is a number.
+    std::vector<std::vector<double>> attrNumericValue;      // numeric value of each code of a numeric attribute.
+
+    
+    /* `extractAttrValue()` : Extracts unique attribute values for each attribute from the `data` and 
+    stores them in `attrValueList`. Every cell is then encoded once into `columns` as the position of its value
+    in `attrValueList`, so the label column (the last attribute) holds small integer class IDs. Attributes whose
+    values all parse as numbers are ordered by value instead of by text, so their codes are ranks and sorting rows
+    by code sorts them by value. The raw string rows are released afterwards. */
+
+    void extractAttrValue() {
+        attrValueList.assign(attrName.size(), std::vector<std::string>());
+        columns.assign(attrName.size(), std::vector<int>(data.size()));
+        isNumeric.assign(attrName.size(), false);
+        attrNumericValue.assign(attrName.size(), std::vector<double>());
+        for (int j = 0; j < attrName.size(); j++) {
+            std::unordered_map<std::string, int> value;
+            for (int i = 0; i < data.size(); i++) {
+                value.emplace(data[i][j], 0);
+            }
+            std::vector<std::string> distinct;
+            for (auto iter = value.begin(); iter != value.end(); iter++) {
+                distinct.push_back(iter->first);
+            }
+            setDictionary(j, std::move(distinct));
+            for (int code = 0; code < attrValueList[j].size(); code++) {
+                value[attrValueList[j][code]] = code;
+            }
+            for (int i = 0; i < data.size(); i++) {
+                columns[j][i] = value[data[i][j]];
+            }
+        }
+        data.clear();
+        data.shrink_to_fit();
+    }
+
+    /*
+    setDictionary(): makes the distinct `values` of attribute j its dictionary: sorted by text, or by number when every
+    value is a number (not for the label), filling `attrValueList[j]`, `isNumeric[j]` and `attrNumericValue[j]`.
+    The code of a value is then its position in `attrValueList[j]`.
+    */
+    void setDictionary(int j, std::vector<std::string> values) {
+        std::sort(values.begin(), values.end());
+        attrValueList[j] = std::move(values);
+        isNumeric[j] = false;
+        attrNumericValue[j].clear();
+        if (j != labelIndex() && parseNumbers(attrValueList[j], attrNumericValue[j])) {
+            isNumeric[j] = true;
+            sortByNumber(attrValueList[j], attrNumericValue[j]);
+        }
+    }
+
+    // parseNumbers(): converts every value to a double; returns false as soon as one is not a plain number.
+    static bool parseNumbers(const std::vector<std::string>& values, std::vector<double>& numbers) {
+        numbers.clear();
+        for (const std::string& text : values) {
+            char* parsedEnd = nullptr;
+            double number = std::strtod(text.c_str(), &parsedEnd);
+            if (text.empty() || *parsedEnd != '\0' || !std::isfinite(number)) {
+                numbers.clear();
+                return false;
+            }
+            numbers.push_back(number);
+        }
+        return true;
+    }
+
+    // sortByNumber(): reorders a text-sorted dictionary (and its parsed numbers) by numeric value.
+    static void sortByNumber(std::vector<std::string>& values, std::vector<double>& numbers) {
+        std::vector<int> order(values.size());
+        for (int i = 0; i < order.size(); i++) {
+            order[i] = i;
+        }
+        std::stable_sort(order.begin(), order.end(), [&numbers](int a, int b) { return numbers[a] < numbers[b]; });
+        std::vector<std::string> sortedValues(values.size());
+        std::vector<double> sortedNumbers(numbers.size());
+        for (int i = 0; i < order.size(); i++) {
+            sortedValues[i] = std::move(values[order[i]]);
+            sortedNumbers[i] = numbers[order[i]];
+        }
+        values = std::move(sortedValues);
+        numbers = std::move(sortedNumbers);
+    }
+
+    int rowCount() const {
+        return columns.empty() ? 0 : (int)columns[0].size();
+    }
+
+    // index of the label (class) column, which is always the last attribute.
+    int labelIndex() const {
+        return (int)attrName.size() - 1;
+    }
+
+    int labelCount() const {
+        return (int)attrValueList[labelIndex()].size();
+    }
+
+    // class IDs of every row; the label column is stored last.
+    const std::vector<int>& labels() const {
+        return columns.back();
+    }
+};
+
+// characteristics of each node in a decision tree
+class Node {
+public:
+    int criteriaAttrIndex;          // stores index of the attribute that the node splits on.
+    std::string attrValue;          // stores the value of the attribute that leads to this node.
+    int treeIndex;                  // stores the index of the node in decision tree
+    bool isLeaf;                    // Indicates if the node is a leaf node
+    std::string label;              // Label (or class) assigned to the leaf node
+    std::vector<int> children;      // Vector of indices of child nodes
+    bool isContinuous;              // Node splits a numeric attribute on `threshold` into two children
+    double threshold;               // children[0] takes values <= threshold, children[1] the rest
+    std::vector<std::pair<int, int>> classCounts;   // Leaves: (class ID, training rows) of each class reaching them
+
+
+    Node() {
+        criteriaAttrIndex = -1;
+        treeIndex = 0;
+        isLeaf = false;
+        isContinuous = false;
+        threshold = 0.0;
+    }
+};
+
+/*
+serializeNodesToJson() / serializeNodesToBinary(): a tree of `Node`s in depth-first order, written in the JSON model
+format or the binary one (see model_format.h). `classNames` maps the class IDs of the leaves' `classCounts` to labels.
+Shared by every learner that produces a `Node` tree.
+*/
+inline nlohmann::json serializeNodesToJson(const std::vector<Node>& tree, const std::vector<std::string>& classNames) {
+    nlohmann::json treeJson;
+    for (const Node& node : tree) {
+        nlohmann::json nodeJson;
+        nodeJson["criteriaAttrIndex"] = node.criteriaAttrIndex;
+        nodeJson["attrValue"] = node.attrValue;
+        nodeJson["treeIndex"] = node.treeIndex;
+        nodeJson["isLeaf"] = node.isLeaf;
+        nodeJson["label"] = node.label;
+        nodeJson["children"] = node.children;
+        nodeJson["isContinuous"] = node.isContinuous;
+        nodeJson["threshold"] = node.threshold;
+        if (node.isLeaf) {
+            nodeJson["classCounts"] = nlohmann::json::object();
+            for (const std::pair<int, int>& count : node.classCounts) {
+                nodeJson["classCounts"][classNames[count.first]] = count.second;
+            }
+        }
+        treeJson.push_back(nodeJson);
+    }
+    return treeJson;
+}
+
+inline bool serializeNodesToBinary(const std::vector<Node>& tree, const std::vector<std::string>& classNames,
+                                   const std::string& path) {
+    ModelWriter writer;
+    std::vector<std::pair<std::string, uint32_t>> classCounts;
+    for (const Node& node : tree) {
+        classCounts.clear();
+        for (const std::pair<int, int>& count : node.classCounts) {
+            classCounts.push_back({classNames[count.first], (uint32_t)count.second});
+        }
+        writer.addNode(node.criteriaAttrIndex, node.attrValue, node.isLeaf, node.label, node.children,
+                       node.isContinuous, node.threshold, classCounts);
+    }
+    return writer.write(path);
+}
+
+/*
+A piece of the decision tree built by one task. Nodes refer to each other by their index in `nodes`; a child whose
+subtree was built by another task is a placeholder whose real subtree lives in `grafts`. The pieces are stitched
+into one tree, numbered in depth-first order, once every task has finished.
+*/
+class Subtree {
+public:
+    std::vector<Node> nodes;
+    std::unordered_map<int, std::unique_ptr<Subtree>> grafts;
+};
+
+/*
+Scratch buffers reused by every split evaluation, so that scoring an attribute at a node does not allocate.
+Every per-code and per-class counter is left at zero between uses.
+*/
+class SplitWorkspace {
+public:
+    std::vector<int> valueCount;    // number of rows per attribute code in the current range.
+    std::vector<int> valueStart;    // bucket offsets per attribute code.
+    std::vector<int> touched;       // attribute codes present in the current range.
+    std::vector<int> bucket;        // class IDs of the current range grouped by attribute code; partition buffer.
+    std::vector<int> labelCount;    // number of rows per class ID.
+    std::vector<int> leftCount;     // number of rows per class ID on the left of a candidate threshold.
+
+    void reserve(const Table& table, int rowCount) {
+        size_t maxValues = 0;
+        for (int j = 0; j < table.attrValueList.size(); j++) {
+            maxValues = std::max(maxValues, table.attrValueList[j].size());
+        }
+        valueCount.assign(maxValues, 0);
+        valueStart.assign(maxValues, 0);
+        touched.reserve(maxValues);
+        bucket.resize(rowCount);
+        labelCount.assign(table.labelCount(), 0);
+        leftCount.assign(table.labelCount(), 0);
+    }
+};
+
+/*
+A scored way to split a node: the attribute, its gain ratio and, for a numeric attribute, the threshold that sends
+rows with a value <= threshold to the first child and the others to the second.
+*/
+class SplitCandidate {
+public:
+    int attrIndex = -1;
+    double gainRatio = 0.0;
+    double threshold = 0.0;
+};
+
+/*
+How a `DecisionTree` is grown. The defaults train one tree on every row and attribute; a random forest passes a
+bootstrap sample and a subset of the attributes for each tree.
+*/
+class TreeOptions {
+public:
+    int threadCount = 1;                    // threads scoring attributes and building subtrees.
+    double purityCutoff = 0.8;              // a node whose majority class exceeds this share of its rows becomes a leaf.
+    std::vector<int> sampleRows;            // rows to train on, repeats allowed; empty = every row once.
+    std::vector<bool> allowedAttributes;    // attributes a split may use; empty = all.
+};
+
+class DecisionTree {
+public:
+    const Table& initialTable;                      // The table of data; shared read-only, so it must outlive the tree.
+    TreeOptions options;                            // How the tree is grown.
+    std::vector<Node> tree;                         // Vector of `Node` objects representing the decision tree.
+    std::vector<int> rows;                          // Row indices; every node owns a contiguous range [begin, end) of it.
+    std::vector<std::vector<int>> sortedRows;       // Per numeric attribute, the same ranges as `rows` kept sorted by value.
+    std::vector<int> childOf;                       // Child position of every row of the node being partitioned.
+    std::vector<double> xlogx;                      // xlogx[c] = c * log2(c), for incremental entropy during threshold scans.
+    std::vector<SplitWorkspace> workspaces;         // Reusable counters for split scoring, one per worker thread.
+    TaskScheduler* scheduler = nullptr;             // Set only while a parallel build is running.
+
+    static const int subtreeGrain = 512;        // smallest row range that is built as a separate task.
+    static const int attributeGrain = 4096;     // smallest row range whose attributes are scored concurrently.
+
+    /*Takes a Table object as input, initializes initialTable, and builds the decision tree starting from the
+     root node (run() is called) over the range holding every training row (`options.sampleRows`, or every row of
+     the table). Numeric attributes are sorted once here; the sorted order is then carried down the tree by stable
+     partitioning. With `options.threadCount` > 1 attributes are scored concurrently and large subtrees are built as
+     tasks on a work-stealing pool; the resulting tree is identical to the single-threaded one.*/
+
+    DecisionTree(const Table& table, const TreeOptions& treeOptions = TreeOptions())
+        : initialTable(table), options(treeOptions) {
+        if (options.sampleRows.empty()) {
+            rows.resize(initialTable.rowCount());
+            for (int i = 0; i < rows.size(); i++) {
+                rows[i] = i;
+            }
+        } else {
+            rows = options.sampleRows;
+            std::sort(rows.begin(), rows.end());
+        }
+        int rowCount = (int)rows.size();
+        childOf.resize(initialTable.rowCount());
+        xlogx.resize(rowCount + 1);
+        xlogx[0] = 0.0;
+        for (int c = 1; c <= rowCount; c++) {
+            xlogx[c] = c * std::log(c) / std::log(2);
+        }
+        presortNumericAttributes();
+
+        std::unique_ptr<TaskScheduler> pool;
+        if (options.threadCount > 1) {
+            pool.reset(new TaskScheduler(options.threadCount));
+            scheduler = pool.get();
+        }
+        workspaces.resize(std::max(1, options.threadCount));
+        for (SplitWorkspace& workspace : workspaces) {
+            workspace.reserve(initialTable, rowCount);
+        }
+
+        Subtree root;
+        root.nodes.push_back(Node());
+        run(root, 0, 0, rowCount);
+        scheduler = nullptr;
+        pool.reset();
+        workspaces.clear();
+        rows.clear();
+        sortedRows.clear();
+        childOf.clear();
+        xlogx.clear();
+
+        stitch(root, 0);
+    }
+
+    /*
+    presortNumericAttributes(): counting sort of the training rows by the code of every numeric attribute. Codes of
+    numeric attributes are ranks, so this orders each attribute by value (ties by row index) in O(rows + values).
+    */
+    void presortNumericAttributes() {
+        sortedRows.assign(initialTable.attrName.size(), std::vector<int>());
+        for (int j = 0; j < initialTable.labelIndex(); j++) {
+            if (!initialTable.isNumeric[j]) {
+                continue;
+            }
+            const std::vector<int>& column = initialTable.columns[j];
+            std::vector<int> start(initialTable.attrValueList[j].size() + 1, 0);
+            for (int row : rows) {
+                start[column[row] + 1]++;
+            }
+            for (int v = 1; v < start.size(); v++) {
+                start[v] += start[v - 1];
+            }
+            sortedRows[j].resize(rows.size());
+            for (int row : rows) {
+                sortedRows[j][start[column[row]]++] = row;
+            }
+        }
+    }
+
+    // `guess()`: Predicts the label for a given input row using DFS traversal.
+    std::string guess(std::vector<std::string> row) {
+        std::string label = "";
+        int leafNode = dfs(row, 0);
+        if (leafNode == -1) {
+            return "dfs failed";
+        }
+        label = tree[leafNode].label;
+        return label;
+    }
+
+    /*dfs() function recursively traverses a decision tree to find the appropriate leaf node that 
+    corresponds to a given row of data for classification.*/
+    int dfs(std::vector<std::string>& row, int here) {
+        if (tree[here].isLeaf) {
+            return here;
+        }
+
+        int criteriaAttrIndex = tree[here].criteriaAttrIndex;
+        if (tree[here].isContinuous) {
+            char* parsedEnd = nullptr;
+            double value = std::strtod(row[criteriaAttrIndex].c_str(), &parsedEnd);
+            if (row[criteriaAttrIndex].empty() || *parsedEnd != '\0') {
+                return -1;
+            }
+            return dfs(row, tree[here].children[value <= tree[here].threshold ? 0 : 1]);
+        }
+        for (int i = 0; i < tree[here].children.size(); i++) {
+            int next = tree[here].children[i];
+            if (row[criteriaAttrIndex] == tree[next].attrValue) {
+                return dfs(row, next);
+            }
+        }
+        return -1;
+    }
+
+    /*
+    classify(): label of row `row` of the table, walking the tree on the encoded columns. A categorical node has one
+    child per code of its attribute, in code order, so no strings are compared.
+    */
+    const std::string& classify(int row) const {
+        int here = 0;
+        while (!tree[here].isLeaf) {
+            int attr = tree[here].criteriaAttrIndex;
+            int code = initialTable.columns[attr][row];
+            if (tree[here].isContinuous) {
+                here = tree[here].children[initialTable.attrNumericValue[attr][code] <= tree[here].threshold ? 0 : 1];
+            } else {
+                here = tree[here].children[code];
+            }
+        }
+        return tree[here].label;
+    }
+
+    /*
+    
+    run() function: recursively constructs a decision tree using the ID3 algorithm over the rows in
+    `rows[begin, end)`. It selects attributes based on information gain, stably partitions that range in place by
+    the selected attribute (one child per value, or two children around a threshold for a numeric attribute),
+    creates nodes for each sub-range, and assigns labels to leaf nodes based on majority
+    voting, ensuring the tree grows until all data subsets are classified or a stopping criterion 
+    (a majority class above `options.purityCutoff`) is met. Nodes are appended to `out`; when a scheduler is set, large children are
+    built as separate tasks into their own `Subtree` and the call waits for them before returning.
+    
+    */
+
+    void run(Subtree& out, int nodeIndex, int begin, int end) {
+        if (isLeafNode(begin, end)) {
+            out.nodes[nodeIndex].isLeaf = true;
+            out.nodes[nodeIndex].label = classLabel(initialTable.labels()[rows[end - 1]]);
+            out.nodes[nodeIndex].classCounts = {{initialTable.labels()[rows[end - 1]], end - begin}};
+            return;
+        }
+
+        SplitCandidate split = getSelectedAttribute(begin, end);
+        int selectedAttrIndex = split.attrIndex;
+        std::pair<std::string, int> majority = getMajorityLabel(begin, end);
+        if (selectedAttrIndex == -1) {
+            // no attribute separates the rows any further, so fall back to the majority label.
+            out.nodes[nodeIndex].isLeaf = true;
+            out.nodes[nodeIndex].label = majority.first;
+            out.nodes[nodeIndex].classCounts = getClassCounts(begin, end);
+            return;
+        }
+
+        out.nodes[nodeIndex].criteriaAttrIndex = selectedAttrIndex;
+        if ((double)majority.second / (end - begin) > options.purityCutoff) {
+            out.nodes[nodeIndex].isLeaf = true;
+            out.nodes[nodeIndex].label = majority.first;
+            out.nodes[nodeIndex].classCounts = getClassCounts(begin, end);
+            return;
+        }
+
+        bool isContinuous = initialTable.isNumeric[selectedAttrIndex];
+        if (isContinuous) {
+            out.nodes[nodeIndex].isContinuous = true;
+            out.nodes[nodeIndex].threshold = split.threshold;
+        }
+
+        std::vector<int> childStart = partitionRows(begin, end, split);
+        std::vector<std::pair<int, int>> parentCounts;      // given to empty children, which predict our majority.
+        TaskGroup children;
+        for (int i = 0; i + 1 < childStart.size(); i++) {
+            Node nextNode;
+            if (isContinuous) {
+                nextNode.attrValue = (i == 0 ? "<= " : "> ") + formatThreshold(split.threshold);
+            } else {
+                nextNode.attrValue = initialTable.attrValueList[selectedAttrIndex][i];
+            }
+            int childIndex = (int)out.nodes.size();
+            out.nodes[nodeIndex].children.push_back(childIndex);
+
+            int childBegin = childStart[i];
+            int childEnd = childStart[i + 1];
+            if (childBegin == childEnd) {
+                if (parentCounts.empty()) {
+                    parentCounts = getClassCounts(begin, end);
+                }
+                nextNode.isLeaf = true;
+                nextNode.label = majority.first;
+                nextNode.classCounts = parentCounts;
+                out.nodes.push_back(nextNode);
+            } else if (scheduler != nullptr && childEnd - childBegin >= subtreeGrain) {
+                out.nodes.push_back(nextNode);
+                Subtree* subtree = new Subtree();
+                subtree->nodes.push_back(nextNode);
+                out.grafts[childIndex].reset(subtree);
+                scheduler->spawn(children, [this, subtree, childBegin, childEnd] {
+                    run(*subtree, 0, childBegin, childEnd);
+                });
+            } else {
+                out.nodes.push_back(nextNode);
+                run(out, childIndex, childBegin, childEnd);
+            }
+        }
+        if (scheduler != nullptr) {
+            scheduler->wait(children);
+        }
+    }
+
+    /*
+    stitch(): appends the subtree rooted at `nodeIndex` of `piece` to `tree` in depth-first order (a node, then each
+    child's whole subtree in turn), following grafts into the pieces built by other tasks. Returns the node's final
+    index, which is also stored as its `treeIndex`.
+    */
+    int stitch(const Subtree& piece, int nodeIndex) {
+        auto graft = piece.grafts.find(nodeIndex);
+        if (graft != piece.grafts.end()) {
+            return stitch(*graft->second, 0);
+        }
+        int treeIndex = (int)tree.size();
+        tree.push_back(piece.nodes[nodeIndex]);
+        tree[treeIndex].treeIndex = treeIndex;
+        tree[treeIndex].children.clear();
+        for (int child : piece.nodes[nodeIndex].children) {
+            int childTreeIndex = stitch(piece, child);
+            tree[treeIndex].children.push_back(childTreeIndex);
+        }
+        return treeIndex;
+    }
+
+    // workspace(): split-scoring counters owned by the calling worker thread.
+    SplitWorkspace& workspace() {
+        return workspaces[scheduler != nullptr ? scheduler->workerIndex() : 0];
+    }
+
+    /*
+    partitionRows(): assigns every row of `rows[begin, end)` to a child of `split` (its attribute code, or 0/1 for
+    the two sides of a numeric threshold) and stably partitions `rows` and every presorted column over that range by
+    child, so each child's range stays sorted by every numeric attribute without re-sorting. Returns the offsets of
+    each child's sub-range: child c occupies [childStart[c], childStart[c + 1]). Keeping the partition stable also
+    preserves the row order that majority voting breaks ties on.
+    */
+    std::vector<int> partitionRows(int begin, int end, const SplitCandidate& split) {
+        const std::vector<int>& column = initialTable.columns[split.attrIndex];
+        bool isContinuous = initialTable.isNumeric[split.attrIndex];
+        const std::vector<double>& number = initialTable.attrNumericValue[split.attrIndex];
+        int childCount = isContinuous ? 2 : (int)initialTable.attrValueList[split.attrIndex].size();
+        std::vector<int> childStart(childCount + 1, 0);
+        for (int i = begin; i < end; i++) {
+            int row = rows[i];
+            childOf[row] = isContinuous ? (number[column[row]] <= split.threshold ? 0 : 1) : column[row];
+            childStart[childOf[row] + 1]++;
+        }
+        childStart[0] = begin;
+        for (int c = 0; c < childCount; c++) {
+            childStart[c + 1] += childStart[c];
+        }
+
+        std::vector<std::vector<int>*> targets = {&rows};
+        for (int j = 0; j < sortedRows.size(); j++) {
+            if (!sortedRows[j].empty()) {
+                targets.push_back(&sortedRows[j]);
+            }
+        }
+        if (scheduler != nullptr && end - begin >= attributeGrain) {
+            TaskGroup partitioning;
+            for (std::vector<int>* target : targets) {
+                scheduler->spawn(partitioning, [this, target, begin, end, &childStart] {
+                    partitionRange(*target, begin, end, childStart);
+                });
+            }
+            scheduler->wait(partitioning);
+        } else {
+            for (std::vector<int>* target : targets) {
+                partitionRange(*target, begin, end, childStart);
+            }
+        }
+        return childStart;
+    }
+
+    // partitionRange(): stable counting sort of `order[begin, end)` by `childOf`, through the worker's bucket.
+    void partitionRange(std::vector<int>& order, int begin, int end, const std::vector<int>& childStart) {
+        std::vector<int>& buffer = workspace().bucket;
+        std::vector<int> fill(childStart.begin(), childStart.end() - 1);
+        for (int i = begin; i < end; i++) {
+            buffer[fill[childOf[order[i]]]++ - begin] = order[i];
+        }
+        std::copy(buffer.begin(), buffer.begin() + (end - begin), order.begin() + begin);
+    }
+
+    // formatThreshold(): short text form of a threshold for child `attrValue`s and printTree().
+    static std::string formatThreshold(double threshold) {
+        std::ostringstream text;
+        text << std::setprecision(10) << threshold;
+        return text.str();
+    }
+
+    // classLabel(): maps a class ID back to the label string it was encoded from.
+    const std::string& classLabel(int classId) {
+        return initialTable.attrValueList[initialTable.labelIndex()][classId];
+    }
+
+
+    /*
+    getMajorityLabel() function: computes the majority label and its count over the rows in `rows[begin, end)`.
+    It iterates through the rows, counts occurrences of each class in a flat histogram, and determines
+    which label has the highest count, returning this label along with its count as a pair<string, int>.
+    
+    */
+    std::pair<std::string, int> getMajorityLabel(int begin, int end) {
+        int majorLabel = -1;
+        int majorCount = 0;
+        std::vector<int>& labelCount = workspace().labelCount;
+        const std::vector<int>& labels = initialTable.labels();
+        for (int i = begin; i < end; i++) {
+            if (++labelCount[labels[rows[i]]] > majorCount) {
+                majorCount = labelCount[labels[rows[i]]];
+                majorLabel = labels[rows[i]];
+            }
+        }
+        for (int i = begin; i < end; i++) {
+            labelCount[labels[rows[i]]] = 0;
+        }
+        return {majorLabel == -1 ? "" : classLabel(majorLabel), majorCount};
+    }
+
+    // getClassCounts(): (class ID, rows) of every class among the rows in `rows[begin, end)`, by class ID.
+    std::vector<std::pair<int, int>> getClassCounts(int begin, int end) {
+        std::vector<int>& labelCount = workspace().labelCount;
+        const std::vector<int>& labels = initialTable.labels();
+        for (int i = begin; i < end; i++) {
+            labelCount[labels[rows[i]]]++;
+        }
+        std::vector<std::pair<int, int>> counts;
+        for (int c = 0; c < labelCount.size(); c++) {
+            if (labelCount[c] > 0) {
+                counts.push_back({c, labelCount[c]});
+                labelCount[c] = 0;
+            }
+        }
+        return counts;
+    }
+
+    /*
+    isLeafNode() function: checks if all rows in `rows[begin, end)` have the same class ID.
+    If all rows except the first have the same label, it returns true, indicating that the node is a leaf node in 
+    the context of constructing a decision tree. If there is any difference in labels, it returns false.
+    */
+
+    bool isLeafNode(int begin, int end) {
+        const std::vector<int>& labels = initialTable.labels();
+        for (int i = begin + 1; i < end; i++) {
+            if (labels[rows[begin]] != labels[rows[i]]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /*
+    `getSelectedAttribute()` function selects the split that maximizes the gain ratio over the
+    rows in `rows[begin, end)` when used as the splitting criterion in a decision tree. It iterates through the
+    attributes (excluding the last column assumed to be the label, and any not in `options.allowedAttributes`),
+    scoring categorical attributes by their gain ratio and numeric attributes by their best threshold, and returns the
+    candidate with the highest gain ratio (attrIndex -1 if no attribute has a positive one).
+    */
+
+    SplitCandidate getSelectedAttribute(int begin, int end) {
+        int attrCount = (int)initialTable.attrName.size() - 1;
+        std::vector<SplitCandidate> candidates(attrCount);
+        if (scheduler != nullptr && end - begin >= attributeGrain) {
+            TaskGroup scoring;
+            for (int i = 0; i < attrCount; i++) {
+                if (isAllowed(i)) {
+                    scheduler->spawn(scoring, [this, &candidates, begin, end, i] {
+                        candidates[i] = scoreAttribute(begin, end, i);
+                    });
+                }
+            }
+            scheduler->wait(scoring);
+        } else {
+            for (int i = 0; i < attrCount; i++) {
+                if (isAllowed(i)) {
+                    candidates[i] = scoreAttribute(begin, end, i);
+                }
+            }
+        }
+
+        SplitCandidate selected;
+        for (int i = 0; i < attrCount; i++) {
+            if (selected.gainRatio < candidates[i].gainRatio) {
+                selected = candidates[i];
+            }
+        }
+        return selected;
+    }
+
+    bool isAllowed(int attrIndex) const {
+        return options.allowedAttributes.empty() || options.allowedAttributes[attrIndex];
+    }
+
+    SplitCandidate scoreAttribute(int begin, int end, int attrIndex) {
+        if (initialTable.isNumeric[attrIndex]) {
+            return getThresholdSplit(begin, end, attrIndex);
+        }
+        SplitCandidate candidate;
+        candidate.attrIndex = attrIndex;
+        candidate.gainRatio = getGainRatio(begin, end, attrIndex);
+        return candidate;
+    }
+
+    /*
+    `getThresholdSplit()` function: finds the best binary split `value <= threshold` of a numeric attribute over the
+    rows in `rows[begin, end)`, C4.5 style. It walks the presorted column once, moving one row at a time from the right
+    side to the left while keeping the sum of c * log2(c) over each side's class counts up to date, so the information
+    after every candidate threshold costs O(1). Thresholds sit halfway between adjacent distinct values. The best
+    threshold by information gain is charged log2(candidates) / rows for having been chosen among many (Quinlan's
+    correction) and scored by gain ratio; candidates with no positive corrected gain are not selectable.
+    */
+    SplitCandidate getThresholdSplit(int begin, int end, int attrIndex) {
+        SplitCandidate candidate;
+        candidate.attrIndex = attrIndex;
+        const std::vector<int>& sorted = sortedRows[attrIndex];
+        const std::vector<int>& column = initialTable.columns[attrIndex];
+        const std::vector<double>& number = initialTable.attrNumericValue[attrIndex];
+        const std::vector<int>& labels = initialTable.labels();
+        std::vector<int>& rightCount = workspace().labelCount;
+        std::vector<int>& leftCount = workspace().leftCount;
+        int itemCount = end - begin;
+
+        for (int i = begin; i < end; i++) {
+            rightCount[labels[sorted[i]]]++;
+        }
+        double rightSum = 0.0;
+        double leftSum = 0.0;
+        for (int c = 0; c < rightCount.size(); c++) {
+            rightSum += xlogx[rightCount[c]];
+        }
+        double infoD = (xlogx[itemCount] - rightSum) / itemCount;
+
+        double bestGain = 0.0;
+        int bestLeftCount = 0;
+        int thresholdCount = 0;
+        for (int i = begin; i + 1 < end; i++) {
+            int label = labels[sorted[i]];
+            leftSum += xlogx[leftCount[label] + 1] - xlogx[leftCount[label]];
+            leftCount[label]++;
+            rightSum += xlogx[rightCount[label] - 1] - xlogx[rightCount[label]];
+            rightCount[label]--;
+
+            double low = number[column[sorted[i]]];
+            double high = number[column[sorted[i + 1]]];
+            if (!(low < high)) {
+                continue;
+            }
+            thresholdCount++;
+            int leftItems = i - begin + 1;
+            int rightItems = itemCount - leftItems;
+            double info = (xlogx[leftItems] - leftSum + xlogx[rightItems] - rightSum) / itemCount;
+            if (infoD - info > bestGain) {
+                bestGain = infoD - info;
+                bestLeftCount = leftItems;
+                candidate.threshold = low + (high - low) / 2;
+                if (!(candidate.threshold < high)) {
+                    candidate.threshold = low;
+                }
+            }
+        }
+        for (int i = begin; i < end; i++) {
+            leftCount[labels[sorted[i]]] = 0;
+            rightCount[labels[sorted[i]]] = 0;
+        }
+
+        if (bestLeftCount == 0) {
+            return candidate;
+        }
+        double gain = bestGain - std::log(thresholdCount) / std::log(2) / itemCount;
+        if (gain <= 0.0) {
+            return candidate;
+        }
+        double splitInfo = getEntropyTerm(bestLeftCount, itemCount) + getEntropyTerm(itemCount - bestLeftCount, itemCount);
+        candidate.gainRatio = gain / splitInfo;
+        return candidate;
+    }
+
+    /*
+    `getGainRatio()` function calculates the gain ratio for a specific attribute (`attrIndex`) over the rows in
+    `rows[begin, end)`. It divides the information gain (`getGain()`) by the split information
+    (`getSplitInfoAttrD()`) to determine the effectiveness of the attribute in reducing uncertainty in 
+    the decision tree algorithm.
+    */    
+
+    double getGainRatio(int begin, int end, int attrIndex) {
+        return getGain(begin, end, attrIndex) / getSplitInfoAttrD(begin, end, attrIndex);
+    }
+
+    /*
+    `getInfoD()` function: calculates the entropy (information content) of the class IDs of the rows in
+    `rows[begin, end)`. It computes the entropy using Shannon's entropy formula for discrete probability 
+    distributions, counting each class in a flat histogram and then calculating its contribution to the overall entropy.
+    
+    */    
+
+    double getInfoD(int begin, int end) {
+        std::vector<int>& labelCount = workspace().labelCount;
+        const std::vector<int>& labels = initialTable.labels();
+        for (int i = begin; i < end; i++) {
+            labelCount[labels[rows[i]]]++;
+        }
+        double ret = getEntropy(labelCount, end - begin);
+        for (int i = begin; i < end; i++) {
+            labelCount[labels[rows[i]]] = 0;
+        }
+        return ret;
+    }
+
+    // getEntropyTerm(): contribution -p * log2(p) of a bin holding `count` of `itemCount` items.
+    double getEntropyTerm(int count, int itemCount) {
+        double p = (double)count / itemCount;
+        return -1.0 * p * std::log(p) / std::log(2);
+    }
+
+    // getEntropy(): Shannon entropy (in bits) of a count histogram holding `itemCount` items; empty bins are skipped.
+    double getEntropy(const std::vector<int>& count, int itemCount) {
+        double ret = 0.0;
+        for (int c = 0; c < count.size(); c++) {
+            if (count[c] != 0) {
+                ret += getEntropyTerm(count[c], itemCount);
+            }
+        }
+        return ret;
+    }
+
+    /*
+    countValues(): fills the worker's `valueCount` with the number of rows per code of attribute `attrIndex` in
+    `rows[begin, end)` and lists the codes that occur, in ascending order, in its `touched` list.
+    The caller resets the counters it used through `clearValues()`.
+    */
+    void countValues(int begin, int end, int attrIndex) {
+        const std::vector<int>& column = initialTable.columns[attrIndex];
+        std::vector<int>& valueCount = workspace().valueCount;
+        std::vector<int>& touched = workspace().touched;
+        touched.clear();
+        for (int i = begin; i < end; i++) {
+            if (valueCount[column[rows[i]]]++ == 0) {
+                touched.push_back(column[rows[i]]);
+            }
+        }
+        std::sort(touched.begin(), touched.end());
+    }
+
+    void clearValues() {
+        for (int v : workspace().touched) {
+            workspace().valueCount[v] = 0;
+        }
+    }
+
+    /*
+    
+    `getInfoAttrD()` function: calculates the expected entropy (information content) of a given attribute (`attrIndex`) 
+    over the rows in `rows[begin, end)`. It buckets the class IDs by attribute code and sums the weighted entropy
+    contributions of each distinct attribute value, where the weight is proportional to the frequency of each value in
+    the data set.
+
+    */
+
+    double getInfoAttrD(int begin, int end, int attrIndex) {
+        double ret = 0.0;
+        int itemCount = end - begin;
+        const std::vector<int>& column = initialTable.columns[attrIndex];
+        const std::vector<int>& labels = initialTable.labels();
+        std::vector<int>& valueCount = workspace().valueCount;
+        std::vector<int>& valueStart = workspace().valueStart;
+        std::vector<int>& bucket = workspace().bucket;
+        std::vector<int>& labelCount = workspace().labelCount;
+
+        countValues(begin, end, attrIndex);
+        int position = 0;
+        for (int v : workspace().touched) {
+            valueStart[v] = position;
+            position += valueCount[v];
+        }
+        for (int i = begin; i < end; i++) {
+            bucket[valueStart[column[rows[i]]]++] = labels[rows[i]];
+        }
+
+        // valueStart[v] now points one past the end of the bucket for code v.
+        for (int v : workspace().touched) {
+            int bucketEnd = valueStart[v];
+            int bucketBegin = bucketEnd - valueCount[v];
+            for (int i = bucketBegin; i < bucketEnd; i++) {
+                labelCount[bucket[i]]++;
+            }
+            ret += (double)valueCount[v] / itemCount * getEntropy(labelCount, valueCount[v]);
+            for (int i = bucketBegin; i < bucketEnd; i++) {
+                labelCount[bucket[i]] = 0;
+            }
+        }
+        clearValues();
+        return ret;
+    }
+
+    /*
+    
+    `getGain()` function: calculates the information gain achieved by splitting the rows in `rows[begin, end)`
+    based on a specified attribute (`attrIndex`). It quantifies how much uncertainty about the final outcome (entropy) 
+    decreases after splitting the data according to the attribute, by subtracting the expected entropy of the attribute 
+    (`getInfoAttrD()`) from the overall entropy (`getInfoD()`).
+    
+    */
+
+    double getGain(int begin, int end, int attrIndex) {
+        return getInfoD(begin, end) - getInfoAttrD(begin, end, attrIndex);
+    }
+
+    /*
+    
+    `getSplitInfoAttrD()` function: calculates the split information for a given attribute (`attrIndex`) over the
+    rows in `rows[begin, end)`. It measures the amount of uncertainty associated with the distribution of attribute
+    values across the dataset, using Shannon's entropy formula on the histogram of attribute codes.
+    
+    */
+
+    double getSplitInfoAttrD(int begin, int end, int attrIndex) {
+        double ret = 0.0;
+        countValues(begin, end, attrIndex);
+        for (int v : workspace().touched) {
+            ret += getEntropyTerm(workspace().valueCount[v], end - begin);
+        }
+        clearValues();
+        return ret;
+    }
+
+    // printTree(): Prints the decision tree in a readable format.
+    void printTree(int nodeIndex, std::string branch) {
+        if (tree[nodeIndex].isLeaf) {
+            std::cout << branch << "Label: " << tree[nodeIndex].label << "\n";
+        }
+        for (int i = 0; i < tree[nodeIndex].children.size(); i++) {
+            int childIndex = tree[nodeIndex].children[i];
+            std::string attributeName = initialTable.attrName[tree[nodeIndex].criteriaAttrIndex];
+            std::string attributeValue = tree[childIndex].attrValue;
+            std::string relation = tree[nodeIndex].isContinuous ? " " : " = ";
+            printTree(childIndex, branch + attributeName + relation + attributeValue + ", ");
+        }
+    }
+
+    // Method to serialize the decision tree to JSON
+    nlohmann::json serializeTreeToJson() {
+        return serializeNodesToJson(tree, initialTable.attrValueList[initialTable.labelIndex()]);
+    }
+
+    // Method to write the decision tree in the binary model format (see model_format.h) read by predict.cpp
+    bool serializeTreeToBinary(const std::string& path) {
+        return serializeNodesToBinary(tree, initialTable.attrValueList[initialTable.labelIndex()], path);
+    }
+
+    /*
+    serializeTreeToCpp(): writes the tree as a self-contained C++ header. The tree becomes nested if/else code inside
+    `predictCropGenerated(row, rowSize)`: continuous nodes compare a number parsed once at the top of the function,
+    categorical nodes compare string_views, and leaves return their label (nullptr when no child matches). Including
+    the header gives a predictor with no model file to load; see predict_aot.cpp.
+    */
+    void serializeTreeToCpp(std::ostream& out) {
+        std::vector<bool> parsed(initialTable.attrName.size(), false);
+        for (const Node& node : tree) {
+            if (!node.isLeaf && node.isContinuous) {
+                parsed[node.criteriaAttrIndex] = true;
+            }
+        }
+
+        out << "// Generated by `decision --emit-cpp` from the trained decision tree. Do not edit.\n";
+        out << "#ifndef CROP_PREDICTION_MODEL_H\n#define CROP_PREDICTION_MODEL_H\n\n";
+        out << "#include <charconv>\n#include <cstddef>\n#include <string_view>\n\n";
+        out << "// attributes the model reads, in row order\n";
+        out << "inline constexpr const char* CROP_MODEL_ATTRIBUTES[] = {";
+        for (int j = 0; j < initialTable.labelIndex(); j++) {
+            out << (j ? ", " : "") << cppString(initialTable.attrName[j]);
+        }
+        out << "};\n";
+        out << "inline constexpr std::size_t CROP_MODEL_ATTRIBUTE_COUNT = " << initialTable.labelIndex() << ";\n\n";
+        out << "inline bool parseCropModelNumber(std::string_view text, double& number) {\n";
+        out << "    while (!text.empty() && (text.front() == ' ' || text.front() == '\\t' || text.front() == '+')) {\n";
+        out << "        text.remove_prefix(1);\n    }\n";
+        out << "    while (!text.empty() && (text.back() == ' ' || text.back() == '\\t' || text.back() == '\\r')) {\n";
+        out << "        text.remove_suffix(1);\n    }\n";
+        out << "    auto result = std::from_chars(text.data(), text.data() + text.size(), number);\n";
+        out << "    return !text.empty() && result.ec == std::errc() && result.ptr == text.data() + text.size();\n}\n\n";
+        out << "// predicted label of `row` (CROP_MODEL_ATTRIBUTE_COUNT fields convertible to std::string_view), or nullptr.\n";
+        out << "template <typename Row>\n";
+        out << "const char* predictCropGenerated(const Row& row, std::size_t rowSize) {\n";
+        out << "    if (rowSize < CROP_MODEL_ATTRIBUTE_COUNT) {\n        return nullptr;\n    }\n";
+        for (int j = 0; j < parsed.size(); j++) {
+            if (parsed[j]) {
+                out << "    double x" << j << ";\n";
+                out << "    if (!parseCropModelNumber(std::string_view(row[" << j << "]), x" << j << ")) {\n";
+                out << "        return nullptr;\n    }\n";
+            }
+        }
+        emitCppNode(out, 0, 1);
+        out << "}\n\n#endif\n";
+    }
+
+    void emitCppNode(std::ostream& out, int nodeIndex, int depth) {
+        const Node& node = tree[nodeIndex];
+        std::string indent(depth * 4, ' ');
+        if (node.isLeaf) {
+            out << indent << "return " << cppString(node.label) << ";\n";
+            return;
+        }
+        int attr = node.criteriaAttrIndex;
+        if (node.isContinuous) {
+            out << indent << "if (x" << attr << " <= " << std::setprecision(17) << node.threshold << ") {\n";
+            emitCppNode(out, node.children[0], depth + 1);
+            out << indent << "} else {\n";
+            emitCppNode(out, node.children[1], depth + 1);
+            out << indent << "}\n";
+            return;
+        }
+        std::string value = "value" + std::to_string(depth);
+        out << indent << "{\n";
+        out << indent << "    std::string_view " << value << "(row[" << attr << "]);\n";
+        for (int i = 0; i < node.children.size(); i++) {
+            out << indent << "    " << (i ? "} else if" : "if") << " (" << value << " == "
+                << cppString(tree[node.children[i]].attrValue) << ") {\n";
+            emitCppNode(out, node.children[i], depth + 2);
+        }
+        out << indent << "    }\n";
+        out << indent << "    return nullptr;\n";
+        out << indent << "}\n";
+    }
+
+    // cppString(): `text` as a C++ string literal.
+    static std::string cppString(const std::string& text) {
+        std::ostringstream literal;
+        literal << '"';
+        for (unsigned char c : text) {
+            if (c == '"' || c == '\\') {
+                literal << '\\' << c;
+            } else if (c < 0x20 || c >= 0x7F) {
+                literal << "\\" << std::oct << std::setw(3) << std::setfill('0') << (int)c << std::dec << std::setfill(' ');
+            } else {
+                literal << c;
+            }
+        }
+        literal << '"';
+        return literal.str();
+    }
+};
+
+/*
+How a `RandomForest` is grown: `treeCount` trees, each on its own bootstrap sample of the rows (drawn with
+replacement, as many as there are rows) and its own random subset of `attributesPerTree` attributes.
+*/
+class ForestOptions {
+public:
+    int treeCount = 25;
+    int threadCount = 1;                // trees trained at the same time.
+    unsigned seed = 1;                  // tree t draws its sample and attributes from a generator seeded with seed + t.
+    int attributesPerTree = 0;          // 0 = half of the attributes, rounded up.
+    double purityCutoff = 0.8;
+};
+
+/*
+`RandomForest` is a bagged ensemble of `DecisionTree`s. Every tree reads the same encoded `Table`; only its row sample
+and attribute subset differ. Trees are independent, so each is built serially as one task on a shared work-stealing
+pool, and training N trees on N cores takes about as long as training one. Because each tree's randomness comes from
+its own seed, the forest does not depend on the number of threads. Rows a tree never drew are out of bag for it; the
+majority vote of those trees on those rows estimates the forest's accuracy on unseen data.
+*/
+class RandomForest {
+public:
+    const Table& initialTable;                  // shared read-only by every tree.
+    std::vector<std::unique_ptr<DecisionTree>> trees;
+    std::vector<std::vector<bool>> inBag;       // inBag[t][row]: row was drawn for tree t.
+
+    RandomForest(const Table& table, const ForestOptions& options) : initialTable(table) {
+        int attrCount = initialTable.labelIndex();
+        int attributesPerTree = options.attributesPerTree > 0 ? std::min(options.attributesPerTree, attrCount)
+                                                              : (attrCount + 1) / 2;
+        trees.resize(options.treeCount);
+        inBag.assign(options.treeCount, std::vector<bool>());
+
+        TaskScheduler pool(std::max(1, options.threadCount));
+        TaskGroup training;
+        for (int t = 0; t < options.treeCount; t++) {
+            pool.spawn(training, [this, &options, attrCount, attributesPerTree, t] {
+                std::mt19937 random(options.seed + t);
+                TreeOptions treeOptions;
+                treeOptions.purityCutoff = options.purityCutoff;
+                std::uniform_int_distribution<int> pickRow(0, initialTable.rowCount() - 1);
+                treeOptions.sampleRows.resize(initialTable.rowCount());
+                inBag[t].assign(initialTable.rowCount(), false);
+                for (int& row : treeOptions.sampleRows) {
+                    row = pickRow(random);
+                    inBag[t][row] = true;
+                }
+                std::vector<int> attributes(attrCount);
+                for (int j = 0; j < attrCount; j++) {
+                    attributes[j] = j;
+                }
+                std::shuffle(attributes.begin(), attributes.end(), random);
+                treeOptions.allowedAttributes.assign(attrCount + 1, false);
+                for (int j = 0; j < attributesPerTree; j++) {
+                    treeOptions.allowedAttributes[attributes[j]] = true;
+                }
+                trees[t].reset(new DecisionTree(initialTable, treeOptions));
+            });
+        }
+        pool.wait(training);
+    }
+
+    /*
+    outOfBagAccuracy(): share of rows whose majority vote over the trees that did not train on them matches their
+    label. Rows that every tree drew are skipped; returns -1 if no row is out of bag.
+    */
+    double outOfBagAccuracy() const {
+        int scored = 0;
+        int correct = 0;
+        std::unordered_map<std::string, int> votes;
+        for (int row = 0; row < initialTable.rowCount(); row++) {
+            votes.clear();
+            const std::string* predicted = nullptr;
+            int predictedVotes = 0;
+            for (int t = 0; t < trees.size(); t++) {
+                if (inBag[t][row]) {
+                    continue;
+                }
+                const std::string& label = trees[t]->classify(row);
+                int count = ++votes[label];
+                if (count > predictedVotes) {
+                    predictedVotes = count;
+                    predicted = &label;
+                }
+            }
+            if (predicted == nullptr) {
+                continue;
+            }
+            scored++;
+            const std::string& actual = initialTable.attrValueList[initialTable.labelIndex()][initialTable.labels()[row]];
+            if (*predicted == actual) {
+                correct++;
+            }
+        }
+        return scored == 0 ? -1.0 : (double)correct / scored;
+    }
+
+    // Method to serialize the forest to JSON: {"trees": [tree, ...]}, each tree in the single-tree format.
+    nlohmann::json serializeForestToJson() {
+        nlohmann::json forestJson;
+        forestJson["trees"] = nlohmann::json::array();
+        for (const std::unique_ptr<DecisionTree>& tree : trees) {
+            forestJson["trees"].push_back(tree->serializeTreeToJson());
+        }
+        return forestJson;
+    }
+};
+
+/*
+`InputReader` class reads a CSV file (`filename`) into a `Table`: the header row gives the attribute names
+(`attrName`) and every other line is a row whose comma-separated fields are encoded straight into `columns`, without
+building string rows. The file is memory-mapped and cut into newline-aligned chunks that are tokenized concurrently,
+each field a string_view into the mapping looked up in a per-chunk dictionary. The chunk dictionaries are then merged
+into the table's dictionaries (one task per attribute) and every chunk's codes rewritten to the merged codes at its
+rows' place in file order, so the table is the same for any number of threads. Blank lines are ignored and lines
+with a different number of fields than the header are skipped with a warning.
+*/
+class InputReader {
+private:
+    Table table;            // stores data that is read from the file.
+
+    static const size_t chunkBytes = 1 << 20;      // smallest chunk parsed as a task.
+
+    // rows of one chunk: per attribute, the chunk's distinct values (first-seen order) and each row's local code.
+    struct Chunk {
+        const char* begin = nullptr;
+        const char* end = nullptr;
+        std::vector<std::vector<std::string_view>> values;
+        std::vector<std::vector<int>> codes;
+        int rowCount = 0;
+        int skipped = 0;
+    };
+
+public:
+    InputReader(std::string filename, int threadCount = 1) {
+        MappedFile file;
+        if (!file.open(filename)) {
+            std::cout << filename << " file could not be opened\n";
+            std::exit(1);
+        }
+        std::string_view text = file.view();
+        size_t headerEnd = std::min(text.find('\n'), text.size());
+        splitFields(trimLine(text.substr(0, headerEnd)), table.attrName);
+        size_t attrCount = table.attrName.size();
+
+        // newline-aligned chunks, a few per thread so that uneven chunks still balance.
+        const char* bodyBegin = text.data() + std::min(headerEnd + 1, text.size());
+        const char* bodyEnd = text.data() + text.size();
+        size_t bodySize = bodyEnd - bodyBegin;
+        size_t chunkCount = std::max<size_t>(1, std::min<size_t>(bodySize / chunkBytes, (size_t)std::max(1, threadCount) * 4));
+        std::vector<Chunk> chunks(chunkCount);
+        const char* position = bodyBegin;
+        for (size_t c = 0; c < chunkCount; c++) {
+            chunks[c].begin = position;
+            const char* target = c + 1 == chunkCount ? bodyEnd : bodyBegin + bodySize * (c + 1) / chunkCount;
+            target = std::max(target, position);
+            const char* newline = static_cast<const char*>(memchr(target, '\n', bodyEnd - target));
+            position = (newline == nullptr || c + 1 == chunkCount) ? bodyEnd : newline + 1;
+            chunks[c].end = position;
+        }
+
+        TaskScheduler pool(threadCount);
+        TaskGroup parsing;
+        for (Chunk& chunk : chunks) {
+            pool.spawn(parsing, [&chunk, attrCount] { parseChunk(chunk, attrCount); });
+        }
+        pool.wait(parsing);
+
+        std::vector<int> rowStart(chunkCount + 1, 0);
+        int skipped = 0;
+        for (size_t c = 0; c < chunkCount; c++) {
+            rowStart[c + 1] = rowStart[c] + chunks[c].rowCount;
+            skipped += chunks[c].skipped;
+        }
+        if (skipped > 0) {
+            std::cerr << filename << ": skipped " << skipped << " lines without " << attrCount << " fields\n";
+        }
+
+        table.attrValueList.assign(attrCount, std::vector<std::string>());
+        table.columns.assign(attrCount, std::vector<int>(rowStart[chunkCount]));
+        table.isNumeric.assign(attrCount, false);
+        table.attrNumericValue.assign(attrCount, std::vector<double>());
+        TaskGroup encoding;
+        for (size_t j = 0; j < attrCount; j++) {
+            pool.spawn(encoding, [this, &chunks, &rowStart, j] { encodeAttribute(chunks, rowStart, (int)j); });
+        }
+        pool.wait(encoding);
+    }
+
+    const Table& getTable() const {
+        return table;
+    }
+
+private:
+    static std::string_view trimLine(std::string_view line) {
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        return line;
+    }
+
+    template <typename Field>
+    static void splitFields(std::string_view line, std::vector<Field>& fields) {
+        fields.clear();
+        size_t start = 0;
+        while (true) {
+            size_t comma = line.find(',', start);
+            fields.push_back(Field(line.substr(start, comma == std::string_view::npos ? std::string_view::npos : comma - start)));
+            if (comma == std::string_view::npos) {
+                break;
+            }
+            start = comma + 1;
+        }
+    }
+
+    // parseChunk(): tokenizes the lines of one chunk into its local dictionaries and codes.
+    static void parseChunk(Chunk& chunk, size_t attrCount) {
+        chunk.values.assign(attrCount, std::vector<std::string_view>());
+        chunk.codes.assign(attrCount, std::vector<int>());
+        std::vector<std::unordered_map<std::string_view, int>> localCode(attrCount);
+        std::vector<std::string_view> fields;
+        const char* position = chunk.begin;
+        while (position < chunk.end) {
+            const char* newline = static_cast<const char*>(memchr(position, '\n', chunk.end - position));
+            const char* lineEnd = newline == nullptr ? chunk.end : newline;
+            std::string_view line = trimLine(std::string_view(position, lineEnd - position));
+            position = lineEnd + 1;
+            if (line.empty()) {
+                continue;
+            }
+            splitFields(line, fields);
+            if (fields.size() != attrCount) {
+                chunk.skipped++;
+                continue;
+            }
+            for (size_t j = 0; j < attrCount; j++) {
+                auto found = localCode[j].emplace(fields[j], (int)chunk.values[j].size());
+                if (found.second) {
+                    chunk.values[j].push_back(fields[j]);
+                }
+                chunk.codes[j].push_back(found.first->second);
+            }
+            chunk.rowCount++;
+        }
+    }
+
+    // encodeAttribute(): merges the chunk dictionaries of attribute j and writes its column in file order.
+    void encodeAttribute(const std::vector<Chunk>& chunks, const std::vector<int>& rowStart, int j) {
+        std::unordered_map<std::string_view, int> code;
+        std::vector<std::string> distinct;
+        for (const Chunk& chunk : chunks) {
+            for (std::string_view value : chunk.values[j]) {
+                if (code.emplace(value, 0).second) {
+                    distinct.push_back(std::string(value));
+                }
+            }
+        }
+        table.setDictionary(j, std::move(distinct));
+        const std::vector<std::string>& dictionary = table.attrValueList[j];
+        for (int v = 0; v < dictionary.size(); v++) {
+            code[dictionary[v]] = v;
+        }
+
+        std::vector<int>& column = table.columns[j];
+        std::vector<int> remap;
+        for (size_t c = 0; c < chunks.size(); c++) {
+            remap.clear();
+            for (std::string_view value : chunks[c].values[j]) {
+                remap.push_back(code[value]);
+            }
+            const std::vector<int>& local = chunks[c].codes[j];
+            for (int i = 0; i < local.size(); i++) {
+                column[rowStart[c] + i] = remap[local[i]];
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,211 @@
+#ifndef EVENT_SCHEDULER_H
+#define EVENT_SCHEDULER_H
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+/*
+`SchedulerClock` is the time source of an EventScheduler. `RealClock` is the wall clock: waiting for a deadline sleeps
+until it passes. `SimulatedClock` is virtual time for discrete-event simulation: waiting for a deadline jumps straight
+to it, so a season of events runs as fast as the events themselves. Virtual time starts at `start` on the wall clock
+and only moves when the scheduler waits, so a simulation whose events are all scheduled from the scheduler's own
+thread (or before `run()`) runs the same way every time.
+*/
+class SchedulerClock {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    virtual ~SchedulerClock() = default;
+    virtual Clock::time_point now() = 0;
+    virtual std::chrono::system_clock::time_point wallNow() = 0;     // now() on the wall clock, for timestamps.
+    // waitUntil(): returns at `deadline`, or earlier if `wake` is signalled; `lock` holds the scheduler's mutex.
+    virtual void waitUntil(std::unique_lock<std::mutex>& lock, std::condition_variable& wake,
+                           Clock::time_point deadline) = 0;
+};
+
+class RealClock : public SchedulerClock {
+public:
+    Clock::time_point now() override {
+        return Clock::now();
+    }
+
+    std::chrono::system_clock::time_point wallNow() override {
+        return std::chrono::system_clock::now();
+    }
+
+    void waitUntil(std::unique_lock<std::mutex>& lock, std::condition_variable& wake,
+                   Clock::time_point deadline) override {
+        wake.wait_until(lock, deadline);
+    }
+};
+
+class SimulatedClock : public SchedulerClock {
+public:
+    explicit SimulatedClock(std::chrono::system_clock::time_point start) : start(start) {
+    }
+
+    Clock::time_point now() override {
+        return current;
+    }
+
+    std::chrono::system_clock::time_point wallNow() override {
+        return start + std::chrono::duration_cast<std::chrono::system_clock::duration>(current - Clock::time_point());
+    }
+
+    void waitUntil(std::unique_lock<std::mutex>&, std::condition_variable&, Clock::time_point deadline) override {
+        current = std::max(current, deadline);
+    }
+
+private:
+    std::chrono::system_clock::time_point start;
+    Clock::time_point current;                  // virtual time, from Clock's epoch.
+};
+
+/*
+`EventScheduler` runs timed events on one thread. Events sit in a min-heap ordered by deadline, and `run()` sleeps
+on a condition variable until the earliest deadline instead of polling the clock, so an idle scheduler uses no CPU.
+Periodic events are re-armed from their previous deadline, not from the time they finished, so they do not drift.
+Events with the same deadline run in the order they were first scheduled, re-armed periodic ones included; that is
+also the order their slightly different wall-clock deadlines put them in, so simulated time runs them the same way.
+Every action runs on the thread that called `run()`, so the state they share needs no locking; other threads may
+schedule, cancel or stop at any time. Time comes from a SchedulerClock, the wall clock unless another one is given.
+*/
+class EventScheduler {
+public:
+    using Clock = SchedulerClock::Clock;
+    using Action = std::function<void()>;
+
+    explicit EventScheduler(std::unique_ptr<SchedulerClock> clock = std::unique_ptr<SchedulerClock>(new RealClock()))
+        : clock(std::move(clock)) {
+    }
+
+    Clock::time_point now() {
+        return clock->now();
+    }
+
+    std::chrono::system_clock::time_point wallNow() {
+        return clock->wallNow();
+    }
+
+    // schedule(): runs `action` at `when`; returns an id for cancel().
+    int schedule(Clock::time_point when, Action action) {
+        return add(when, Clock::duration::zero(), std::move(action));
+    }
+
+    int scheduleAfter(Clock::duration delay, Action action) {
+        return add(clock->now() + delay, Clock::duration::zero(), std::move(action));
+    }
+
+    // scheduleEvery(): runs `action` every `period`, the first time after `firstDelay`.
+    int scheduleEvery(Clock::duration period, Action action, Clock::duration firstDelay) {
+        return add(clock->now() + firstDelay, period, std::move(action));
+    }
+
+    // cancel(): drops a pending (or periodic) event; false if it is unknown or has already run for the last time.
+    bool cancel(int id) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (id == runningId) {
+            return cancelled.insert(id).second;
+        }
+        for (const Event& event : events) {
+            if (event.id == id) {
+                return cancelled.insert(id).second;
+            }
+        }
+        return false;
+    }
+
+    // run(): executes events as their deadlines pass until stop() is called.
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!stopping) {
+            if (events.empty()) {
+                wake.wait(lock);
+                continue;
+            }
+            Clock::time_point deadline = events.front().when;
+            if (clock->now() < deadline) {
+                clock->waitUntil(lock, wake, deadline);
+                continue;       // an earlier event may have been added, or stop() called.
+            }
+            std::pop_heap(events.begin(), events.end(), later);
+            Event event = std::move(events.back());
+            events.pop_back();
+            if (cancelled.erase(event.id) > 0) {
+                continue;
+            }
+
+            runningId = event.id;
+            lock.unlock();
+            event.action();
+            lock.lock();
+            runningId = 0;
+
+            if (event.period > Clock::duration::zero() && cancelled.erase(event.id) == 0) {
+                event.when += event.period;
+                events.push_back(std::move(event));
+                std::push_heap(events.begin(), events.end(), later);
+            }
+        }
+        stopping = false;
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+    }
+
+    size_t pendingCount() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return std::count_if(events.begin(), events.end(),
+                             [this](const Event& event) { return cancelled.count(event.id) == 0; });
+    }
+
+private:
+    struct Event {
+        Clock::time_point when;
+        uint64_t sequence;              // breaks deadline ties in the order events were first scheduled.
+        int id;
+        Clock::duration period;         // zero for one-shot events.
+        Action action;
+    };
+
+    std::unique_ptr<SchedulerClock> clock;
+    std::mutex mutex;
+    std::condition_variable wake;       // signalled when an event is added or stop() is called.
+    std::vector<Event> events;          // min-heap by (when, sequence).
+    std::unordered_set<int> cancelled;  // ids of pending events to drop when they come due.
+    uint64_t nextSequence = 0;
+    int nextId = 1;
+    int runningId = 0;                  // event whose action is executing, 0 if none.
+    bool stopping = false;
+
+    static bool later(const Event& a, const Event& b) {
+        return a.when != b.when ? a.when > b.when : a.sequence > b.sequence;
+    }
+
+    int add(Clock::time_point when, Clock::duration period, Action action) {
+        int id;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            id = nextId++;
+            events.push_back(Event{when, nextSequence++, id, period, std::move(action)});
+            std::push_heap(events.begin(), events.end(), later);
+        }
+        wake.notify_all();
+        return id;
+    }
+};
+
+#endif
@@ -0,0 +1,127 @@
+#ifndef FLEET_H
+#define FLEET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+/*
+`FieldFleet` simulates many plots at once with the rules of CropHealthMonitoringSystem in chms.cpp: soil moisture
+drops every tick (one tick is one second), pH drops by 1 every 3 ticks, a plot below 30% moisture starts 3 ticks of
+irrigation that end with moisture at 100%, and a plot below pH 4 starts 5 ticks of fertilizing that end with pH 12.
+
+State is kept as struct-of-arrays: one contiguous array per field attribute, indexed by plot. `tick()` is two loops
+over all plots, one for the moisture arrays and one for the pH arrays, that only do arithmetic, compares and selects,
+with no branches and no calls on 32-bit lanes, so the compiler can vectorize them (build with -O3, and -march=native
+to use the widest SIMD registers available). An actuator's state is its end tick, 0 meaning off. Plots start with
+random levels and decay rates so they do not all alert on the same tick.
+*/
+class FieldFleet {
+public:
+    static constexpr float MOISTURE_THRESHOLD = 30.0f;
+    static constexpr float PH_THRESHOLD = 4.0f;
+    static constexpr float MOISTURE_FULL = 100.0f;
+    static constexpr float PH_FULL = 12.0f;
+    static constexpr uint32_t PH_DECAY_TICKS = 3;
+    static constexpr uint32_t IRRIGATION_TICKS = 3;
+    static constexpr uint32_t FERTILIZER_TICKS = 5;
+
+    std::vector<float> moisture;            // soil moisture level of each plot, in %.
+    std::vector<float> ph;                  // pH level of each plot.
+    std::vector<float> moistureDecay;       // moisture lost per tick.
+    std::vector<uint32_t> phCountdown;      // ticks until the next pH drop.
+    std::vector<uint32_t> irrigationEnd;    // tick at which the running irrigation stops; 0 while it is off.
+    std::vector<uint32_t> fertilizerEnd;    // tick at which the running fertilizing stops; 0 while it is off.
+    uint32_t now = 0;                       // ticks simulated so far.
+    uint64_t irrigationStarts = 0;          // actuator runs started, over all plots and ticks.
+    uint64_t fertilizerStarts = 0;
+
+    FieldFleet(size_t fieldCount, unsigned seed) {
+        std::mt19937 random(seed);
+        std::uniform_real_distribution<float> startMoisture(40.0f, MOISTURE_FULL);
+        std::uniform_real_distribution<float> startPh(6.0f, PH_FULL);
+        std::uniform_real_distribution<float> decay(4.0f, 6.0f);
+        moisture.resize(fieldCount);
+        ph.resize(fieldCount);
+        moistureDecay.resize(fieldCount);
+        phCountdown.resize(fieldCount);
+        for (size_t i = 0; i < fieldCount; i++) {
+            moisture[i] = startMoisture(random);
+            ph[i] = startPh(random);
+            moistureDecay[i] = decay(random);
+            phCountdown[i] = 1 + random() % PH_DECAY_TICKS;
+        }
+        irrigationEnd.assign(fieldCount, 0);
+        fertilizerEnd.assign(fieldCount, 0);
+    }
+
+    size_t size() const {
+        return moisture.size();
+    }
+
+    bool isIrrigating(size_t field) const {
+        return irrigationEnd[field] != 0;
+    }
+
+    bool isFertilizing(size_t field) const {
+        return fertilizerEnd[field] != 0;
+    }
+
+    // tick(): advances every plot by one second: sensor decay, finished actuators, then threshold checks.
+    void tick() {
+        now++;
+        updateMoisture();
+        updatePh();
+    }
+
+private:
+    /*
+    updateMoisture(): per plot, moisture drops by the plot's rate (stopping at 0), a finished irrigation refills it to
+    100%, and a plot below the threshold whose irrigation was off starts a run. One pass, so each array is read once.
+    A plot whose run just finished is full and cannot start another, so the start test only needs the state before
+    the tick; keeping the two conditions independent is what lets the compiler turn the loop body into selects.
+    */
+    void updateMoisture() {
+        size_t n = size();
+        uint32_t t = now;
+        float* m = moisture.data();
+        const float* rate = moistureDecay.data();
+        uint32_t* end = irrigationEnd.data();
+        uint32_t starts = 0;
+        for (size_t i = 0; i < n; i++) {
+            float decayed = m[i] - rate[i];
+            uint32_t stop = end[i];
+            bool done = (stop != 0) & (stop <= t);
+            bool start = (decayed < MOISTURE_THRESHOLD) & (stop == 0);
+            m[i] = done ? MOISTURE_FULL : (decayed < 0.0f ? 0.0f : decayed);
+            end[i] = start ? t + IRRIGATION_TICKS : (done ? 0 : stop);
+            starts += start;
+        }
+        irrigationStarts += starts;
+    }
+
+    // updatePh(): the same for pH, which drops by 1 each time the plot's countdown runs out; fertilizing restores it.
+    void updatePh() {
+        size_t n = size();
+        uint32_t t = now;
+        float* p = ph.data();
+        uint32_t* countdown = phCountdown.data();
+        uint32_t* end = fertilizerEnd.data();
+        uint32_t starts = 0;
+        for (size_t i = 0; i < n; i++) {
+            bool due = countdown[i] == 1;
+            countdown[i] = due ? PH_DECAY_TICKS : countdown[i] - 1;
+            float decayed = p[i] - (due ? 1.0f : 0.0f);
+            uint32_t stop = end[i];
+            bool done = (stop != 0) & (stop <= t);
+            bool start = (decayed < PH_THRESHOLD) & (stop == 0);
+            p[i] = done ? PH_FULL : (decayed < 0.0f ? 0.0f : decayed);
+            end[i] = start ? t + FERTILIZER_TICKS : (done ? 0 : stop);
+            starts += start;
+        }
+        fertilizerStarts += starts;
+    }
+};
+
+#endif
@@ -0,0 +1,1100 @@
+#ifndef HOEFFDING_TREE_H
+#define HOEFFDING_TREE_H
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "decision_tree.h"
+#include "mapped_file.h"
+#include "model_format.h"
+
+/*
+Incremental learner for the crop classifier: a Hoeffding tree (VFDT) that learns new labelled rows as they arrive
+instead of retraining on the whole history.
+
+Every node keeps the sufficient statistics of the rows that passed through it: their number per class and, for a
+categorical attribute, their number per (value, class). A numeric attribute keeps, per class, the number, mean,
+variance, minimum and maximum of its values, and takes them as normally distributed (as MOA's Gaussian observer does). A
+row is added to the statistics of each node on its path. Once a node has seen enough new rows it scores every split from
+its statistics alone by information gain. A numeric attribute is split on the best of a fixed set of thresholds: each
+class's maximum and HOEFFDING_SPLIT_POINTS points evenly spaced across the values seen, with the rows of a class on
+either side estimated from its normal distribution. A leaf splits once the Hoeffding bound makes it unlikely that the
+best split only looks better than the runner-up by chance: the gain difference exceeds
+epsilon = R * sqrt(ln(1 / confidence) / 2n) after n rows (R the range of the gain, see epsilon()), or epsilon has
+dropped below the tie threshold. An inner node is re-checked against its current split in the same way (as in EFDT);
+when another attribute is better with the same confidence, only that node's subtree is replaced by the new split. New
+children start with the class counts the split statistics give them and with empty attribute statistics.
+
+A node is evaluated after gracePeriod new rows and then whenever its row count has grown by another eighth, so the
+evaluation work per node stays O(n log n) however long the stream gets. The statistics of a node take
+O(attributes * classes) memory (times the number of values for a categorical attribute), however many rows it has seen.
+
+The learner state (attributes, classes, the tree with its statistics and how many bytes of each input file have been
+learned) is a binary file laid out like the model file (see model_format.h):
+
+    uint32_t stringOffset[stringCount + 1]  attribute names, class names, categorical values and input paths
+    char     stringData[stringBytes]
+    uint8_t  numeric[attrCount]             whether an attribute is numeric
+    uint32_t valueCount[attrCount]          number of values of a categorical attribute
+    uint64_t inputOffset[inputCount]        bytes of each input file already learned
+    int32_t  nodeAttr[nodeCount]            nodes in depth-first order: attribute split on (-1 for leaves)
+    double   nodeThreshold[nodeCount]
+    uint32_t nodeValue[nodeCount]           categorical value id leading to the node
+    uint32_t nodeChildCount[nodeCount]
+    uint64_t nodeNextCheck[nodeCount]       rows seen at which the node is next evaluated
+    uint64_t classCount[nodeCount * classCount]
+    uint64_t seenCount[nodeCount * classCount]
+    uint32_t entryCount[nodeCount * (attrCount - 1)]   (value, class) entries of each node's attributes, 0 if numeric
+    uint32_t entryValue[entryTotal]         value id
+    uint32_t entryClass[entryTotal]
+    uint32_t entryRows[entryTotal]
+    uint32_t numericCount[nodeCount * (attrCount - 1)] classes seen with each node's attributes, 0 if categorical
+    uint32_t numericClass[numericTotal]
+    NumericClassStats numericStats[numericTotal]
+
+so each run only reads the rows appended to its input files since the previous one.
+*/
+
+const char HOEFFDING_STATE_MAGIC[4] = {'C', 'R', 'H', 'T'};
+const uint32_t HOEFFDING_STATE_VERSION = 2;             // 2 summarizes numeric attributes per class.
+const uint32_t HOEFFDING_SPLIT_POINTS = 10;             // evenly spaced thresholds scored per numeric attribute.
+
+struct HoeffdingStateHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t attrCount;
+    uint32_t classCount;
+    uint32_t inputCount;
+    uint32_t nodeCount;
+    uint32_t stringCount;
+    uint64_t stringBytes;
+    uint64_t entryTotal;
+    uint64_t numericTotal;
+    uint64_t rowCount;
+    uint32_t checksum;
+    uint32_t reserved;
+    uint64_t fileSize;
+};
+
+/*
+How a `HoeffdingTree` grows. The options are not part of the state, so a run can change them for the rows it learns.
+The defaults suit the crop data, where the 22 classes leave few rows per leaf: one pass over 1760 rows of
+Crop_recommendation.csv grows a tree that classifies 89% of the other 440 correctly (the batch DecisionTree: 97%),
+and 95% once the same rows have been appended three more times.
+*/
+class HoeffdingOptions {
+public:
+    double confidence = 1e-3;           // chance that a split the bound accepts is not the best one.
+    double tieThreshold = 0.25;         // split once epsilon is this small, however close the best candidates are.
+    uint32_t gracePeriod = 20;          // fewest new rows a node sees between two evaluations.
+    double purityCutoff = 0.8;          // as in TreeOptions: a leaf whose majority exceeds this share stays a leaf.
+};
+
+// rows with one (value, class) pair of a categorical attribute seen at a node.
+struct ValueCount {
+    uint32_t value;                     // the value id.
+    uint32_t classId;
+    uint32_t rows;
+};
+
+// the values of a numeric attribute seen with one class at a node, summarized as a normal distribution.
+struct NumericClassStats {
+    uint64_t rows = 0;
+    double mean = 0.0;
+    double m2 = 0.0;                    // sum of squared differences from the mean.
+    double minimum = INFINITY;
+    double maximum = -INFINITY;
+
+    void add(double value) {
+        rows++;
+        double delta = value - mean;
+        mean += delta / rows;
+        m2 += delta * (value - mean);
+        minimum = std::min(minimum, value);
+        maximum = std::max(maximum, value);
+    }
+
+    // rowsAtMost(): the estimated number of these rows with a value <= threshold.
+    double rowsAtMost(double threshold) const {
+        if (rows == 0 || threshold < minimum) {
+            return 0.0;
+        }
+        if (threshold >= maximum) {
+            return (double)rows;
+        }
+        double deviation = std::sqrt(m2 / rows);
+        if (!(deviation > 0.0)) {
+            return threshold >= mean ? (double)rows : 0.0;
+        }
+        return rows * 0.5 * std::erfc((mean - threshold) / (deviation * std::sqrt(2.0)));
+    }
+};
+
+/*
+The statistics of one attribute at one node. A numeric attribute keeps a NumericClassStats per class. A categorical
+one keeps class counts per value: a run of merged entries sorted by (value, class), followed by the entries added
+since the last merge, so adding a row is O(1) and the run is only re-sorted when the node is evaluated or saved.
+*/
+class AttributeStats {
+public:
+    std::vector<ValueCount> entries;
+    size_t mergedCount = 0;
+    std::vector<NumericClassStats> numeric;     // by class ID.
+
+    void add(uint32_t value, uint32_t classId) {
+        entries.push_back({value, classId, 1});
+    }
+
+    void addNumber(double value, uint32_t classId) {
+        if (numeric.size() <= classId) {
+            numeric.resize(classId + 1);
+        }
+        numeric[classId].add(value);
+    }
+
+    void merge() {
+        if (mergedCount == entries.size()) {
+            return;
+        }
+        auto byValue = [](const ValueCount& a, const ValueCount& b) {
+            return a.value < b.value || (a.value == b.value && a.classId < b.classId);
+        };
+        std::sort(entries.begin() + mergedCount, entries.end(), byValue);
+        std::inplace_merge(entries.begin(), entries.begin() + mergedCount, entries.end(), byValue);
+        size_t kept = 0;
+        for (size_t i = 0; i < entries.size(); i++) {
+            ValueCount& last = entries[kept > 0 ? kept - 1 : 0];
+            if (kept > 0 && last.value == entries[i].value && last.classId == entries[i].classId) {
+                last.rows += entries[i].rows;
+            } else {
+                entries[kept++] = entries[i];
+            }
+        }
+        entries.resize(kept);
+        mergedCount = kept;
+    }
+};
+
+class HoeffdingNode {
+public:
+    static const uint32_t NO_VALUE = UINT32_MAX;
+
+    int attrIndex = -1;                 // attribute the node splits on; -1 for a leaf.
+    double threshold = 0.0;             // numeric split: children[0] takes values <= threshold, children[1] the rest.
+    uint32_t value = NO_VALUE;          // categorical parent: the value id that leads to this node.
+    std::vector<std::unique_ptr<HoeffdingNode>> children;
+    std::vector<uint64_t> classCount;   // rows per class the node predicts from: from its parent's split, plus seen.
+    std::vector<uint64_t> seenCount;    // rows per class seen since the node was created, which `stats` describe.
+    std::vector<AttributeStats> stats;  // per attribute (not the label).
+    uint64_t seen = 0;                  // total of seenCount.
+    uint64_t nextCheck = 0;             // `seen` at which the node is next evaluated.
+
+    bool isLeaf() const {
+        return attrIndex < 0;
+    }
+};
+
+// a scored split: attribute, information gain and, for a numeric attribute, the threshold.
+struct HoeffdingSplit {
+    int attrIndex = -1;
+    double gain = 0.0;
+    double threshold = 0.0;
+};
+
+class HoeffdingTree {
+public:
+    HoeffdingOptions options;
+    std::vector<std::string> attrName;                  // attributes in row order, the label (class) last.
+    std::vector<bool> isNumeric;
+    std::vector<std::vector<std::string>> valueName;    // categorical attributes: the text of each value id.
+    std::vector<std::string> className;                 // label of each class ID.
+    std::vector<std::pair<std::string, uint64_t>> inputs;   // input files and the bytes of each already learned.
+    std::unique_ptr<HoeffdingNode> root;
+    uint64_t rowCount = 0;                              // rows learned over every run.
+    uint64_t skippedCount = 0;                          // rows skipped by this run.
+    uint64_t splitCount = 0;                            // leaves split by this run.
+    uint64_t resplitCount = 0;                          // subtrees replaced by this run.
+
+    /*
+    learnFile(): learns the rows of a CSV file that were appended since it was last learned (all of them the first
+    time). The header row names the columns. The first file learned fixes the attributes (its columns, the label last)
+    and which of them are numeric (those whose every value in that file is a number); later files may order their
+    columns differently but must have all of them. Rows with a different number of fields than the header, or a
+    non-number for a numeric attribute, are skipped. Only whole lines count: a last line without its '\n' may still be
+    being appended, so it is left for the next run. A file that is now shorter than what was learned of it has been
+    rewritten, and is skipped with a warning. Returns false if the file cannot be read or lacks an attribute.
+    */
+    bool learnFile(const std::string& path) {
+        MappedFile file;
+        if (!file.open(path)) {
+            return false;
+        }
+        std::string_view data(file.data(), file.size());
+        data = data.substr(0, data.rfind('\n') + 1);      // npos + 1 == 0: no line is complete yet.
+        size_t headerEnd = std::min(data.find('\n'), data.size());
+        std::string_view headerLine = data.substr(0, headerEnd);
+        if (!headerLine.empty() && headerLine.back() == '\r') {
+            headerLine.remove_suffix(1);
+        }
+        if (headerLine.empty()) {
+            return true;
+        }
+        std::vector<std::string_view> names;
+        splitFields(headerLine, names);
+
+        uint64_t* learned = nullptr;
+        for (std::pair<std::string, uint64_t>& input : inputs) {
+            if (input.first == path) {
+                learned = &input.second;
+            }
+        }
+        if (learned == nullptr) {
+            inputs.push_back({path, 0});
+            learned = &inputs.back().second;
+        }
+        if (*learned > data.size()) {
+            std::cerr << path << " is shorter than when it was last learned; skipping it\n";
+            return true;
+        }
+        std::vector<std::string_view> lines;
+        splitLines(data, std::max<size_t>(*learned, headerEnd), lines);
+
+        if (attrName.empty()) {
+            if (names.size() < 2) {
+                return false;
+            }
+            start(names, lines);
+        }
+        std::vector<int> columnOf(attrName.size(), -1);
+        for (size_t j = 0; j < attrName.size(); j++) {
+            for (size_t column = 0; column < names.size(); column++) {
+                if (names[column] == attrName[j]) {
+                    columnOf[j] = (int)column;
+                }
+            }
+            if (columnOf[j] == -1) {
+                std::cerr << path << " has no " << attrName[j] << " column\n";
+                return false;
+            }
+        }
+
+        std::vector<std::string_view> fields;
+        std::vector<double> row(attrName.size() - 1);
+        for (std::string_view line : lines) {
+            splitFields(line, fields);
+            if (fields.size() != names.size() || !encodeRow(fields, columnOf, row)) {
+                skippedCount++;
+                continue;
+            }
+            learn(row, classId(fields[columnOf.back()]));
+            rowCount++;
+        }
+        *learned = data.size();
+        return true;
+    }
+
+    // learn(): adds one encoded row (attribute values in row order, without the label) of class `label`.
+    void learn(const std::vector<double>& row, uint32_t label) {
+        HoeffdingNode* node = root.get();
+        while (true) {
+            add(*node, row, label);
+            if (node->seen >= node->nextCheck) {
+                node->nextCheck = node->seen + std::max<uint64_t>(options.gracePeriod, node->seen / 8);
+                if (node->isLeaf() ? trySplit(*node) : tryResplit(*node)) {
+                    return;
+                }
+            }
+            if (node->isLeaf()) {
+                return;
+            }
+            node = route(*node, row);
+        }
+    }
+
+    /*
+    toNodes(): the tree as `Node`s in depth-first order, for serializeNodesToJson() / serializeNodesToBinary(). A leaf
+    predicts its majority class; a leaf no row has reached yet takes its parent's class counts.
+    */
+    std::vector<Node> toNodes() const {
+        std::vector<Node> tree;
+        if (root) {
+            flatten(*root, "", root->classCount, tree);
+        }
+        return tree;
+    }
+
+    size_t nodeCount() const {
+        return root ? countNodes(*root) : 0;
+    }
+
+    // load(): replaces the learner with the state saved at `path`; false if it is missing or invalid.
+    bool load(const std::string& path) {
+        MappedFile file;
+        if (!file.open(path) || file.size() < sizeof(HoeffdingStateHeader)) {
+            return false;
+        }
+        const HoeffdingStateHeader* header = reinterpret_cast<const HoeffdingStateHeader*>(file.data());
+        if (memcmp(header->magic, HOEFFDING_STATE_MAGIC, sizeof(header->magic)) != 0 ||
+            header->version != HOEFFDING_STATE_VERSION || header->headerSize != sizeof(HoeffdingStateHeader) ||
+            header->fileSize != file.size() || header->attrCount < 2) {
+            return false;
+        }
+        const char* body = file.data() + sizeof(HoeffdingStateHeader);
+        size_t bodySize = file.size() - sizeof(HoeffdingStateHeader);
+        if (modelChecksum(body, bodySize) != header->checksum) {
+            return false;
+        }
+
+        StateView view;
+        size_t offset = 0;
+        uint32_t attrs = header->attrCount;
+        uint64_t nodeClasses = (uint64_t)header->nodeCount * header->classCount;
+        uint64_t nodeAttrs = (uint64_t)header->nodeCount * (attrs - 1);
+        uint64_t sizes[] = {(uint64_t)header->stringCount + 1, header->stringBytes, attrs, attrs, header->inputCount,
+                            header->nodeCount, header->nodeCount, header->nodeCount, header->nodeCount,
+                            header->nodeCount, nodeClasses, nodeClasses, nodeAttrs, header->entryTotal,
+                            header->entryTotal, header->entryTotal, nodeAttrs, header->numericTotal,
+                            header->numericTotal};
+        size_t sizeOf[] = {4, 1, 1, 4, 8, 4, 8, 4, 4, 8, 8, 8, 4, 4, 4, 4, 4, 4, sizeof(NumericClassStats)};
+        const char* sections[19];
+        for (int i = 0; i < 19; i++) {
+            offset = modelAlign(offset);
+            sections[i] = body + offset;
+            if (sizes[i] > (bodySize - std::min(offset, bodySize)) / sizeOf[i]) {
+                return false;
+            }
+            offset += sizes[i] * sizeOf[i];
+        }
+        if (offset != bodySize) {
+            return false;
+        }
+        view.stringOffset = reinterpret_cast<const uint32_t*>(sections[0]);
+        view.stringData = sections[1];
+        view.numeric = reinterpret_cast<const uint8_t*>(sections[2]);
+        view.valueCount = reinterpret_cast<const uint32_t*>(sections[3]);
+        view.inputOffset = reinterpret_cast<const uint64_t*>(sections[4]);
+        view.nodeAttr = reinterpret_cast<const int32_t*>(sections[5]);
+        view.nodeThreshold = reinterpret_cast<const double*>(sections[6]);
+        view.nodeValue = reinterpret_cast<const uint32_t*>(sections[7]);
+        view.nodeChildCount = reinterpret_cast<const uint32_t*>(sections[8]);
+        view.nodeNextCheck = reinterpret_cast<const uint64_t*>(sections[9]);
+        view.classCount = reinterpret_cast<const uint64_t*>(sections[10]);
+        view.seenCount = reinterpret_cast<const uint64_t*>(sections[11]);
+        view.entryCount = reinterpret_cast<const uint32_t*>(sections[12]);
+        view.entryValue = reinterpret_cast<const uint32_t*>(sections[13]);
+        view.entryClass = reinterpret_cast<const uint32_t*>(sections[14]);
+        view.entryRows = reinterpret_cast<const uint32_t*>(sections[15]);
+        view.numericCount = reinterpret_cast<const uint32_t*>(sections[16]);
+        view.numericClass = reinterpret_cast<const uint32_t*>(sections[17]);
+        view.numericStats = reinterpret_cast<const NumericClassStats*>(sections[18]);
+        view.header = header;
+
+        // structural checks, so that rebuilding the learner never reads outside the file.
+        uint32_t strings = header->stringCount;
+        for (uint32_t i = 0; i < strings; i++) {
+            if (view.stringOffset[i] > view.stringOffset[i + 1]) {
+                return false;
+            }
+        }
+        uint64_t namedStrings = (uint64_t)attrs + header->classCount + header->inputCount;
+        for (uint32_t j = 0; j < attrs; j++) {
+            namedStrings += view.valueCount[j];
+        }
+        if (view.stringOffset[0] != 0 || view.stringOffset[strings] != header->stringBytes || namedStrings != strings ||
+            header->nodeCount == 0) {
+            return false;
+        }
+        uint64_t entries = 0;
+        uint64_t numericEntries = 0;
+        for (uint64_t i = 0; i < nodeAttrs; i++) {
+            entries += view.entryCount[i];
+            numericEntries += view.numericCount[i];
+        }
+        if (entries != header->entryTotal || numericEntries != header->numericTotal) {
+            return false;
+        }
+
+        HoeffdingTree loaded;
+        uint32_t next = 0;
+        for (uint32_t j = 0; j < attrs; j++) {
+            loaded.attrName.emplace_back(view.text(next++));
+            loaded.isNumeric.push_back(view.numeric[j] != 0);
+        }
+        for (uint32_t c = 0; c < header->classCount; c++) {
+            loaded.className.emplace_back(view.text(next++));
+        }
+        loaded.valueName.resize(attrs);
+        for (uint32_t j = 0; j < attrs; j++) {
+            for (uint32_t v = 0; v < view.valueCount[j]; v++) {
+                loaded.valueName[j].emplace_back(view.text(next++));
+            }
+        }
+        for (uint32_t i = 0; i < header->inputCount; i++) {
+            loaded.inputs.push_back({std::string(view.text(next++)), view.inputOffset[i]});
+        }
+        uint32_t node = 0;
+        uint64_t entry = 0;
+        uint64_t numericEntry = 0;
+        loaded.root = loaded.readNode(view, node, entry, numericEntry, -1);
+        if (!loaded.root || node != header->nodeCount) {
+            return false;
+        }
+        loaded.rowCount = header->rowCount;
+        loaded.options = options;
+        loaded.valueId.resize(attrs);
+        for (uint32_t j = 0; j < attrs; j++) {
+            for (uint32_t v = 0; v < loaded.valueName[j].size(); v++) {
+                loaded.valueId[j].emplace(loaded.valueName[j][v], v);
+            }
+        }
+        for (uint32_t c = 0; c < loaded.className.size(); c++) {
+            loaded.classIdOf.emplace(loaded.className[c], c);
+        }
+        *this = std::move(loaded);
+        return true;
+    }
+
+    // save(): writes the state to a temporary file and renames it over `path`, so a crash never leaves half a state.
+    bool save(const std::string& path) {
+        std::vector<HoeffdingNode*> order;
+        if (root) {
+            collect(*root, order);
+        }
+        std::vector<uint32_t> stringOffset = {0};
+        std::vector<char> stringData;
+        auto addString = [&stringOffset, &stringData](const std::string& text) {
+            stringData.insert(stringData.end(), text.begin(), text.end());
+            stringOffset.push_back((uint32_t)stringData.size());
+        };
+        std::vector<uint8_t> numeric;
+        std::vector<uint32_t> valueCount;
+        std::vector<uint64_t> inputOffset;
+        for (size_t j = 0; j < attrName.size(); j++) {
+            addString(attrName[j]);
+            numeric.push_back(isNumeric[j] ? 1 : 0);
+            valueCount.push_back((uint32_t)valueName[j].size());
+        }
+        for (const std::string& name : className) {
+            addString(name);
+        }
+        for (const std::vector<std::string>& values : valueName) {
+            for (const std::string& value : values) {
+                addString(value);
+            }
+        }
+        for (const std::pair<std::string, uint64_t>& input : inputs) {
+            addString(input.first);
+            inputOffset.push_back(input.second);
+        }
+
+        std::vector<int32_t> nodeAttr;
+        std::vector<double> nodeThreshold;
+        std::vector<uint32_t> nodeValue;
+        std::vector<uint32_t> nodeChildCount;
+        std::vector<uint64_t> nodeNextCheck;
+        std::vector<uint64_t> classCount;
+        std::vector<uint64_t> seenCount;
+        std::vector<uint32_t> entryCount;
+        std::vector<uint32_t> entryValue;
+        std::vector<uint32_t> entryClass;
+        std::vector<uint32_t> entryRows;
+        std::vector<uint32_t> numericCount;
+        std::vector<uint32_t> numericClass;
+        std::vector<NumericClassStats> numericStats;
+        for (HoeffdingNode* node : order) {
+            nodeAttr.push_back(node->attrIndex);
+            nodeThreshold.push_back(node->threshold);
+            nodeValue.push_back(node->value);
+            nodeChildCount.push_back((uint32_t)node->children.size());
+            nodeNextCheck.push_back(node->nextCheck);
+            for (size_t c = 0; c < className.size(); c++) {
+                classCount.push_back(c < node->classCount.size() ? node->classCount[c] : 0);
+                seenCount.push_back(c < node->seenCount.size() ? node->seenCount[c] : 0);
+            }
+            for (AttributeStats& stats : node->stats) {
+                stats.merge();
+                entryCount.push_back((uint32_t)stats.entries.size());
+                for (const ValueCount& entry : stats.entries) {
+                    entryValue.push_back(entry.value);
+                    entryClass.push_back(entry.classId);
+                    entryRows.push_back(entry.rows);
+                }
+                size_t classesSeen = numericClass.size();
+                for (uint32_t c = 0; c < stats.numeric.size(); c++) {
+                    if (stats.numeric[c].rows > 0) {
+                        numericClass.push_back(c);
+                        numericStats.push_back(stats.numeric[c]);
+                    }
+                }
+                numericCount.push_back((uint32_t)(numericClass.size() - classesSeen));
+            }
+        }
+
+        std::vector<char> body;
+        append(body, stringOffset);
+        append(body, stringData);
+        append(body, numeric);
+        append(body, valueCount);
+        append(body, inputOffset);
+        append(body, nodeAttr);
+        append(body, nodeThreshold);
+        append(body, nodeValue);
+        append(body, nodeChildCount);
+        append(body, nodeNextCheck);
+        append(body, classCount);
+        append(body, seenCount);
+        append(body, entryCount);
+        append(body, entryValue);
+        append(body, entryClass);
+        append(body, entryRows);
+        append(body, numericCount);
+        append(body, numericClass);
+        append(body, numericStats);
+
+        HoeffdingStateHeader header;
+        memcpy(header.magic, HOEFFDING_STATE_MAGIC, sizeof(header.magic));
+        header.version = HOEFFDING_STATE_VERSION;
+        header.headerSize = sizeof(HoeffdingStateHeader);
+        header.attrCount = (uint32_t)attrName.size();
+        header.classCount = (uint32_t)className.size();
+        header.inputCount = (uint32_t)inputs.size();
+        header.nodeCount = (uint32_t)order.size();
+        header.stringCount = (uint32_t)stringOffset.size() - 1;
+        header.stringBytes = stringData.size();
+        header.entryTotal = entryValue.size();
+        header.numericTotal = numericStats.size();
+        header.rowCount = rowCount;
+        header.checksum = modelChecksum(body.data(), body.size());
+        header.reserved = 0;
+        header.fileSize = sizeof(HoeffdingStateHeader) + body.size();
+
+        std::string temporaryPath = path + ".tmp";
+        std::ofstream fout(temporaryPath, std::ios::binary | std::ios::trunc);
+        fout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        fout.write(body.data(), body.size());
+        fout.close();
+        if (!fout) {
+            return false;
+        }
+#ifdef _WIN32
+        std::remove(path.c_str());      // Windows' rename() does not replace an existing file.
+#endif
+        return std::rename(temporaryPath.c_str(), path.c_str()) == 0;
+    }
+
+private:
+    std::vector<std::unordered_map<std::string, uint32_t>> valueId;     // inverse of valueName, rebuilt on load.
+    std::unordered_map<std::string, uint32_t> classIdOf;                // inverse of className, rebuilt on load.
+
+    // the saved state's sections, in place in the mapped file.
+    struct StateView {
+        const HoeffdingStateHeader* header;
+        const uint32_t* stringOffset;
+        const char* stringData;
+        const uint8_t* numeric;
+        const uint32_t* valueCount;
+        const uint64_t* inputOffset;
+        const int32_t* nodeAttr;
+        const double* nodeThreshold;
+        const uint32_t* nodeValue;
+        const uint32_t* nodeChildCount;
+        const uint64_t* nodeNextCheck;
+        const uint64_t* classCount;
+        const uint64_t* seenCount;
+        const uint32_t* entryCount;
+        const uint32_t* entryValue;
+        const uint32_t* entryClass;
+        const uint32_t* entryRows;
+        const uint32_t* numericCount;
+        const uint32_t* numericClass;
+        const NumericClassStats* numericStats;
+
+        std::string_view text(uint32_t id) const {
+            return std::string_view(stringData + stringOffset[id], stringOffset[id + 1] - stringOffset[id]);
+        }
+    };
+
+    // start(): fixes the attributes from the first file's header and rows, and creates the root.
+    void start(const std::vector<std::string_view>& names, const std::vector<std::string_view>& lines) {
+        attrName.assign(names.begin(), names.end());
+        isNumeric.assign(attrName.size(), true);
+        isNumeric.back() = false;
+        valueName.assign(attrName.size(), std::vector<std::string>());
+        valueId.assign(attrName.size(), std::unordered_map<std::string, uint32_t>());
+        std::vector<std::string_view> fields;
+        for (std::string_view line : lines) {
+            splitFields(line, fields);
+            if (fields.size() != attrName.size()) {
+                continue;
+            }
+            double number;
+            for (size_t j = 0; j + 1 < attrName.size(); j++) {
+                isNumeric[j] = isNumeric[j] && parseNumber(fields[j], number);
+            }
+        }
+        root = newNode();
+    }
+
+    std::unique_ptr<HoeffdingNode> newNode() const {
+        std::unique_ptr<HoeffdingNode> node(new HoeffdingNode());
+        node->stats.resize(attrName.size() - 1);
+        node->nextCheck = options.gracePeriod;
+        return node;
+    }
+
+    // encodeRow(): the attribute values of a row, numbers as themselves and categorical values as value ids.
+    bool encodeRow(const std::vector<std::string_view>& fields, const std::vector<int>& columnOf,
+                   std::vector<double>& row) {
+        for (size_t j = 0; j + 1 < attrName.size(); j++) {
+            std::string_view field = fields[columnOf[j]];
+            if (isNumeric[j]) {
+                if (!parseNumber(field, row[j])) {
+                    return false;
+                }
+                continue;
+            }
+            auto found = valueId[j].emplace(std::string(field), (uint32_t)valueName[j].size());
+            if (found.second) {
+                valueName[j].emplace_back(field);
+            }
+            row[j] = found.first->second;
+        }
+        return true;
+    }
+
+    uint32_t classId(std::string_view label) {
+        auto found = classIdOf.emplace(std::string(label), (uint32_t)className.size());
+        if (found.second) {
+            className.emplace_back(label);
+        }
+        return found.first->second;
+    }
+
+    void add(HoeffdingNode& node, const std::vector<double>& row, uint32_t label) {
+        if (node.classCount.size() <= label) {
+            node.classCount.resize(className.size(), 0);
+        }
+        if (node.seenCount.size() <= label) {
+            node.seenCount.resize(className.size(), 0);
+        }
+        node.classCount[label]++;
+        node.seenCount[label]++;
+        node.seen++;
+        for (size_t j = 0; j < node.stats.size(); j++) {
+            if (isNumeric[j]) {
+                node.stats[j].addNumber(row[j], label);
+            } else {
+                node.stats[j].add((uint32_t)row[j], label);
+            }
+        }
+    }
+
+    // route(): the child a row goes to; a categorical value the node has not split on yet gets a new leaf.
+    HoeffdingNode* route(HoeffdingNode& node, const std::vector<double>& row) {
+        double value = row[node.attrIndex];
+        if (isNumeric[node.attrIndex]) {
+            return node.children[value <= node.threshold ? 0 : 1].get();
+        }
+        for (std::unique_ptr<HoeffdingNode>& child : node.children) {
+            if (child->value == (uint32_t)value) {
+                return child.get();
+            }
+        }
+        node.children.push_back(newNode());
+        node.children.back()->value = (uint32_t)value;
+        return node.children.back().get();
+    }
+
+    /*
+    epsilon(): the Hoeffding bound on the gain difference after the rows `node` has seen. A split's gain is the mutual
+    information of class and child, so its range is log2 of the fewer of the classes present and the children of the
+    widest split: 1 bit when every attribute is numeric.
+    */
+    double epsilon(const HoeffdingNode& node) const {
+        size_t classes = 0;
+        for (uint64_t count : node.seenCount) {
+            classes += count > 0 ? 1 : 0;
+        }
+        size_t branches = 2;
+        for (size_t j = 0; j + 1 < attrName.size(); j++) {
+            branches = std::max(branches, isNumeric[j] ? (size_t)2 : valueName[j].size());
+        }
+        double range = std::log2((double)std::max<size_t>(std::min(classes, branches), 2));
+        return range * std::sqrt(std::log(1.0 / options.confidence) / (2.0 * node.seen));
+    }
+
+    // trySplit(): splits a leaf when the bound says its best split is the best one.
+    bool trySplit(HoeffdingNode& node) {
+        uint64_t majority = *std::max_element(node.seenCount.begin(), node.seenCount.end());
+        if (majority == node.seen || (double)majority / node.seen > options.purityCutoff) {
+            return false;
+        }
+        HoeffdingSplit best;
+        HoeffdingSplit runnerUp;
+        scoreSplits(node, best, runnerUp);
+        if (best.attrIndex < 0) {
+            return false;
+        }
+        double bound = epsilon(node);
+        if (best.gain - runnerUp.gain > bound || bound < options.tieThreshold) {
+            split(node, best);
+            splitCount++;
+            return true;
+        }
+        return false;
+    }
+
+    /*
+    tryResplit(): replaces an inner node's subtree when another attribute now beats its split with confidence, and by
+    more than the tie threshold, so nearly equal attributes do not keep replacing each other.
+    */
+    bool tryResplit(HoeffdingNode& node) {
+        HoeffdingSplit best;
+        HoeffdingSplit runnerUp;
+        scoreSplits(node, best, runnerUp);
+        if (best.attrIndex < 0 || best.attrIndex == node.attrIndex) {
+            return false;
+        }
+        double current = isNumeric[node.attrIndex] ? thresholdGain(node, node.attrIndex, node.threshold)
+                                                   : scoreAttribute(node, node.attrIndex).gain;
+        if (best.gain - current > std::max(epsilon(node), options.tieThreshold)) {
+            split(node, best);
+            resplitCount++;
+            return true;
+        }
+        return false;
+    }
+
+    // scoreSplits(): the best split and the best one on another attribute (gain 0 if there is none).
+    void scoreSplits(HoeffdingNode& node, HoeffdingSplit& best, HoeffdingSplit& runnerUp) {
+        for (int j = 0; j < (int)node.stats.size(); j++) {
+            node.stats[j].merge();
+            HoeffdingSplit candidate = scoreAttribute(node, j);
+            if (candidate.gain > best.gain) {
+                runnerUp = best;
+                best = candidate;
+            } else if (candidate.gain > runnerUp.gain) {
+                runnerUp = candidate;
+            }
+        }
+    }
+
+    static double xlog2x(double count) {
+        return count > 0 ? count * std::log2(count) : 0.0;
+    }
+
+    /*
+    scoreAttribute(): information gain of splitting the node's seen rows on attribute j: one child per value, or for
+    a numeric attribute the best of splitThresholds(). The entries of a categorical attribute must be merged.
+    */
+    HoeffdingSplit scoreAttribute(const HoeffdingNode& node, int j) const {
+        HoeffdingSplit candidate;
+        candidate.attrIndex = j;
+        if (isNumeric[j]) {
+            for (double threshold : splitThresholds(node.stats[j])) {
+                double gain = thresholdGain(node, j, threshold);
+                if (gain > candidate.gain) {
+                    candidate.gain = gain;
+                    candidate.threshold = threshold;
+                }
+            }
+            return candidate;
+        }
+
+        const std::vector<ValueCount>& entries = node.stats[j].entries;
+        double rows = (double)node.seen;
+        double sum = 0.0;
+        for (uint64_t count : node.seenCount) {
+            sum += xlog2x((double)count);
+        }
+        double info = 0.0;
+        for (size_t i = 0; i < entries.size();) {
+            double valueRows = 0.0;
+            double valueSum = 0.0;
+            size_t end = i;
+            for (; end < entries.size() && entries[end].value == entries[i].value; end++) {
+                valueRows += entries[end].rows;
+                valueSum += xlog2x(entries[end].rows);
+            }
+            info += (xlog2x(valueRows) - valueSum) / rows;
+            i = end;
+        }
+        candidate.gain = (xlog2x(rows) - sum) / rows - info;
+        return candidate;
+    }
+
+    /*
+    splitThresholds(): the thresholds scored for a numeric attribute, in increasing order: the largest value of every
+    class (which sends all of its rows left) and HOEFFDING_SPLIT_POINTS evenly spaced between the smallest and
+    largest value seen. The largest value overall would send every row left, so it is left out.
+    */
+    static std::vector<double> splitThresholds(const AttributeStats& stats) {
+        double minimum = INFINITY;
+        double maximum = -INFINITY;
+        std::vector<double> thresholds;
+        for (const NumericClassStats& byClass : stats.numeric) {
+            if (byClass.rows > 0) {
+                minimum = std::min(minimum, byClass.minimum);
+                maximum = std::max(maximum, byClass.maximum);
+                thresholds.push_back(byClass.maximum);
+            }
+        }
+        if (!(minimum < maximum)) {
+            return {};
+        }
+        for (uint32_t k = 1; k <= HOEFFDING_SPLIT_POINTS; k++) {
+            thresholds.push_back(minimum + (maximum - minimum) * k / (HOEFFDING_SPLIT_POINTS + 1));
+        }
+        std::sort(thresholds.begin(), thresholds.end());
+        thresholds.erase(std::unique(thresholds.begin(), thresholds.end()), thresholds.end());
+        thresholds.erase(std::lower_bound(thresholds.begin(), thresholds.end(), maximum), thresholds.end());
+        return thresholds;
+    }
+
+    /*
+    thresholdGain(): information gain of splitting the node's seen rows on numeric attribute j at `threshold`, with
+    the rows of each class on either side estimated by NumericClassStats::rowsAtMost().
+    */
+    double thresholdGain(const HoeffdingNode& node, int j, double threshold) const {
+        const std::vector<NumericClassStats>& numeric = node.stats[j].numeric;
+        double rows = (double)node.seen;
+        double leftRows = 0.0;
+        double sum = 0.0;
+        double leftSum = 0.0;
+        double rightSum = 0.0;
+        for (size_t c = 0; c < node.seenCount.size(); c++) {
+            double count = (double)node.seenCount[c];
+            double left = c < numeric.size() ? std::min(numeric[c].rowsAtMost(threshold), count) : 0.0;
+            leftRows += left;
+            sum += xlog2x(count);
+            leftSum += xlog2x(left);
+            rightSum += xlog2x(count - left);
+        }
+        double infoD = (xlog2x(rows) - sum) / rows;
+        return infoD - (xlog2x(leftRows) - leftSum + xlog2x(rows - leftRows) - rightSum) / rows;
+    }
+
+    /*
+    split(): makes `node` split on `candidate`, replacing any children it had. Each new child starts with the class
+    counts of the node's seen rows that the split sends to it (estimated, for a numeric attribute).
+    */
+    void split(HoeffdingNode& node, const HoeffdingSplit& candidate) {
+        int j = candidate.attrIndex;
+        node.attrIndex = j;
+        node.threshold = isNumeric[j] ? candidate.threshold : 0.0;
+        node.children.clear();
+        if (isNumeric[j]) {
+            node.children.push_back(newNode());
+            node.children.push_back(newNode());
+            const std::vector<NumericClassStats>& numeric = node.stats[j].numeric;
+            for (std::unique_ptr<HoeffdingNode>& child : node.children) {
+                child->classCount.assign(className.size(), 0);
+            }
+            for (size_t c = 0; c < numeric.size(); c++) {
+                uint64_t left = (uint64_t)std::llround(numeric[c].rowsAtMost(node.threshold));
+                node.children[0]->classCount[c] = left;
+                node.children[1]->classCount[c] = numeric[c].rows - left;
+            }
+            return;
+        }
+        for (const ValueCount& entry : node.stats[j].entries) {
+            if (node.children.empty() || node.children.back()->value != entry.value) {
+                node.children.push_back(newNode());
+                node.children.back()->value = entry.value;
+            }
+            HoeffdingNode* child = node.children.back().get();
+            if (child->classCount.size() <= entry.classId) {
+                child->classCount.resize(className.size(), 0);
+            }
+            child->classCount[entry.classId] += entry.rows;
+        }
+    }
+
+    void flatten(const HoeffdingNode& node, const std::string& attrValue, const std::vector<uint64_t>& parentCount,
+                 std::vector<Node>& tree) const {
+        int index = (int)tree.size();
+        tree.push_back(Node());
+        tree[index].treeIndex = index;
+        tree[index].attrValue = attrValue;
+        const std::vector<uint64_t>& counts =
+            std::any_of(node.classCount.begin(), node.classCount.end(), [](uint64_t c) { return c > 0; })
+                ? node.classCount : parentCount;
+        if (node.isLeaf()) {
+            tree[index].isLeaf = true;
+            size_t majority = 0;
+            for (size_t c = 0; c < counts.size(); c++) {
+                if (counts[c] > counts[majority]) {
+                    majority = c;
+                }
+                if (counts[c] > 0) {
+                    tree[index].classCounts.push_back({(int)c, (int)counts[c]});
+                }
+            }
+            tree[index].label = counts.empty() ? "" : className[majority];
+            return;
+        }
+        int j = node.attrIndex;
+        tree[index].criteriaAttrIndex = j;
+        tree[index].isContinuous = isNumeric[j];
+        tree[index].threshold = node.threshold;
+        for (size_t i = 0; i < node.children.size(); i++) {
+            std::string childValue;
+            if (isNumeric[j]) {
+                childValue = (i == 0 ? "<= " : "> ") + DecisionTree::formatThreshold(node.threshold);
+            } else {
+                childValue = valueName[j][node.children[i]->value];
+            }
+            int childIndex = (int)tree.size();
+            tree[index].children.push_back(childIndex);
+            flatten(*node.children[i], childValue, counts, tree);
+        }
+    }
+
+    static size_t countNodes(const HoeffdingNode& node) {
+        size_t count = 1;
+        for (const std::unique_ptr<HoeffdingNode>& child : node.children) {
+            count += countNodes(*child);
+        }
+        return count;
+    }
+
+    static void collect(HoeffdingNode& node, std::vector<HoeffdingNode*>& order) {
+        order.push_back(&node);
+        for (std::unique_ptr<HoeffdingNode>& child : node.children) {
+            collect(*child, order);
+        }
+    }
+
+    // readNode(): rebuilds node `next` of a saved state and its subtree; nullptr if the state is inconsistent.
+    std::unique_ptr<HoeffdingNode> readNode(const StateView& view, uint32_t& next, uint64_t& entry,
+                                            uint64_t& numericEntry, int parentAttr) {
+        const HoeffdingStateHeader* header = view.header;
+        if (next >= header->nodeCount) {
+            return nullptr;
+        }
+        uint32_t i = next++;
+        uint32_t attrs = header->attrCount;
+        int j = view.nodeAttr[i];
+        bool valid = j >= -1 && j < (int)attrs - 1 &&
+                     (j < 0 ? view.nodeChildCount[i] == 0 : view.nodeChildCount[i] > 0) &&
+                     (j < 0 || !isNumeric[j] || view.nodeChildCount[i] == 2) &&
+                     (parentAttr >= 0 && !isNumeric[parentAttr] ? view.nodeValue[i] < view.valueCount[parentAttr]
+                                                                : view.nodeValue[i] == HoeffdingNode::NO_VALUE);
+        if (!valid) {
+            return nullptr;
+        }
+        std::unique_ptr<HoeffdingNode> node = newNode();
+        node->attrIndex = j;
+        node->threshold = view.nodeThreshold[i];
+        node->value = view.nodeValue[i];
+        node->nextCheck = view.nodeNextCheck[i];
+        node->classCount.assign(view.classCount + (uint64_t)i * header->classCount,
+                                view.classCount + (uint64_t)(i + 1) * header->classCount);
+        node->seenCount.assign(view.seenCount + (uint64_t)i * header->classCount,
+                               view.seenCount + (uint64_t)(i + 1) * header->classCount);
+        for (uint64_t count : node->seenCount) {
+            node->seen += count;
+        }
+        for (uint32_t a = 0; a + 1 < attrs; a++) {
+            AttributeStats& stats = node->stats[a];
+            uint64_t slot = (uint64_t)i * (attrs - 1) + a;
+            uint32_t count = view.entryCount[slot];
+            if (isNumeric[a] ? count > 0 : view.numericCount[slot] > 0) {
+                return nullptr;
+            }
+            for (uint32_t e = 0; e < count; e++, entry++) {
+                if (view.entryClass[entry] >= header->classCount || view.entryValue[entry] >= view.valueCount[a]) {
+                    return nullptr;
+                }
+                stats.entries.push_back({view.entryValue[entry], view.entryClass[entry], view.entryRows[entry]});
+            }
+            stats.mergedCount = stats.entries.size();
+            uint64_t rows = 0;
+            for (uint32_t e = 0; e < view.numericCount[slot]; e++, numericEntry++) {
+                uint32_t c = view.numericClass[numericEntry];
+                if (c >= header->classCount || c < stats.numeric.size()) {
+                    return nullptr;     // classes are stored in increasing order, each once.
+                }
+                stats.numeric.resize(c + 1);
+                stats.numeric[c] = view.numericStats[numericEntry];
+                rows += stats.numeric[c].rows;
+            }
+            if (isNumeric[a] && rows != node->seen) {
+                return nullptr;
+            }
+        }
+        for (uint32_t c = 0; c < view.nodeChildCount[i]; c++) {
+            std::unique_ptr<HoeffdingNode> child = readNode(view, next, entry, numericEntry, j);
+            if (!child) {
+                return nullptr;
+            }
+            node->children.push_back(std::move(child));
+        }
+        return node;
+    }
+
+    template <typename T>
+    static void append(std::vector<char>& body, const std::vector<T>& section) {
+        body.resize(modelAlign(body.size()));
+        const char* bytes = reinterpret_cast<const char*>(section.data());
+        body.insert(body.end(), bytes, bytes + section.size() * sizeof(T));
+    }
+
+    // splitLines(): the non-blank lines of data[start, end), without their line ends.
+    static void splitLines(std::string_view data, size_t start, std::vector<std::string_view>& lines) {
+        lines.clear();
+        while (start < data.size()) {
+            size_t end = data.find('\n', start);
+            if (end == std::string_view::npos) {
+                end = data.size();
+            }
+            std::string_view line = data.substr(start, end - start);
+            if (!line.empty() && line.back() == '\r') {
+                line.remove_suffix(1);
+            }
+            if (line.find_first_not_of(" \t") != std::string_view::npos) {
+                lines.push_back(line);
+            }
+            start = end + 1;
+        }
+    }
+
+    static void splitFields(std::string_view line, std::vector<std::string_view>& fields) {
+        fields.clear();
+        size_t start = 0;
+        while (true) {
+            size_t comma = line.find(',', start);
+            size_t length = comma == std::string_view::npos ? std::string_view::npos : comma - start;
+            fields.push_back(line.substr(start, length));
+            if (comma == std::string_view::npos) {
+                return;
+            }
+            start = comma + 1;
+        }
+    }
+
+    // parseNumber(): a whole field as a finite double, as Table::parseNumbers() accepts it.
+    static bool parseNumber(std::string_view text, double& number) {
+        if (!text.empty() && text.front() == '+') {
+            text.remove_prefix(1);
+        }
+        std::from_chars_result result = std::from_chars(text.data(), text.data() + text.size(), number);
+        return !text.empty() && result.ec == std::errc() && result.ptr == text.data() + text.size() &&
+               std::isfinite(number);
+    }
+};
+
+#endif
@@ -0,0 +1,404 @@
+#ifndef INGEST_H
+#define INGEST_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "tsdb.h"
+
+// one reading of one field, as it travels through the ingest pipeline.
+struct FieldReading {
+    uint32_t field;
+    SensorSample sample;
+};
+
+/*
+`Doorbell` lets a consumer thread sleep while its queue is empty. Producers ring it after pushing, which only costs a
+fence unless the consumer is actually asleep. The fences on both sides make sure that either the producer sees the
+consumer's `sleeping` flag or the consumer sees the pushed value, so no ring is lost.
+*/
+class Doorbell {
+public:
+    void ring() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeping.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(mutex);
+            wake.notify_one();
+        }
+    }
+
+    // sleep(): waits up to `maxSleep` unless `hasWork()`.
+    template <typename HasWork>
+    void sleep(std::chrono::steady_clock::duration maxSleep, HasWork hasWork) {
+        std::unique_lock<std::mutex> lock(mutex);
+        sleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!hasWork()) {
+            wake.wait_for(lock, maxSleep);
+        }
+        sleeping.store(false, std::memory_order_relaxed);
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::atomic<bool> sleeping{false};
+};
+
+/*
+`MpscQueue` is a bounded lock-free queue for many producer threads and one consumer (the bounded queue of D. Vyukov:
+every slot carries a sequence number that says whether it is free for the producer that claimed its position or
+holds a value for the consumer). A producer claims a position with one compare-and-swap and never waits for another
+producer; `tryPush()` fails instead of blocking when the queue is full, so the caller decides between waiting
+(backpressure) and dropping.
+*/
+template <typename T>
+class MpscQueue {
+public:
+    explicit MpscQueue(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        slots.reset(new Slot[size]);
+        for (size_t i = 0; i < size; i++) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        mask = size - 1;
+    }
+
+    bool tryPush(const T& value) {
+        size_t position = tail.load(std::memory_order_relaxed);
+        while (true) {
+            Slot& slot = slots[position & mask];
+            size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+            if (difference == 0) {
+                if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    slot.value = value;
+                    slot.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (difference < 0) {
+                return false;
+            } else {
+                position = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // popBatch(): moves up to `max` values to `out`; consumer thread only.
+    size_t popBatch(T* out, size_t max) {
+        size_t count = 0;
+        while (count < max) {
+            Slot& slot = slots[head & mask];
+            if (slot.sequence.load(std::memory_order_acquire) != head + 1) {
+                break;
+            }
+            out[count++] = slot.value;
+            slot.sequence.store(head + mask + 1, std::memory_order_release);
+            head++;
+        }
+        publishedHead.store(head, std::memory_order_relaxed);
+        return count;
+    }
+
+    bool empty() const {
+        return slots[head & mask].sequence.load(std::memory_order_acquire) != head + 1;
+    }
+
+    // depth(): values waiting, as of the consumer's last pop (approximate while producers push).
+    size_t depth() const {
+        size_t claimed = tail.load(std::memory_order_relaxed);
+        size_t consumed = publishedHead.load(std::memory_order_relaxed);
+        return claimed > consumed ? claimed - consumed : 0;
+    }
+
+    size_t capacity() const {
+        return mask + 1;
+    }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    size_t mask;
+    alignas(64) std::atomic<size_t> tail{0};            // next position for a producer to claim.
+    alignas(64) size_t head = 0;                        // next position for the consumer.
+    std::atomic<size_t> publishedHead{0};
+};
+
+// `SpscQueue` is the single-producer / single-consumer ring of SensorLogWriter, for values of any type.
+template <typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        ring.resize(size);
+        mask = size - 1;
+    }
+
+    bool tryPush(const T& value) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) > mask) {
+            return false;
+        }
+        ring[t & mask] = value;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t popBatch(T* out, size_t max) {
+        size_t h = head.load(std::memory_order_relaxed);
+        size_t count = std::min(max, tail.load(std::memory_order_acquire) - h);
+        for (size_t i = 0; i < count; i++) {
+            out[i] = ring[(h + i) & mask];
+        }
+        head.store(h + count, std::memory_order_release);
+        return count;
+    }
+
+    size_t depth() const {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+
+private:
+    std::vector<T> ring;
+    size_t mask;
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+};
+
+// what a stage does when its inbox is full.
+enum class StageOverflow {
+    Block,          // the dispatcher waits: nothing is lost, but a slow stage holds up the others.
+    Drop,           // the reading is dropped for this stage only and counted.
+};
+
+struct IngestStageStats {
+    std::string name;
+    uint64_t consumed;
+    uint64_t dropped;
+    size_t depth;
+};
+
+struct IngestStats {
+    uint64_t pushed;                // readings accepted from producers.
+    uint64_t producerWaits;         // pushes that found the queue full and had to wait.
+    uint64_t dropped;               // readings dropped by producers that do not wait.
+    size_t depth;                   // readings in the ingest queue.
+    size_t maxDepth;
+    size_t capacity;
+    std::vector<IngestStageStats> stages;
+};
+
+/*
+`IngestPipeline` moves readings from any number of producer threads to consumer stages. Producers push into one
+MpscQueue; a dispatcher thread drains it in batches and copies every reading into the SpscQueue inbox of each stage;
+every stage has its own thread, which hands batches of readings to its `consume` function and calls its `periodic`
+function every `period`. A slow stage therefore only delays the others if its overflow policy is Block.
+
+Producers call `push()`, which waits while the queue is full (so bursts are absorbed up to the queue capacity and
+then slow the producers down instead of losing readings), or `tryPush()`, which drops and counts instead.
+*/
+class IngestPipeline {
+public:
+    using Consume = std::function<void(const FieldReading*, size_t)>;
+    using Periodic = std::function<void()>;
+
+    explicit IngestPipeline(size_t capacity = 1 << 16) : queue(capacity) {
+    }
+
+    ~IngestPipeline() {
+        stop();
+    }
+
+    // addStage(): before start(). `periodic`, if given, runs on the stage's thread every `period` (which must be > 0).
+    void addStage(std::string name, size_t capacity, StageOverflow overflow, Consume consume,
+                  std::chrono::milliseconds period = std::chrono::milliseconds(0), Periodic periodic = Periodic()) {
+        std::unique_ptr<Stage> stage(new Stage(capacity));
+        stage->name = std::move(name);
+        stage->overflow = overflow;
+        stage->consume = std::move(consume);
+        stage->period = period;
+        stage->periodic = std::move(periodic);
+        stages.push_back(std::move(stage));
+    }
+
+    void start() {
+        running.store(true);
+        for (auto& stage : stages) {
+            Stage* s = stage.get();
+            s->thread = std::thread([this, s] { stageLoop(*s); });
+        }
+        dispatcher = std::thread(&IngestPipeline::dispatchLoop, this);
+    }
+
+    // push(): queues a reading, waiting while the queue is full.
+    void push(const FieldReading& reading) {
+        if (!queue.tryPush(reading)) {
+            producerWaits.fetch_add(1, std::memory_order_relaxed);
+            do {
+                dispatcherBell.ring();
+                std::this_thread::yield();
+            } while (!queue.tryPush(reading));
+        }
+        pushed.fetch_add(1, std::memory_order_relaxed);
+        dispatcherBell.ring();
+    }
+
+    // tryPush(): queues a reading unless the queue is full; a rejected reading is counted as dropped.
+    bool tryPush(const FieldReading& reading) {
+        if (!queue.tryPush(reading)) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        pushed.fetch_add(1, std::memory_order_relaxed);
+        dispatcherBell.ring();
+        return true;
+    }
+
+    // stop(): call once the producers are done; delivers everything queued, then stops the dispatcher and stages.
+    void stop() {
+        if (!dispatcher.joinable()) {
+            return;
+        }
+        running.store(false);
+        dispatcherBell.ring();
+        dispatcher.join();
+        for (auto& stage : stages) {
+            stage->bell.ring();
+            stage->thread.join();
+        }
+    }
+
+    IngestStats stats() const {
+        IngestStats result;
+        result.pushed = pushed.load(std::memory_order_relaxed);
+        result.producerWaits = producerWaits.load(std::memory_order_relaxed);
+        result.dropped = dropped.load(std::memory_order_relaxed);
+        result.depth = queue.depth();
+        result.maxDepth = maxDepth.load(std::memory_order_relaxed);
+        result.capacity = queue.capacity();
+        for (const auto& stage : stages) {
+            result.stages.push_back(IngestStageStats{stage->name, stage->consumed.load(std::memory_order_relaxed),
+                                                     stage->dropped.load(std::memory_order_relaxed),
+                                                     stage->inbox.depth()});
+        }
+        return result;
+    }
+
+private:
+    struct Stage {
+        explicit Stage(size_t capacity) : inbox(capacity) {
+        }
+
+        std::string name;
+        StageOverflow overflow = StageOverflow::Block;
+        Consume consume;
+        std::chrono::milliseconds period{0};
+        Periodic periodic;
+        SpscQueue<FieldReading> inbox;
+        Doorbell bell;
+        std::thread thread;
+        std::atomic<uint64_t> consumed{0};
+        std::atomic<uint64_t> dropped{0};
+        std::atomic<bool> done{false};      // the dispatcher has delivered its last reading.
+    };
+
+    static const size_t BATCH = 256;
+    static constexpr std::chrono::milliseconds MAX_SLEEP{100};
+
+    MpscQueue<FieldReading> queue;
+    std::vector<std::unique_ptr<Stage>> stages;
+    Doorbell dispatcherBell;
+    std::thread dispatcher;
+    std::atomic<bool> running{false};
+    std::atomic<uint64_t> pushed{0};
+    std::atomic<uint64_t> producerWaits{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<size_t> maxDepth{0};
+
+    void dispatchLoop() {
+        FieldReading batch[BATCH];
+        while (true) {
+            size_t depth = queue.depth();
+            if (depth > maxDepth.load(std::memory_order_relaxed)) {
+                maxDepth.store(depth, std::memory_order_relaxed);
+            }
+            size_t count = queue.popBatch(batch, BATCH);
+            if (count == 0) {
+                if (!running.load() && queue.empty()) {
+                    break;
+                }
+                dispatcherBell.sleep(MAX_SLEEP, [this] { return !queue.empty() || !running.load(); });
+                continue;
+            }
+            for (auto& stage : stages) {
+                for (size_t i = 0; i < count; i++) {
+                    if (stage->inbox.tryPush(batch[i])) {
+                        continue;
+                    }
+                    if (stage->overflow == StageOverflow::Drop) {
+                        stage->dropped.fetch_add(1, std::memory_order_relaxed);
+                        continue;
+                    }
+                    do {
+                        stage->bell.ring();
+                        std::this_thread::yield();
+                    } while (!stage->inbox.tryPush(batch[i]));
+                }
+                stage->bell.ring();
+            }
+        }
+        for (auto& stage : stages) {
+            stage->done.store(true);
+            stage->bell.ring();
+        }
+    }
+
+    void stageLoop(Stage& stage) {
+        FieldReading batch[BATCH];
+        auto nextPeriodic = std::chrono::steady_clock::now() + stage.period;
+        while (true) {
+            size_t count = stage.inbox.popBatch(batch, BATCH);
+            if (count > 0) {
+                stage.consume(batch, count);
+                stage.consumed.fetch_add(count, std::memory_order_relaxed);
+            }
+            if (stage.periodic && std::chrono::steady_clock::now() >= nextPeriodic) {
+                stage.periodic();
+                nextPeriodic += stage.period;
+            }
+            if (count == 0) {
+                if (stage.done.load() && stage.inbox.depth() == 0) {
+                    break;
+                }
+                auto sleep = std::chrono::steady_clock::duration(MAX_SLEEP);
+                if (stage.periodic) {
+                    sleep = std::min(sleep, nextPeriodic - std::chrono::steady_clock::now());
+                }
+                stage.bell.sleep(sleep, [&stage] { return stage.inbox.depth() > 0 || stage.done.load(); });
+            }
+        }
+        if (stage.periodic) {
+            stage.periodic();
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,263 @@
+#ifndef LOG_WRITER_H
+#define LOG_WRITER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "rollup.h"
+#include "tsdb.h"
+
+// when the log is forced to stable storage.
+enum class FsyncPolicy {
+    Never,          // leave it to the operating system.
+    EveryFlush,     // after every batch written.
+    OnClose,        // once, when the writer is closed.
+};
+
+struct LogWriterOptions {
+    std::string tsdbPath = "sensor_tsdb";           // time-series store directory (see tsdb.h).
+    std::string csvPath;                            // optional plain CSV log, without timestamps; empty for none.
+    std::string jsonPath;                           // optional JSON status file; empty for none.
+    size_t capacity = 1 << 16;                      // samples the ring buffer holds (rounded up to a power of two).
+    size_t batchSize = 4096;                        // buffered samples that trigger a flush.
+    std::chrono::milliseconds flushInterval{1000};  // longest time a sample waits in the buffer.
+    FsyncPolicy fsync = FsyncPolicy::Never;
+};
+
+/*
+`SensorLogWriter` takes file I/O off the monitoring loop. `append()` copies a sample into a bounded single-producer /
+single-consumer ring buffer and returns at once; a background thread drains the buffer in batches, when `batchSize`
+samples are waiting or `flushInterval` has passed, appends each batch to the time-series store and its rollups (and
+to the CSV log with one write call, if there is one) and flushes the store's head block and open rollup buckets.
+`publishStatus()` only records the latest levels; if there is a JSON status file, the writer rewrites it at most
+once per flush, to a temporary file that is renamed over the old one, so readers never see it half-written. (Live
+readers use the shared-memory status in status_shm.h instead.)
+
+If the buffer is full the sample is dropped and counted rather than making the caller wait (`appendWaiting()` waits
+instead). `close()` (also run by the destructor) writes everything still buffered, fsyncs according to the policy and
+stops the thread.
+*/
+class SensorLogWriter {
+public:
+    explicit SensorLogWriter(const LogWriterOptions& options = LogWriterOptions())
+        : options(options), store(options.tsdbPath, storeOptions(options)),
+          rollups(options.tsdbPath, options.fsync == FsyncPolicy::EveryFlush) {
+        size_t capacity = 1;
+        while (capacity < options.capacity) {
+            capacity <<= 1;
+        }
+        ring.resize(capacity);
+        mask = capacity - 1;
+    }
+
+    ~SensorLogWriter() {
+        close();
+    }
+
+    // open(): opens the store, and the CSV log for appending (writing `header` first if the file is new); starts the writer.
+    bool open(const std::string& header) {
+        if (!store.open() || !rollups.openForWriting()) {
+            return false;
+        }
+        if (!options.csvPath.empty()) {
+            csv = std::fopen(options.csvPath.c_str(), "ab");
+            if (csv == nullptr) {
+                return false;
+            }
+            std::fseek(csv, 0, SEEK_END);
+            if (std::ftell(csv) == 0 && !header.empty()) {
+                std::fwrite(header.data(), 1, header.size(), csv);
+            }
+        }
+        stopping = false;
+        writer = std::thread(&SensorLogWriter::writerLoop, this);
+        return true;
+    }
+
+    // append(): queues a sample without blocking; false if the buffer was full and the sample was dropped.
+    bool append(const SensorSample& sample) {
+        if (!tryAppend(sample)) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    // appendWaiting(): queues a sample, waiting for the writer to make room if the buffer is full; for callers that
+    // must not lose samples and can afford to wait, such as simulations.
+    void appendWaiting(const SensorSample& sample) {
+        while (!tryAppend(sample)) {
+            wake.notify_one();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    // publishStatus(): the levels the JSON status file should show from the next flush on.
+    void publishStatus(double soilMoistureLevel, double phLevel) {
+        std::lock_guard<std::mutex> lock(statusMutex);
+        status = {0, soilMoistureLevel, phLevel};
+        statusChanged = true;
+    }
+
+    void close() {
+        if (!writer.joinable()) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        writer.join();
+        store.close(options.fsync != FsyncPolicy::Never);
+        rollups.close();
+        if (csv != nullptr) {
+            if (options.fsync != FsyncPolicy::Never) {
+                tsdbSync(csv);
+            }
+            std::fclose(csv);
+            csv = nullptr;
+        }
+    }
+
+    uint64_t writtenCount() const {
+        return written.load(std::memory_order_relaxed);
+    }
+
+    uint64_t droppedCount() const {
+        return dropped.load(std::memory_order_relaxed);
+    }
+
+private:
+    LogWriterOptions options;
+    TimeSeriesStore store;
+    SensorRollups rollups;                          // 1 s / 1 min / 1 h summaries, next to the store.
+    std::vector<SensorSample> ring;
+    size_t mask = 0;
+    alignas(64) std::atomic<size_t> ringHead{0};    // next sample to write; advanced by the writer thread.
+    alignas(64) std::atomic<size_t> ringTail{0};    // next free slot; advanced by append().
+    std::atomic<uint64_t> written{0};
+    std::atomic<uint64_t> dropped{0};
+
+    std::mutex statusMutex;
+    SensorSample status{0, 0.0, 0.0};
+    bool statusChanged = false;
+
+    std::FILE* csv = nullptr;
+    std::thread writer;
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    bool stopping = false;
+
+    bool tryAppend(const SensorSample& sample) {
+        size_t tail = ringTail.load(std::memory_order_relaxed);
+        size_t head = ringHead.load(std::memory_order_acquire);
+        if (tail - head > mask) {
+            return false;
+        }
+        ring[tail & mask] = sample;
+        ringTail.store(tail + 1, std::memory_order_release);
+        if (tail + 1 - head == options.batchSize) {
+            wake.notify_one();
+        }
+        return true;
+    }
+
+    void writerLoop() {
+        std::string batch;
+        while (true) {
+            bool finalFlush;
+            {
+                std::unique_lock<std::mutex> lock(wakeMutex);
+                wake.wait_for(lock, options.flushInterval, [this] {
+                    return stopping || ringTail.load(std::memory_order_acquire) -
+                                       ringHead.load(std::memory_order_relaxed) >= options.batchSize;
+                });
+                finalFlush = stopping;
+            }
+            flush(batch);
+            if (finalFlush) {
+                return;
+            }
+        }
+    }
+
+    // flush(): writes every buffered sample to the store and the CSV log and, if it changed, the JSON status file.
+    void flush(std::string& batch) {
+        size_t head = ringHead.load(std::memory_order_relaxed);
+        size_t tail = ringTail.load(std::memory_order_acquire);
+        batch.clear();
+        char line[64];
+        for (size_t i = head; i < tail; i++) {
+            const SensorSample& sample = ring[i & mask];
+            if (store.append(sample)) {
+                rollups.add(sample);
+            }
+            if (csv != nullptr) {
+                // floats, as the original ofstream log printed them.
+                int length = std::snprintf(line, sizeof(line), "%g,%g\n", (double)(float)sample.soilMoistureLevel,
+                                           (double)(float)sample.phLevel);
+                batch.append(line, length);
+            }
+        }
+        ringHead.store(tail, std::memory_order_release);
+        if (tail != head) {
+            store.flush();
+            rollups.flush();
+            if (!batch.empty()) {
+                std::fwrite(batch.data(), 1, batch.size(), csv);
+                std::fflush(csv);
+                if (options.fsync == FsyncPolicy::EveryFlush) {
+                    tsdbSync(csv);
+                }
+            }
+            written.fetch_add(tail - head, std::memory_order_relaxed);
+        }
+        writeStatus();
+    }
+
+    void writeStatus() {
+        if (options.jsonPath.empty()) {
+            return;
+        }
+        SensorSample current;
+        {
+            std::lock_guard<std::mutex> lock(statusMutex);
+            if (!statusChanged) {
+                return;
+            }
+            current = status;
+            statusChanged = false;
+        }
+        std::string temporaryPath = options.jsonPath + ".tmp";
+        std::FILE* json = std::fopen(temporaryPath.c_str(), "wb");
+        if (json == nullptr) {
+            return;
+        }
+        std::fprintf(json, "{\n  \"soil_moisture_level\": %g,\n  \"ph_level\": %g\n}\n", current.soilMoistureLevel,
+                     current.phLevel);
+        if (options.fsync == FsyncPolicy::EveryFlush) {
+            std::fflush(json);
+            tsdbSync(json);
+        }
+        std::fclose(json);
+#ifdef _WIN32
+        std::remove(options.jsonPath.c_str());  // rename only replaces the old status atomically on POSIX.
+#endif
+        std::rename(temporaryPath.c_str(), options.jsonPath.c_str());
+    }
+
+    static TsdbOptions storeOptions(const LogWriterOptions& options) {
+        TsdbOptions storeOptions;
+        storeOptions.syncWrites = options.fsync == FsyncPolicy::EveryFlush;
+        return storeOptions;
+    }
+};
+
+#endif
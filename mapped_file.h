@@ -0,0 +1,106 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*
+`MappedFile` maps a whole file read-only. On platforms without mmap the file is read into memory once instead, so
+callers see the same contiguous bytes either way. The bytes stay valid until `close()` or destruction.
+*/
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        close();
+    }
+
+    bool open(const std::string& path) {
+        close();
+#ifndef _WIN32
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0) {
+            ::close(fd);
+            return false;
+        }
+        mappedSize = (size_t)info.st_size;
+        if (mappedSize == 0) {
+            ::close(fd);
+            opened = true;
+            return true;
+        }
+        void* address = mmap(nullptr, mappedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (address == MAP_FAILED) {
+            mappedSize = 0;
+            return false;
+        }
+        mapped = address;
+        opened = true;
+        return true;
+#else
+        std::ifstream fin(path, std::ios::binary);
+        if (!fin) {
+            return false;
+        }
+        buffer.assign(std::istreambuf_iterator<char>(fin), std::istreambuf_iterator<char>());
+        mappedSize = buffer.size();
+        opened = true;
+        return true;
+#endif
+    }
+
+    void close() {
+#ifndef _WIN32
+        if (mapped != nullptr) {
+            munmap(mapped, mappedSize);
+        }
+#endif
+        mapped = nullptr;
+        mappedSize = 0;
+        buffer.clear();
+        opened = false;
+    }
+
+    bool isOpen() const {
+        return opened;
+    }
+
+    const char* data() const {
+        return mapped != nullptr ? static_cast<const char*>(mapped) : buffer.data();
+    }
+
+    size_t size() const {
+        return mappedSize;
+    }
+
+    std::string_view view() const {
+        return std::string_view(data(), mappedSize);
+    }
+
+private:
+    void* mapped = nullptr;
+    size_t mappedSize = 0;
+    std::vector<char> buffer;
+    bool opened = false;
+};
+
+#endif
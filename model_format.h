@@ -0,0 +1,391 @@
+#ifndef MODEL_FORMAT_H
+#define MODEL_FORMAT_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "mapped_file.h"
+
+/*
+Binary decision tree model shared by decision.cpp (writer) and predict.cpp / recommend.cpp (readers).
+
+The file is a fixed header followed by flat little-endian arrays, each starting on an 8-byte boundary, so a reader
+can map the file and use the arrays in place without parsing anything (predictor.h walks them directly):
+
+    double   threshold[nodeCount]           split threshold of continuous nodes
+    int32_t  criteriaAttrIndex[nodeCount]   attribute a node splits on (-1 for most leaves)
+    uint32_t attrValue[nodeCount]           string id of the value that leads to a node
+    uint32_t label[nodeCount]               string id of a leaf's label
+    uint32_t firstChild[nodeCount]          position of a node's first entry in `children`
+    uint32_t childCount[nodeCount]          number of children of a node
+    uint8_t  flags[nodeCount]               MODEL_NODE_LEAF | MODEL_NODE_CONTINUOUS
+    uint32_t children[childTotal]           node indices, each node's children contiguous; a categorical node's
+                                            sorted by attribute value, so that readers can binary search them
+    uint32_t firstClassCount[nodeCount]     position of a leaf's first entry in `classLabel` / `classCount`
+    uint32_t classCountLength[nodeCount]    number of classes among the training rows that reached a leaf
+    uint32_t classLabel[classCountTotal]    string id of each such class, each leaf's classes contiguous
+    uint32_t classCount[classCountTotal]    training rows of that class that reached the leaf
+    uint32_t stringOffset[stringCount + 1]  string i is stringData[stringOffset[i], stringOffset[i + 1])
+    char     stringData[stringBytes]        interned strings, not NUL-terminated
+
+Nodes are in depth-first order, so every child comes after its parent. `checksum` is the CRC-32 of every byte after
+the header. Readers reject files whose magic, version, size or checksum do not match.
+*/
+
+const char MODEL_MAGIC[4] = {'C', 'R', 'P', 'M'};
+const uint32_t MODEL_FORMAT_VERSION = 3;       // 2 added the leaf class distributions, 3 sorted categorical children.
+
+const uint8_t MODEL_NODE_LEAF = 1;
+const uint8_t MODEL_NODE_CONTINUOUS = 2;
+
+struct ModelHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t nodeCount;
+    uint32_t childTotal;
+    uint32_t stringCount;
+    uint32_t stringBytes;
+    uint32_t classCountTotal;
+    uint32_t checksum;
+    uint32_t reserved;
+    uint64_t fileSize;
+};
+
+// CRC-32 (IEEE 802.3, reflected) of `size` bytes, continuing from a previous `crc`.
+inline uint32_t modelChecksum(const void* data, size_t size, uint32_t crc = 0) {
+    static uint32_t table[256];
+    static bool tableReady = [] {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            table[i] = c;
+        }
+        return true;
+    }();
+    (void)tableReady;
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) {
+        crc = table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+inline size_t modelAlign(size_t offset) {
+    return (offset + 7) & ~size_t(7);
+}
+
+/*
+`ModelWriter` collects nodes in tree order, interns their strings and writes the binary model file (or returns its
+bytes, which `MappedModel::openBytes()` reads like a mapped file).
+*/
+class ModelWriter {
+public:
+    void addNode(int criteriaAttrIndex, const std::string& attrValue, bool isLeaf, const std::string& label,
+                 const std::vector<int>& nodeChildren, bool isContinuous, double nodeThreshold,
+                 const std::vector<std::pair<std::string, uint32_t>>& classCounts = {}) {
+        threshold.push_back(nodeThreshold);
+        attrIndex.push_back(criteriaAttrIndex);
+        valueId.push_back(intern(attrValue));
+        labelId.push_back(intern(label));
+        firstChild.push_back((uint32_t)children.size());
+        childCount.push_back((uint32_t)nodeChildren.size());
+        flags.push_back((isLeaf ? MODEL_NODE_LEAF : 0) | (isContinuous ? MODEL_NODE_CONTINUOUS : 0));
+        children.insert(children.end(), nodeChildren.begin(), nodeChildren.end());
+        firstClassCount.push_back((uint32_t)classLabel.size());
+        classCountLength.push_back((uint32_t)classCounts.size());
+        for (const std::pair<std::string, uint32_t>& count : classCounts) {
+            classLabel.push_back(intern(count.first));
+            classCount.push_back(count.second);
+        }
+    }
+
+    // bytes(): the model file's contents, header included.
+    std::vector<char> bytes() const {
+        // the children of a categorical node are written sorted by attribute value.
+        std::vector<uint32_t> sortedChildren = children;
+        for (size_t node = 0; node < flags.size(); node++) {
+            if (flags[node] & (MODEL_NODE_LEAF | MODEL_NODE_CONTINUOUS)) {
+                continue;
+            }
+            auto first = sortedChildren.begin() + firstChild[node];
+            auto last = first + childCount[node];
+            if (std::any_of(first, last, [this](uint32_t child) { return child >= valueId.size(); })) {
+                continue;       // readers reject the model anyway.
+            }
+            std::stable_sort(first, last, [this](uint32_t a, uint32_t b) {
+                return text(valueId[a]) < text(valueId[b]);
+            });
+        }
+
+        std::vector<char> body;
+        append(body, threshold);
+        append(body, attrIndex);
+        append(body, valueId);
+        append(body, labelId);
+        append(body, firstChild);
+        append(body, childCount);
+        append(body, flags);
+        append(body, sortedChildren);
+        append(body, firstClassCount);
+        append(body, classCountLength);
+        append(body, classLabel);
+        append(body, classCount);
+        append(body, stringOffset);
+        append(body, stringData);
+
+        ModelHeader header;
+        memcpy(header.magic, MODEL_MAGIC, sizeof(header.magic));
+        header.version = MODEL_FORMAT_VERSION;
+        header.headerSize = sizeof(ModelHeader);
+        header.nodeCount = (uint32_t)threshold.size();
+        header.childTotal = (uint32_t)children.size();
+        header.stringCount = (uint32_t)stringOffset.size() - 1;
+        header.stringBytes = (uint32_t)stringData.size();
+        header.classCountTotal = (uint32_t)classLabel.size();
+        header.checksum = modelChecksum(body.data(), body.size());
+        header.reserved = 0;
+        header.fileSize = sizeof(ModelHeader) + body.size();
+
+        std::vector<char> file(sizeof(header) + body.size());
+        memcpy(file.data(), &header, sizeof(header));
+        memcpy(file.data() + sizeof(header), body.data(), body.size());
+        return file;
+    }
+
+    bool write(const std::string& path) const {
+        std::vector<char> file = bytes();
+        // write to a temporary file and rename it, so a reader never maps a half-written model.
+        std::string temporaryPath = path + ".tmp";
+        std::ofstream fout(temporaryPath, std::ios::binary | std::ios::trunc);
+        fout.write(file.data(), file.size());
+        fout.close();
+        if (!fout) {
+            return false;
+        }
+#ifdef _WIN32
+        std::remove(path.c_str());      // Windows' rename() does not replace an existing file.
+#endif
+        return std::rename(temporaryPath.c_str(), path.c_str()) == 0;
+    }
+
+private:
+    std::vector<double> threshold;
+    std::vector<int32_t> attrIndex;
+    std::vector<uint32_t> valueId;
+    std::vector<uint32_t> labelId;
+    std::vector<uint32_t> firstChild;
+    std::vector<uint32_t> childCount;
+    std::vector<uint8_t> flags;
+    std::vector<uint32_t> children;
+    std::vector<uint32_t> firstClassCount;
+    std::vector<uint32_t> classCountLength;
+    std::vector<uint32_t> classLabel;
+    std::vector<uint32_t> classCount;
+    std::vector<uint32_t> stringOffset = {0};
+    std::vector<char> stringData;
+    std::unordered_map<std::string, uint32_t> stringId;
+
+    std::string_view text(uint32_t id) const {
+        return std::string_view(stringData.data() + stringOffset[id], stringOffset[id + 1] - stringOffset[id]);
+    }
+
+    uint32_t intern(const std::string& text) {
+        auto found = stringId.find(text);
+        if (found != stringId.end()) {
+            return found->second;
+        }
+        uint32_t id = (uint32_t)stringOffset.size() - 1;
+        stringData.insert(stringData.end(), text.begin(), text.end());
+        stringOffset.push_back((uint32_t)stringData.size());
+        stringId.emplace(text, id);
+        return id;
+    }
+
+    template <typename T>
+    static void append(std::vector<char>& body, const std::vector<T>& section) {
+        body.resize(modelAlign(body.size()));
+        const char* bytes = reinterpret_cast<const char*>(section.data());
+        body.insert(body.end(), bytes, bytes + section.size() * sizeof(T));
+    }
+};
+
+/*
+`MappedModel` maps a binary model file read-only (see mapped_file.h) and exposes its arrays in place. `open()` returns
+false (and leaves the model empty) if the file is missing, truncated, from another format version, fails its checksum
+or is not a well-formed tree. `openBytes()` does the same for a model built in memory by `ModelWriter::bytes()`.
+*/
+class MappedModel {
+public:
+    const ModelHeader* header = nullptr;
+    const double* threshold = nullptr;
+    const int32_t* criteriaAttrIndex = nullptr;
+    const uint32_t* attrValue = nullptr;
+    const uint32_t* label = nullptr;
+    const uint32_t* firstChild = nullptr;
+    const uint32_t* childCount = nullptr;
+    const uint8_t* flags = nullptr;
+    const uint32_t* children = nullptr;
+    const uint32_t* firstClassCount = nullptr;
+    const uint32_t* classCountLength = nullptr;
+    const uint32_t* classLabel = nullptr;
+    const uint32_t* classCount = nullptr;
+    const uint32_t* stringOffset = nullptr;
+    const char* stringData = nullptr;
+
+    MappedModel() = default;
+    MappedModel(const MappedModel&) = delete;
+    MappedModel& operator=(const MappedModel&) = delete;
+
+    ~MappedModel() {
+        close();
+    }
+
+    bool open(const std::string& path) {
+        close();
+        if (!file.open(path) || !validate(file.data(), file.size())) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    bool openBytes(std::vector<char> bytes) {
+        close();
+        buffer = std::move(bytes);
+        if (!validate(buffer.data(), buffer.size())) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+        file.close();
+        buffer.clear();
+        header = nullptr;
+    }
+
+    bool isOpen() const {
+        return header != nullptr;
+    }
+
+    uint32_t nodeCount() const {
+        return header->nodeCount;
+    }
+
+    bool isLeaf(uint32_t node) const {
+        return flags[node] & MODEL_NODE_LEAF;
+    }
+
+    bool isContinuous(uint32_t node) const {
+        return flags[node] & MODEL_NODE_CONTINUOUS;
+    }
+
+    std::string_view text(uint32_t stringId) const {
+        return std::string_view(stringData + stringOffset[stringId], stringOffset[stringId + 1] - stringOffset[stringId]);
+    }
+
+private:
+    MappedFile file;
+    std::vector<char> buffer;       // the model's bytes when it was built in memory rather than mapped.
+
+    bool validate(const char* data, size_t size) {
+        if (size < sizeof(ModelHeader)) {
+            return false;
+        }
+        const ModelHeader* candidate = reinterpret_cast<const ModelHeader*>(data);
+        if (memcmp(candidate->magic, MODEL_MAGIC, sizeof(candidate->magic)) != 0 ||
+            candidate->version != MODEL_FORMAT_VERSION || candidate->headerSize != sizeof(ModelHeader) ||
+            candidate->fileSize != size) {
+            return false;
+        }
+        const char* body = data + sizeof(ModelHeader);
+        size_t bodySize = size - sizeof(ModelHeader);
+        if (modelChecksum(body, bodySize) != candidate->checksum) {
+            return false;
+        }
+
+        size_t offset = 0;
+        uint32_t nodes = candidate->nodeCount;
+        threshold = section<double>(body, offset, nodes);
+        criteriaAttrIndex = section<int32_t>(body, offset, nodes);
+        attrValue = section<uint32_t>(body, offset, nodes);
+        label = section<uint32_t>(body, offset, nodes);
+        firstChild = section<uint32_t>(body, offset, nodes);
+        childCount = section<uint32_t>(body, offset, nodes);
+        flags = section<uint8_t>(body, offset, nodes);
+        children = section<uint32_t>(body, offset, candidate->childTotal);
+        firstClassCount = section<uint32_t>(body, offset, nodes);
+        classCountLength = section<uint32_t>(body, offset, nodes);
+        classLabel = section<uint32_t>(body, offset, candidate->classCountTotal);
+        classCount = section<uint32_t>(body, offset, candidate->classCountTotal);
+        stringOffset = section<uint32_t>(body, offset, candidate->stringCount + 1);
+        stringData = section<char>(body, offset, candidate->stringBytes);
+        if (offset != bodySize || nodes == 0) {
+            return false;
+        }
+
+        // structural checks, so that walking the tree can never index outside the file or loop.
+        uint32_t strings = candidate->stringCount;
+        for (uint32_t i = 0; i < strings; i++) {
+            if (stringOffset[i] > stringOffset[i + 1]) {
+                return false;
+            }
+        }
+        if (stringOffset[0] != 0 || stringOffset[strings] != candidate->stringBytes) {
+            return false;
+        }
+        for (uint32_t node = 0; node < nodes; node++) {
+            if (attrValue[node] >= strings || label[node] >= strings ||
+                (uint64_t)firstChild[node] + childCount[node] > candidate->childTotal ||
+                (uint64_t)firstClassCount[node] + classCountLength[node] > candidate->classCountTotal) {
+                return false;
+            }
+            if (!(flags[node] & MODEL_NODE_LEAF) &&
+                (criteriaAttrIndex[node] < 0 || childCount[node] == 0 ||
+                 ((flags[node] & MODEL_NODE_CONTINUOUS) && childCount[node] != 2))) {
+                return false;
+            }
+        }
+        for (uint32_t node = 0; node < nodes; node++) {
+            const uint32_t* first = children + firstChild[node];
+            for (uint32_t c = 0; c < childCount[node]; c++) {
+                if (first[c] <= node || first[c] >= nodes) {
+                    return false;
+                }
+                if (c > 0 && !(flags[node] & MODEL_NODE_CONTINUOUS) &&
+                    text(attrValue[first[c]]) < text(attrValue[first[c - 1]])) {
+                    return false;
+                }
+            }
+        }
+        for (uint32_t i = 0; i < candidate->classCountTotal; i++) {
+            if (classLabel[i] >= strings) {
+                return false;
+            }
+        }
+        header = candidate;
+        return true;
+    }
+
+    template <typename T>
+    static const T* section(const char* body, size_t& offset, size_t count) {
+        offset = modelAlign(offset);
+        const T* start = reinterpret_cast<const T*>(body + offset);
+        offset += count * sizeof(T);
+        return start;
+    }
+};
+
+#endif
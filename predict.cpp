@@ -2,89 +2,581 @@
 #include <fstream>
 #include <vector>
 #include <string>
+#include <string_view>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <memory>
+#include <list>
+#include <atomic>
+#include <csignal>
+#include <filesystem>
 #include <nlohmann/json.hpp>
+#include "predictor.h"
+
+#ifndef _WIN32
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
 
 using json = nlohmann::json;
 using namespace std;
 
-// Define Node structure similar to the one used in DecisionTree class
-struct Node {
-    int criteriaAttrIndex;
-    string attrValue;
-    int treeIndex;
-    bool isLeaf;
-    string label;
-    vector<int> children;
+// Input field names of the model's attributes, in model order; instance.json calls the pH field "ph_level".
+const vector<vector<string>> ATTRIBUTE_FIELDS = {
+    {"N"}, {"P"}, {"K"}, {"temperature"}, {"humidity"}, {"ph", "ph_level"}, {"rainfall"}
 };
 
-// Function to recursively build the decision tree nodes from JSON
-Node buildTree(const json& nodeJson) {
-    Node node;
-    node.criteriaAttrIndex = nodeJson["criteriaAttrIndex"];
-    node.attrValue = nodeJson["attrValue"];
-    node.treeIndex = nodeJson["treeIndex"];
-    node.isLeaf = nodeJson["isLeaf"];
-    node.label = nodeJson["label"];
-    node.children = nodeJson["children"].get<vector<int>>();
-    return node;
+/*
+parseInstance(): reads one instance.json-style object (string or number values) into `row`, in model attribute order.
+`text` holds the values' text and must outlive the use of `row`.
+*/
+bool parseInstance(string_view line, vector<string_view>& row, vector<string>& text) {
+    json instance = json::parse(line.begin(), line.end(), nullptr, false);
+    if (!instance.is_object()) {
+        return false;
+    }
+    for (size_t attr = 0; attr < row.size(); attr++) {
+        const json* value = nullptr;
+        for (const string& field : ATTRIBUTE_FIELDS[attr]) {
+            auto found = instance.find(field);
+            if (found != instance.end()) {
+                value = &*found;
+                break;
+            }
+        }
+        if (value == nullptr) {
+            return false;
+        }
+        text[attr] = value->is_string() ? value->get<string>() : value->dump();
+        row[attr] = text[attr];
+    }
+    return true;
+}
+
+// predictRow(): label id of a parsed row under a single tree or a forest (which counts votes in `votes`).
+int predictRow(const Predictor& predictor, const vector<string_view>& row, vector<uint32_t>&) {
+    return predictor.predictLabel(row, row.size());
+}
+
+int predictRow(const ForestPredictor& forest, const vector<string_view>& row, vector<uint32_t>& votes) {
+    return forest.predictLabel(row, row.size(), votes);
 }
 
-// Function to predict based on the loaded decision tree
-string predict(const json& treeJson, const vector<string>& instance) {
-    int currentNodeIndex = 0; // Start from root node
+/*
+`BatchPredictor` scores a stream of instances, either CSV with a header row (shaped like Crop_recommendation.csv;
+extra columns such as `label` are ignored) or JSONL with one instance.json-style object per line. The input is read in
+large blocks; the complete lines of each block are split across worker threads that parse and classify them in place,
+and the predictions are written in input order, as CSV (`predicted_crop` column) or JSONL to match the input.
+Blank lines are skipped. Throughput is reported on stderr. `Model` is a `Predictor` or a `ForestPredictor`.
+*/
+template <typename Model>
+class BatchPredictor {
+public:
+    BatchPredictor(const Model& predictor, int threadCount) : predictor(predictor), threadCount(threadCount) {}
+
+    bool run(istream& in, ostream& out) {
+        auto startTime = chrono::steady_clock::now();
+        size_t rowCount = 0;
+        string block;
+        string carry;
+        vector<string_view> lines;
+        vector<int> labels;
+        string output;
+        bool first = true;
+        while (readBlock(in, block, carry)) {
+            splitLines(block, lines);
+            size_t begin = 0;
+            if (first && !lines.empty()) {
+                isJson = lines[0].find('{') != string_view::npos;
+                if (!isJson) {
+                    if (!readHeader(lines[0])) {
+                        return false;
+                    }
+                    begin = 1;
+                }
+                out << (isJson ? "" : "predicted_crop\n");
+                first = false;
+            }
+
+            labels.assign(lines.size(), Model::FAILED);
+            classify(lines, begin, labels);
 
-    while (true) {
-        Node currentNode = buildTree(treeJson[currentNodeIndex]);
+            output.clear();
+            for (size_t i = begin; i < lines.size(); i++) {
+                string_view label =
+                    labels[i] == Model::FAILED ? string_view(FAILED_TEXT) : predictor.labelName(labels[i]);
+                if (isJson) {
+                    output += "{\"predicted_crop\": ";
+                    output += json(label).dump();
+                    output += "}\n";
+                } else {
+                    output += label;
+                    output += '\n';
+                }
+            }
+            out << output;
+            rowCount += lines.size() - begin;
+        }
+        out.flush();
+        if (!out) {
+            cerr << "predictions could not be written\n";
+            return false;
+        }
+
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+        cerr << rowCount << " rows in " << seconds << " s (" << (seconds > 0 ? rowCount / seconds : 0.0)
+             << " rows/s, " << threadCount << " threads)\n";
+        return true;
+    }
+
+private:
+    const Model& predictor;
+    int threadCount;
+    bool isJson = false;
+    vector<int> columnOfAttr;       // CSV column holding each model attribute.
+    size_t columnsNeeded = 0;
+
+    static const size_t BLOCK_BYTES = 8 << 20;
+    inline static const string FAILED_TEXT = "Prediction failed";
 
-        if (currentNode.isLeaf) {
-            return currentNode.label; // Return the predicted label
+    // readBlock(): reads the next block of whole lines into `block`, keeping a trailing partial line in `carry`.
+    static bool readBlock(istream& in, string& block, string& carry) {
+        block.swap(carry);
+        carry.clear();
+        if (!in) {
+            return !block.empty();
+        }
+        size_t kept = block.size();
+        block.resize(kept + BLOCK_BYTES);
+        in.read(&block[kept], BLOCK_BYTES);
+        block.resize(kept + in.gcount());
+        if (in) {
+            size_t lastNewline = block.rfind('\n');
+            if (lastNewline == string::npos) {
+                carry.swap(block);
+                return readBlock(in, block, carry);
+            }
+            carry.assign(block, lastNewline + 1, string::npos);
+            block.resize(lastNewline + 1);
+        }
+        return !block.empty();
+    }
+
+    static void splitLines(const string& block, vector<string_view>& lines) {
+        lines.clear();
+        size_t start = 0;
+        while (start < block.size()) {
+            size_t end = block.find('\n', start);
+            if (end == string::npos) {
+                end = block.size();
+            }
+            string_view line(block.data() + start, end - start);
+            if (!line.empty() && line.back() == '\r') {
+                line.remove_suffix(1);
+            }
+            if (line.find_first_not_of(" \t") != string_view::npos) {
+                lines.push_back(line);
+            }
+            start = end + 1;
         }
+    }
 
-        int criteriaAttrIndex = currentNode.criteriaAttrIndex;
-        string instanceAttrValue = instance[criteriaAttrIndex];
+    bool readHeader(string_view header) {
+        vector<string_view> names;
+        splitFields(header, names, SIZE_MAX);
+        columnOfAttr.assign(ATTRIBUTE_FIELDS.size(), -1);
+        for (size_t attr = 0; attr < ATTRIBUTE_FIELDS.size(); attr++) {
+            for (size_t column = 0; column < names.size() && columnOfAttr[attr] == -1; column++) {
+                for (const string& field : ATTRIBUTE_FIELDS[attr]) {
+                    if (names[column] == field) {
+                        columnOfAttr[attr] = (int)column;
+                        columnsNeeded = max(columnsNeeded, column + 1);
+                    }
+                }
+            }
+            if (columnOfAttr[attr] == -1) {
+                cerr << "CSV header has no " << ATTRIBUTE_FIELDS[attr][0] << " column\n";
+                return false;
+            }
+        }
+        return true;
+    }
 
-        bool foundChild = false;
-        for (int childIndex : currentNode.children) {
-            Node childNode = buildTree(treeJson[childIndex]);
-            if (childNode.attrValue == instanceAttrValue) {
-                currentNodeIndex = childIndex;
-                foundChild = true;
+    static void splitFields(string_view line, vector<string_view>& fields, size_t limit) {
+        fields.clear();
+        size_t start = 0;
+        while (fields.size() < limit) {
+            size_t comma = line.find(',', start);
+            fields.push_back(line.substr(start, comma == string_view::npos ? string_view::npos : comma - start));
+            if (comma == string_view::npos) {
                 break;
             }
+            start = comma + 1;
+        }
+    }
+
+    // classify(): splits lines[begin..] into one contiguous slice per thread.
+    void classify(const vector<string_view>& lines, size_t begin, vector<int>& labels) {
+        size_t count = lines.size() - begin;
+        size_t workers = min<size_t>(threadCount, max<size_t>(1, count / 1024));
+        vector<thread> threads;
+        for (size_t w = 0; w < workers; w++) {
+            size_t sliceBegin = begin + count * w / workers;
+            size_t sliceEnd = begin + count * (w + 1) / workers;
+            if (w + 1 == workers) {
+                classifySlice(lines, sliceBegin, sliceEnd, labels);
+            } else {
+                threads.emplace_back(&BatchPredictor::classifySlice, this, cref(lines), sliceBegin, sliceEnd, ref(labels));
+            }
+        }
+        for (thread& worker : threads) {
+            worker.join();
         }
+    }
 
-        if (!foundChild) {
-            // If no matching child found, return an error or handle appropriately
-            return "Prediction failed";
+    void classifySlice(const vector<string_view>& lines, size_t begin, size_t end, vector<int>& labels) const {
+        vector<string_view> fields;
+        vector<string_view> row(ATTRIBUTE_FIELDS.size());
+        vector<string> text(ATTRIBUTE_FIELDS.size());      // JSON values, kept alive while the row is classified.
+        vector<uint32_t> votes;
+        for (size_t i = begin; i < end; i++) {
+            if (isJson ? parseInstance(lines[i], row, text) : parseCsvRow(lines[i], fields, row)) {
+                labels[i] = predictRow(predictor, row, votes);
+            }
         }
     }
-}
 
-int main() {
-    // Read serialized decision tree from JSON file
-    ifstream fin_tree("crop_prediction.json");
-    json treeJson;
-    fin_tree >> treeJson;
-    fin_tree.close();
+    bool parseCsvRow(string_view line, vector<string_view>& fields, vector<string_view>& row) const {
+        splitFields(line, fields, columnsNeeded);
+        if (fields.size() < columnsNeeded) {
+            return false;
+        }
+        for (size_t attr = 0; attr < row.size(); attr++) {
+            row[attr] = fields[columnOfAttr[attr]];
+        }
+        return true;
+    }
+};
+
+/*
+`PredictionServer` keeps the model resident and answers predictions over a Unix domain socket. The protocol is line
+delimited JSON: each request line is an instance.json-style object and each response line is
+{"predicted_crop": "<label>"} (or {"error": "<reason>"}), in request order. Every connection is served on its own
+thread, so clients never wait for each other; on shutdown the open connections are shut down and their threads
+joined before run() returns. A watcher thread polls the model files once a second and, when one
+changes, loads the new model and swaps it in; requests already running finish on the model they started with.
+*/
+class PredictionServer {
+public:
+    PredictionServer(const string& socketPath, shared_ptr<const Predictor> predictor)
+        : socketPath(socketPath), current(move(predictor)) {}
+
+    int run() {
+#ifdef _WIN32
+        cerr << "--serve needs Unix domain sockets, which this build does not support\n";
+        return 1;
+#else
+        int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (listener < 0 || socketPath.size() >= sizeof(address.sun_path)) {
+            cerr << "socket " << socketPath << " could not be created\n";
+            return 1;
+        }
+        socketPath.copy(address.sun_path, socketPath.size());
+        unlink(socketPath.c_str());
+        if (::bind(listener, (sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 64) != 0) {
+            cerr << "socket " << socketPath << " could not be bound\n";
+            close(listener);
+            return 1;
+        }
+        signal(SIGPIPE, SIG_IGN);
+        signal(SIGINT, requestStop);
+        signal(SIGTERM, requestStop);
+        cerr << "Serving predictions on " << socketPath << "\n";
+
+        thread watcher(&PredictionServer::watchModel, this);
+        while (!stopRequested) {
+            reapClients(false);
+            pollfd waiting{listener, POLLIN, 0};
+            if (poll(&waiting, 1, 500) <= 0) {
+                continue;
+            }
+            int client = accept(listener, nullptr, nullptr);
+            if (client >= 0) {
+                clients.emplace_back();
+                clients.back().socket = client;
+                clients.back().worker = thread(&PredictionServer::serveClient, this, ref(clients.back()));
+            }
+        }
+        reapClients(true);
+        watcher.join();
+        close(listener);
+        unlink(socketPath.c_str());
+        return 0;
+#endif
+    }
+
+private:
+    // a connection and the thread serving it; the socket is closed by the accept loop once the thread is joined.
+    struct Client {
+        int socket = -1;
+        thread worker;
+        atomic<bool> finished{false};
+    };
+
+    string socketPath;
+    mutex modelMutex;
+    shared_ptr<const Predictor> current;        // swapped whole on reload, under modelMutex.
+    list<Client> clients;                       // only touched by the accept loop in run().
+    inline static volatile sig_atomic_t stopRequested = 0;
+
+    static const size_t MAX_LINE_BYTES = 1 << 16;
+
+    static void requestStop(int) {
+        stopRequested = 1;
+    }
+
+    shared_ptr<const Predictor> model() {
+        lock_guard<mutex> lock(modelMutex);
+        return current;
+    }
+
+    static filesystem::file_time_type modifiedTime(const string& path) {
+        error_code error;
+        filesystem::file_time_type time = filesystem::last_write_time(path, error);
+        return error ? filesystem::file_time_type::min() : time;
+    }
+
+    // watchModel(): reloads the model whenever crop_prediction.bin or crop_prediction.json changes.
+    void watchModel() {
+        auto binaryTime = modifiedTime("crop_prediction.bin");
+        auto jsonTime = modifiedTime("crop_prediction.json");
+        while (!stopRequested) {
+            this_thread::sleep_for(chrono::seconds(1));
+            auto newBinaryTime = modifiedTime("crop_prediction.bin");
+            auto newJsonTime = modifiedTime("crop_prediction.json");
+            if (newBinaryTime == binaryTime && newJsonTime == jsonTime) {
+                continue;
+            }
+            shared_ptr<Predictor> reloaded = make_shared<Predictor>();
+            if (!reloaded->load("crop_prediction.bin", "crop_prediction.json")) {
+                cerr << "Model changed but could not be loaded; keeping the current model\n";
+                continue;       // retried on the next poll, e.g. once the trainer has finished writing.
+            }
+            binaryTime = newBinaryTime;
+            jsonTime = newJsonTime;
+            {
+                lock_guard<mutex> lock(modelMutex);
+                current = reloaded;
+            }
+            cerr << "Reloaded model (" << reloaded->nodeCount() << " nodes)\n";
+        }
+    }
+
+#ifndef _WIN32
+    /*
+    reapClients(): joins the threads of the connections that have ended and closes their sockets. With `all`, first
+    shuts down every open connection, which ends its thread's recv(), and then reaps them all.
+    */
+    void reapClients(bool all) {
+        for (auto client = clients.begin(); client != clients.end();) {
+            if (all) {
+                shutdown(client->socket, SHUT_RDWR);
+            } else if (!client->finished) {
+                ++client;
+                continue;
+            }
+            client->worker.join();
+            close(client->socket);
+            client = clients.erase(client);
+        }
+    }
+
+    void serveClient(Client& connection) {
+        int client = connection.socket;
+        vector<string_view> row(ATTRIBUTE_FIELDS.size());
+        vector<string> text(ATTRIBUTE_FIELDS.size());
+        string pending;
+        string response;
+        char buffer[4096];
+        while (true) {
+            ssize_t received = recv(client, buffer, sizeof(buffer), 0);
+            if (received <= 0) {
+                break;
+            }
+            pending.append(buffer, received);
+
+            response.clear();
+            size_t start = 0;
+            size_t newline;
+            while ((newline = pending.find('\n', start)) != string::npos) {
+                string_view line(pending.data() + start, newline - start);
+                start = newline + 1;
+                if (line.find_first_not_of(" \t\r") == string_view::npos) {
+                    continue;
+                }
+                if (!parseInstance(line, row, text)) {
+                    response += "{\"error\": \"invalid instance\"}\n";
+                    continue;
+                }
+                shared_ptr<const Predictor> predictor = model();
+                int label = predictor->predictLabel(row, row.size());
+                if (label == Predictor::FAILED) {
+                    response += "{\"predicted_crop\": \"Prediction failed\"}\n";
+                } else {
+                    response += "{\"predicted_crop\": " + json(predictor->labelName(label)).dump() + "}\n";
+                }
+            }
+            pending.erase(0, start);
+            if (pending.size() > MAX_LINE_BYTES) {
+                response += "{\"error\": \"request line too long\"}\n";
+                sendAll(client, response);
+                break;
+            }
+            if (!response.empty() && !sendAll(client, response)) {
+                break;
+            }
+        }
+        connection.finished = true;
+    }
+
+    static bool sendAll(int client, const string& data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t written = send(client, data.data() + sent, data.size() - sent, 0);
+            if (written <= 0) {
+                return false;
+            }
+            sent += written;
+        }
+        return true;
+    }
+#else
+    void reapClients(bool) {}
+    void serveClient(Client&) {}
+#endif
+};
+
+int main(int argc, char* argv[]) {
+    string batchInput;
+    string batchOutput = "-";
+    string socketPath;
+    string forestPath;              // --forest [file]: predict with a random forest instead of the single tree.
+    bool showProbabilities = false;
+    int threadCount = max(1, (int)thread::hardware_concurrency());
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--batch" && i + 1 < argc) {
+            batchInput = argv[++i];
+        } else if (arg == "--output" && i + 1 < argc) {
+            batchOutput = argv[++i];
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threadCount = max(1, stoi(argv[++i]));
+        } else if (arg == "--serve") {
+            socketPath = (i + 1 < argc && argv[i + 1][0] != '-') ? argv[++i] : "crop_predict.sock";
+        } else if (arg == "--forest") {
+            forestPath = (i + 1 < argc && argv[i + 1][0] != '-') ? argv[++i] : "crop_forest.json";
+        } else if (arg == "--probabilities") {
+            showProbabilities = true;
+        } else {
+            cerr << "Usage: " << argv[0] << " [--batch <instances.csv|instances.jsonl|-> [--output <file|->] [--threads N]]"
+                 << " [--serve [socket]] [--forest [crop_forest.json] [--probabilities]]\n";
+            return 1;
+        }
+    }
 
     // Read instance data from JSON file
-    ifstream fin_instance("instance.json");
-    json instanceJson;
-    fin_instance >> instanceJson;
-    fin_instance.close();
-
-    // Extract instance data into a vector of strings
-    vector<string> instance;
-    instance.push_back(instanceJson["N"]);
-    instance.push_back(instanceJson["P"]);
-    instance.push_back(instanceJson["K"]);
-    instance.push_back(instanceJson["temperature"]);
-    instance.push_back(instanceJson["humidity"]);
-    instance.push_back(instanceJson["ph_level"]);
-    instance.push_back(instanceJson["rainfall"]);
+    auto readInstance = [] {
+        ifstream fin_instance("instance.json");
+        json instanceJson;
+        fin_instance >> instanceJson;
+        fin_instance.close();
+
+        // Extract instance data into a vector of strings
+        vector<string> instance;
+        instance.push_back(instanceJson["N"]);
+        instance.push_back(instanceJson["P"]);
+        instance.push_back(instanceJson["K"]);
+        instance.push_back(instanceJson["temperature"]);
+        instance.push_back(instanceJson["humidity"]);
+        instance.push_back(instanceJson["ph_level"]);
+        instance.push_back(instanceJson["rainfall"]);
+        return instance;
+    };
+
+    // Batch mode: classify a whole stream of instances ("-" is stdin / stdout)
+    auto runBatch = [&](const auto& model) {
+        ifstream fin;
+        ofstream fout;
+        if (batchInput != "-") {
+            fin.open(batchInput, ios::binary);
+            if (!fin) {
+                cerr << batchInput << " file could not be opened\n";
+                return 1;
+            }
+        }
+        if (batchOutput != "-") {
+            fout.open(batchOutput, ios::binary);
+            if (!fout) {
+                cerr << "Cannot write " << batchOutput << "\n";
+                return 1;
+            }
+        }
+        BatchPredictor<decay_t<decltype(model)>> batch(model, threadCount);
+        bool ok = batch.run(batchInput == "-" ? cin : fin, batchOutput == "-" ? cout : fout);
+        return ok ? 0 : 1;
+    };
+
+    // Forest mode: majority vote of the trees in crop_forest.json, evaluated in parallel
+    if (!forestPath.empty()) {
+        ForestPredictor forest;
+        if (!forest.loadJson(forestPath)) {
+            cerr << forestPath << " could not be loaded\n";
+            return 1;
+        }
+        if (!batchInput.empty()) {
+            return runBatch(forest);
+        }
+        TaskScheduler scheduler(threadCount);
+        vector<string> instance = readInstance();
+        cout << forest.predict(instance, &scheduler) << endl;
+        if (showProbabilities) {
+            vector<double> probability = forest.probabilities(instance, instance.size(), &scheduler);
+            for (size_t c = 0; c < probability.size(); c++) {
+                if (probability[c] > 0) {
+                    cout << forest.labelName((int)c) << " " << probability[c] << "\n";
+                }
+            }
+        }
+        return 0;
+    }
+
+    // Load the trained decision tree once: the binary model if present, otherwise the JSON model
+    Predictor predictor;
+    if (!predictor.load("crop_prediction.bin", "crop_prediction.json")) {
+        cerr << "crop_prediction.bin / crop_prediction.json could not be loaded\n";
+        return 1;
+    }
+
+    // Server mode: keep the model resident and answer requests on a Unix domain socket
+    if (!socketPath.empty()) {
+        PredictionServer server(socketPath, make_shared<Predictor>(move(predictor)));
+        return server.run();
+    }
+
+    // Batch mode: classify a whole stream of instances ("-" is stdin / stdout)
+    if (!batchInput.empty()) {
+        return runBatch(predictor);
+    }
+
+    vector<string> instance = readInstance();
 
     // Perform prediction using the loaded decision tree
-    string prediction = predict(treeJson, instance);
+    string prediction(predictor.predict(instance));
 
     // Output the predicted crop label
     cout << prediction << endl;
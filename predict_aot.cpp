@@ -0,0 +1,38 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <nlohmann/json.hpp>
+#include "crop_prediction_model.h"  // generated by `./decision --emit-cpp crop_prediction_model.h`
+
+using json = nlohmann::json;
+using namespace std;
+
+/*
+Standalone predictor with the trained decision tree compiled in: there is no model file to load. Reads instance.json
+like predict.cpp and prints the predicted crop. Rebuild it whenever the model is retrained.
+*/
+int main() {
+    // Read instance data from JSON file
+    ifstream fin_instance("instance.json");
+    json instanceJson;
+    fin_instance >> instanceJson;
+    fin_instance.close();
+
+    // Extract instance data into a vector of strings
+    vector<string> instance;
+    instance.push_back(instanceJson["N"]);
+    instance.push_back(instanceJson["P"]);
+    instance.push_back(instanceJson["K"]);
+    instance.push_back(instanceJson["temperature"]);
+    instance.push_back(instanceJson["humidity"]);
+    instance.push_back(instanceJson["ph_level"]);
+    instance.push_back(instanceJson["rainfall"]);
+
+    const char* prediction = predictCropGenerated(instance, instance.size());
+
+    // Output the predicted crop label
+    cout << (prediction != nullptr ? prediction : "Prediction failed") << endl;
+
+    return 0;
+}
@@ -0,0 +1,507 @@
+#ifndef PREDICTOR_H
+#define PREDICTOR_H
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "model_format.h"
+#include "task_scheduler.h"
+
+/*
+`Predictor` is a decision tree ready for inference. It walks the struct-of-arrays layout of the binary model (see
+model_format.h) in place:
+
+- one flat array per node field (flags, attribute, threshold, label, child range),
+- every attribute value and label interned once in the string table,
+- the children of a categorical node stored contiguously and sorted by attribute value, so the matching child is
+  found by binary search, and the two children of a continuous node found by a single compare.
+
+`loadBinary()` maps crop_prediction.bin and uses its arrays as they are, so loading costs one validation pass over
+the file. `loadJson()` builds the same layout in memory from crop_prediction.json.
+
+`predictLabel()` then walks O(depth) nodes and allocates nothing. A row is anything indexable whose elements convert
+to std::string_view (a vector<string>, an array of string_views, ...). A loaded Predictor is read-only and can be
+shared by any number of threads.
+*/
+class Predictor {
+public:
+    static constexpr int FAILED = -1;   // returned by predictLabel() when the row does not reach a leaf.
+
+    bool loadBinary(const std::string& path) {
+        std::unique_ptr<MappedModel> mapped(new MappedModel());
+        if (!mapped->open(path)) {
+            return false;
+        }
+        use(std::move(mapped));
+        return true;
+    }
+
+    bool loadJson(const std::string& path) {
+        std::ifstream fin(path);
+        if (!fin) {
+            return false;
+        }
+        return loadJsonTree(nlohmann::json::parse(fin, nullptr, false));
+    }
+
+    /*
+    loadJsonTree(): a tree already parsed from the JSON model format (an array of nodes). Returns false, leaving the
+    predictor empty, if a node field has the wrong JSON type or the tree fails the checks of `MappedModel` (a child out
+    of range or not after its parent, a continuous node without exactly two children, an inner node without children).
+    */
+    bool loadJsonTree(const nlohmann::json& treeJson) {
+        clear();
+        if (!treeJson.is_array() || treeJson.empty()) {
+            return false;
+        }
+        ModelWriter writer;
+        for (const nlohmann::json& nodeJson : treeJson) {
+            if (!hasFieldTypes(nodeJson)) {
+                return false;
+            }
+            std::vector<int> children;
+            for (const nlohmann::json& child : nodeJson.value("children", nlohmann::json::array())) {
+                int64_t index = child.get<int64_t>();
+                children.push_back(index < 0 || index > INT32_MAX ? -1 : (int)index);
+            }
+            std::vector<std::pair<std::string, uint32_t>> classCounts;
+            nlohmann::json classCountsJson = nodeJson.value("classCounts", nlohmann::json::object());
+            for (const auto& count : classCountsJson.items()) {
+                classCounts.push_back({count.key(), count.value().get<uint32_t>()});
+            }
+            writer.addNode(nodeJson.value("criteriaAttrIndex", -1), nodeJson.value("attrValue", std::string()),
+                           nodeJson.value("isLeaf", false), nodeJson.value("label", std::string()), children,
+                           nodeJson.value("isContinuous", false), nodeJson.value("threshold", 0.0), classCounts);
+        }
+        std::unique_ptr<MappedModel> built(new MappedModel());
+        if (!built->openBytes(writer.bytes())) {
+            return false;
+        }
+        use(std::move(built));
+        return true;
+    }
+
+    // load(): the binary model if it is present and valid, otherwise the JSON model.
+    bool load(const std::string& binaryPath, const std::string& jsonPath) {
+        return loadBinary(binaryPath) || loadJson(jsonPath);
+    }
+
+    bool isLoaded() const {
+        return model != nullptr;
+    }
+
+    size_t nodeCount() const {
+        return count;
+    }
+
+    // index of the leaf that `row` reaches, or FAILED.
+    template <typename Row>
+    int predictLeaf(const Row& row, size_t rowSize) const {
+        uint32_t node = 0;
+        while (!(flags[node] & MODEL_NODE_LEAF)) {
+            uint32_t attr = (uint32_t)attrIndex[node];
+            if (attr >= rowSize) {
+                return FAILED;
+            }
+            std::string_view value(row[attr]);
+            const uint32_t* first = children + firstChild[node];
+            if (flags[node] & MODEL_NODE_CONTINUOUS) {
+                double number;
+                if (!parseNumber(value, number)) {
+                    return FAILED;
+                }
+                node = first[number <= threshold[node] ? 0 : 1];
+                continue;
+            }
+
+            const uint32_t* found = std::lower_bound(first, first + childCount[node], value,
+                [this](uint32_t child, std::string_view key) { return text(attrValue[child]) < key; });
+            if (found == first + childCount[node] || text(attrValue[*found]) != value) {
+                return FAILED;
+            }
+            node = *found;
+        }
+        return (int)node;
+    }
+
+    // class label id that `row` is predicted as, or FAILED.
+    template <typename Row>
+    int predictLabel(const Row& row, size_t rowSize) const {
+        int leaf = predictLeaf(row, rowSize);
+        return leaf == FAILED ? FAILED : (int)label[leaf];
+    }
+
+    int predictLabel(const std::vector<std::string>& row) const {
+        return predictLabel(row, row.size());
+    }
+
+    // predicted label text, or "Prediction failed".
+    std::string_view predict(const std::vector<std::string>& row) const {
+        int predicted = predictLabel(row);
+        return predicted == FAILED ? std::string_view("Prediction failed") : text(predicted);
+    }
+
+    std::string_view labelName(int labelId) const {
+        return text(labelId);
+    }
+
+    bool isLeaf(size_t node) const {
+        return flags[node] & MODEL_NODE_LEAF;
+    }
+
+    // label id of a leaf.
+    int leafLabel(size_t leaf) const {
+        return (int)label[leaf];
+    }
+
+    /*
+    leafClassCounts(): the class distribution of a leaf, the number of training rows of each class (`label[i]`, a label
+    id, has `count[i]` rows) that reached it. Leaves of models trained before distributions were stored count one row
+    of their own label.
+    */
+    struct ClassCounts {
+        const uint32_t* label;
+        const uint32_t* count;
+        size_t size;
+    };
+
+    ClassCounts leafClassCounts(size_t leaf) const {
+        static const uint32_t oneRow = 1;
+        if (classCountLength[leaf] == 0) {
+            return {label + leaf, &oneRow, 1};
+        }
+        return {classLabel + firstClassCount[leaf], classCount + firstClassCount[leaf], classCountLength[leaf]};
+    }
+
+    // leafLabels(): the distinct label ids that leaves can return, in order of first appearance in the tree.
+    std::vector<int> leafLabels() const {
+        std::vector<int> labels;
+        std::vector<bool> seen(stringCount, false);
+        for (size_t node = 0; node < count; node++) {
+            if (isLeaf(node) && !seen[label[node]]) {
+                seen[label[node]] = true;
+                labels.push_back((int)label[node]);
+            }
+        }
+        return labels;
+    }
+
+    /*
+    distributionLabels(): the distinct label ids in leaf class distributions, a superset of leafLabels(), in order of
+    first appearance in the tree.
+    */
+    std::vector<int> distributionLabels() const {
+        std::vector<int> labels;
+        std::vector<bool> seen(stringCount, false);
+        for (size_t node = 0; node < count; node++) {
+            if (!isLeaf(node)) {
+                continue;
+            }
+            ClassCounts counts = leafClassCounts(node);
+            for (size_t i = 0; i < counts.size; i++) {
+                if (!seen[counts.label[i]]) {
+                    seen[counts.label[i]] = true;
+                    labels.push_back((int)counts.label[i]);
+                }
+            }
+        }
+        return labels;
+    }
+
+    // parseNumber(): reads a whole field (surrounding spaces allowed) as a double without allocating.
+    static bool parseNumber(std::string_view text, double& number) {
+        while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) {
+            text.remove_prefix(1);
+        }
+        while (!text.empty() && (text.back() == ' ' || text.back() == '\t' || text.back() == '\r')) {
+            text.remove_suffix(1);
+        }
+        if (!text.empty() && text.front() == '+') {
+            text.remove_prefix(1);
+        }
+        if (text.empty()) {
+            return false;
+        }
+        std::from_chars_result result = std::from_chars(text.data(), text.data() + text.size(), number);
+        return result.ec == std::errc() && result.ptr == text.data() + text.size();
+    }
+
+private:
+    // hasFieldTypes(): whether every field loadJsonTree() reads from a node is absent or of the type it expects.
+    static bool hasFieldTypes(const nlohmann::json& nodeJson) {
+        if (!nodeJson.is_object()) {
+            return false;
+        }
+        auto typed = [&nodeJson](const char* key, bool (nlohmann::json::*isType)() const) {
+            auto found = nodeJson.find(key);
+            return found == nodeJson.end() || ((*found).*isType)();
+        };
+        if (!typed("children", &nlohmann::json::is_array) || !typed("classCounts", &nlohmann::json::is_object) ||
+            !typed("criteriaAttrIndex", &nlohmann::json::is_number_integer) ||
+            !typed("attrValue", &nlohmann::json::is_string) || !typed("isLeaf", &nlohmann::json::is_boolean) ||
+            !typed("label", &nlohmann::json::is_string) || !typed("isContinuous", &nlohmann::json::is_boolean) ||
+            !typed("threshold", &nlohmann::json::is_number)) {
+            return false;
+        }
+        auto children = nodeJson.find("children");
+        auto classCounts = nodeJson.find("classCounts");
+        if (children != nodeJson.end() &&
+            !std::all_of(children->begin(), children->end(), [](const nlohmann::json& child) {
+                return child.is_number_integer();
+            })) {
+            return false;
+        }
+        return classCounts == nodeJson.end() ||
+               std::all_of(classCounts->begin(), classCounts->end(), [](const nlohmann::json& count) {
+                   return count.is_number_unsigned();
+               });
+    }
+
+
+    std::unique_ptr<MappedModel> model;     // owns the arrays below: the mapped file, or the model built from JSON.
+    size_t count = 0;
+    uint32_t stringCount = 0;
+    const uint8_t* flags = nullptr;
+    const int32_t* attrIndex = nullptr;
+    const double* threshold = nullptr;
+    const uint32_t* attrValue = nullptr;    // string id of the value that leads to a node.
+    const uint32_t* label = nullptr;        // string id of a leaf's label.
+    const uint32_t* firstChild = nullptr;   // start of a node's children in `children`.
+    const uint32_t* childCount = nullptr;
+    const uint32_t* children = nullptr;
+    const uint32_t* firstClassCount = nullptr;  // start of a leaf's distribution in classLabel / classCount.
+    const uint32_t* classCountLength = nullptr;
+    const uint32_t* classLabel = nullptr;   // label id of each class in a leaf's distribution.
+    const uint32_t* classCount = nullptr;   // training rows of that class.
+    const uint32_t* stringOffset = nullptr;
+    const char* stringData = nullptr;
+
+    // use(): points the arrays at a validated model and takes ownership of it.
+    void use(std::unique_ptr<MappedModel> validated) {
+        model = std::move(validated);
+        count = model->nodeCount();
+        stringCount = model->header->stringCount;
+        flags = model->flags;
+        attrIndex = model->criteriaAttrIndex;
+        threshold = model->threshold;
+        attrValue = model->attrValue;
+        label = model->label;
+        firstChild = model->firstChild;
+        childCount = model->childCount;
+        children = model->children;
+        firstClassCount = model->firstClassCount;
+        classCountLength = model->classCountLength;
+        classLabel = model->classLabel;
+        classCount = model->classCount;
+        stringOffset = model->stringOffset;
+        stringData = model->stringData;
+    }
+
+    void clear() {
+        model.reset();
+        count = 0;
+        stringCount = 0;
+    }
+
+    std::string_view text(uint32_t stringId) const {
+        uint32_t begin = stringOffset[stringId];
+        return std::string_view(stringData + begin, stringOffset[stringId + 1] - begin);
+    }
+};
+
+/*
+`ForestPredictor` runs a random forest written by `decision --forest` (crop_forest.json): every tree is loaded into
+its own `Predictor`, and each tree's label ids are mapped to one forest-wide class numbering. `vote()` counts the
+trees that predict each class; large forests are split into chunks of trees evaluated as tasks on a TaskScheduler,
+each into its own counters. A row no tree can classify gets no votes. `likelihood()` averages the class distributions
+of the leaves a row reaches instead of counting their labels. Read-only once loaded.
+*/
+class ForestPredictor {
+public:
+    static constexpr int FAILED = Predictor::FAILED;
+    static const size_t treeGrain = 32;      // fewest trees evaluated as one task.
+
+    bool loadJson(const std::string& path) {
+        trees.clear();
+        treeClass.clear();
+        classes.clear();
+        std::ifstream fin(path);
+        if (!fin) {
+            return false;
+        }
+        nlohmann::json forestJson = nlohmann::json::parse(fin, nullptr, false);
+        if (!forestJson.is_object() || !forestJson.contains("trees") || !forestJson["trees"].is_array() ||
+            forestJson["trees"].empty()) {
+            return false;
+        }
+        std::unordered_map<std::string, int> classId;
+        for (const nlohmann::json& treeJson : forestJson["trees"]) {
+            trees.emplace_back();
+            if (!trees.back().loadJsonTree(treeJson)) {
+                trees.clear();
+                treeClass.clear();
+                classes.clear();
+                return false;
+            }
+            mapClasses(trees.size() - 1, trees.back().leafLabels(), classId);
+        }
+        // classes that only occur in leaf distributions come after every class a tree can predict.
+        for (size_t t = 0; t < trees.size(); t++) {
+            mapClasses(t, trees[t].distributionLabels(), classId);
+        }
+        return true;
+    }
+
+    bool isLoaded() const {
+        return !trees.empty();
+    }
+
+    size_t treeCount() const {
+        return trees.size();
+    }
+
+    size_t classCount() const {
+        return classes.size();
+    }
+
+    std::string_view labelName(int label) const {
+        return classes[label];
+    }
+
+    /*
+    vote(): fills `votes` (resized to classCount()) with the number of trees predicting each class for `row` and
+    returns the number of trees that reached a leaf. With a scheduler, forests of more than treeGrain trees are
+    evaluated in parallel.
+    */
+    template <typename Row>
+    size_t vote(const Row& row, size_t rowSize, std::vector<uint32_t>& votes, TaskScheduler* scheduler = nullptr) const {
+        votes.assign(classes.size(), 0);
+        if (scheduler == nullptr || trees.size() <= treeGrain) {
+            return voteRange(row, rowSize, 0, trees.size(), votes);
+        }
+        size_t chunkCount = (trees.size() + treeGrain - 1) / treeGrain;
+        std::vector<std::vector<uint32_t>> chunkVotes(chunkCount, std::vector<uint32_t>(classes.size(), 0));
+        std::vector<size_t> chunkReached(chunkCount, 0);
+        TaskGroup voting;
+        for (size_t chunk = 0; chunk < chunkCount; chunk++) {
+            scheduler->spawn(voting, [this, &row, rowSize, &chunkVotes, &chunkReached, chunk] {
+                size_t begin = chunk * treeGrain;
+                size_t end = std::min(trees.size(), begin + treeGrain);
+                chunkReached[chunk] = voteRange(row, rowSize, begin, end, chunkVotes[chunk]);
+            });
+        }
+        scheduler->wait(voting);
+        size_t reached = 0;
+        for (size_t chunk = 0; chunk < chunkCount; chunk++) {
+            reached += chunkReached[chunk];
+            for (size_t c = 0; c < classes.size(); c++) {
+                votes[c] += chunkVotes[chunk][c];
+            }
+        }
+        return reached;
+    }
+
+    // majority-vote class of `row` (ties go to the class seen first in the model file), or FAILED.
+    template <typename Row>
+    int predictLabel(const Row& row, size_t rowSize, std::vector<uint32_t>& votes,
+                     TaskScheduler* scheduler = nullptr) const {
+        if (vote(row, rowSize, votes, scheduler) == 0) {
+            return FAILED;
+        }
+        return (int)(std::max_element(votes.begin(), votes.end()) - votes.begin());
+    }
+
+    // share of the trees that reached a leaf voting for each class; all zero if none did.
+    template <typename Row>
+    std::vector<double> probabilities(const Row& row, size_t rowSize, TaskScheduler* scheduler = nullptr) const {
+        std::vector<uint32_t> votes;
+        size_t reached = vote(row, rowSize, votes, scheduler);
+        std::vector<double> probability(classes.size(), 0.0);
+        for (size_t c = 0; c < classes.size() && reached > 0; c++) {
+            probability[c] = (double)votes[c] / reached;
+        }
+        return probability;
+    }
+
+    /*
+    likelihood(): fills `likelihood` (resized to classCount()) with the class distribution of the leaves `row`
+    reaches, each leaf's distribution normalized and then averaged over the trees that reached one. Returns the
+    number of those trees; with none, every likelihood is zero.
+    */
+    template <typename Row>
+    size_t likelihood(const Row& row, size_t rowSize, std::vector<double>& likelihood) const {
+        likelihood.assign(classes.size(), 0.0);
+        size_t reached = 0;
+        for (size_t t = 0; t < trees.size(); t++) {
+            int leaf = trees[t].predictLeaf(row, rowSize);
+            if (leaf == FAILED) {
+                continue;
+            }
+            Predictor::ClassCounts counts = trees[t].leafClassCounts(leaf);
+            double rows = 0.0;
+            for (size_t i = 0; i < counts.size; i++) {
+                rows += counts.count[i];
+            }
+            for (size_t i = 0; i < counts.size && rows > 0; i++) {
+                likelihood[treeClass[t][counts.label[i]]] += counts.count[i] / rows;
+            }
+            reached++;
+        }
+        for (size_t c = 0; c < classes.size() && reached > 0; c++) {
+            likelihood[c] /= reached;
+        }
+        return reached;
+    }
+
+    // predicted label text, or "Prediction failed".
+    std::string_view predict(const std::vector<std::string>& row, TaskScheduler* scheduler = nullptr) const {
+        std::vector<uint32_t> votes;
+        int label = predictLabel(row, row.size(), votes, scheduler);
+        return label == FAILED ? std::string_view("Prediction failed") : std::string_view(classes[label]);
+    }
+
+private:
+    std::vector<Predictor> trees;
+    std::vector<std::vector<int>> treeClass;     // treeClass[t][tree label id] = forest class id.
+    std::vector<std::string> classes;            // forest class names, in order of first appearance.
+
+    void mapClasses(size_t t, const std::vector<int>& labels, std::unordered_map<std::string, int>& classId) {
+        if (treeClass.size() <= t) {
+            treeClass.resize(t + 1);
+        }
+        std::vector<int>& mapping = treeClass[t];
+        for (int label : labels) {
+            std::string name(trees[t].labelName(label));
+            auto found = classId.emplace(name, (int)classes.size());
+            if (found.second) {
+                classes.push_back(name);
+            }
+            if (mapping.size() <= (size_t)label) {
+                mapping.resize(label + 1, FAILED);
+            }
+            mapping[label] = found.first->second;
+        }
+    }
+
+    template <typename Row>
+    size_t voteRange(const Row& row, size_t rowSize, size_t begin, size_t end, std::vector<uint32_t>& votes) const {
+        size_t reached = 0;
+        for (size_t t = begin; t < end; t++) {
+            int label = trees[t].predictLabel(row, rowSize);
+            if (label != FAILED) {
+                votes[treeClass[t][label]]++;
+                reached++;
+            }
+        }
+        return reached;
+    }
+};
+
+#endif
@@ -0,0 +1,646 @@
+#ifndef PRICE_STATS_H
+#define PRICE_STATS_H
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "mapped_file.h"
+#include "model_format.h"
+
+/*
+Per-crop profit statistics over the historical reports in `price_avg.csv` (`crop_name,profit` rows).
+
+`PriceStats` summarizes any number of profits in constant space: count, mean and variance (Welford's running
+update), minimum, maximum and a `QuantileSketch` for percentiles. Two summaries merge exactly (means and variances
+with Chan's pairwise formula), so `PriceAggregator` splits its input into byte ranges, aggregates each range on its
+own thread in a single pass over the mapped file and merges the per-thread results.
+
+`QuantileSketch` is a DDSketch: profits are counted in logarithmic buckets whose bounds grow by a factor of
+gamma = (1 + a) / (1 - a), with separate buckets for negative profits (losses) and a count for zeros. Any quantile it
+returns is within relative error `a` (1% by default) of the true one, its size only depends on the range of the
+values (a few hundred buckets for profits between 1 and 10^6), and merging two sketches adds their bucket counts.
+
+The aggregates are persisted as a snapshot, a checksummed binary file laid out like the model file (see
+model_format.h) so it is mapped and used in place:
+
+    PriceSummary summary[cropCount]         statistics of each crop, sorted by name
+    uint32_t     slot[slotCount]            open-addressing hash table of the names: 1 + crop index, 0 if empty
+    PriceBin     bin[binTotal]              sketch buckets, each crop's contiguous
+    PriceInput   input[inputCount]          the files aggregated, in order: absolute path, size and last write time
+    char         stringData[stringBytes]    crop names and input paths, not NUL-terminated
+
+`PriceSnapshot::find()` hashes a name and probes the table, so a lookup costs the same for 22 crops or 22000.
+`PriceSnapshot::matches()` compares the recorded inputs with the files on disk, so a snapshot built from other files,
+or from an earlier version of the same ones, is never taken for current.
+*/
+
+const char PRICE_SNAPSHOT_MAGIC[4] = {'C', 'R', 'P', 'S'};
+const uint32_t PRICE_SNAPSHOT_VERSION = 2;             // 2 records the input files.
+const double PRICE_SKETCH_ACCURACY = 0.01;
+const double PRICE_SKETCH_MIN_VALUE = 1e-9;            // smaller magnitudes count as zero.
+
+class QuantileSketch {
+public:
+    explicit QuantileSketch(double relativeAccuracy = PRICE_SKETCH_ACCURACY)
+        : relativeAccuracy(relativeAccuracy), gamma((1.0 + relativeAccuracy) / (1.0 - relativeAccuracy)),
+          logGamma(std::log(gamma)) {
+    }
+
+    void add(double value, uint64_t count = 1) {
+        if (value > PRICE_SKETCH_MIN_VALUE) {
+            positive.add(index(value), count);
+        } else if (value < -PRICE_SKETCH_MIN_VALUE) {
+            negative.add(index(-value), count);
+        } else {
+            zeroCount += count;
+        }
+    }
+
+    // merge(): adds the counts of a sketch with the same accuracy.
+    void merge(const QuantileSketch& other) {
+        positive.merge(other.positive);
+        negative.merge(other.negative);
+        zeroCount += other.zeroCount;
+    }
+
+    uint64_t count() const {
+        return positive.total + negative.total + zeroCount;
+    }
+
+    // quantile(): the value of rank q * (count - 1) in sorted order, 0 <= q <= 1; NaN if the sketch is empty.
+    double quantile(double q) const {
+        uint64_t total = count();
+        if (total == 0) {
+            return NAN;
+        }
+        double rank = std::clamp(q, 0.0, 1.0) * (double)(total - 1);
+        uint64_t seen = 0;
+        for (size_t i = negative.counts.size(); i-- > 0;) {          // largest losses first.
+            seen += negative.counts[i];
+            if (seen > rank) {
+                return -value(negative.offset + (int32_t)i);
+            }
+        }
+        seen += zeroCount;
+        if (seen > rank) {
+            return 0.0;
+        }
+        for (size_t i = 0; i < positive.counts.size(); i++) {
+            seen += positive.counts[i];
+            if (seen > rank) {
+                return value(positive.offset + (int32_t)i);
+            }
+        }
+        return value(positive.offset + (int32_t)positive.counts.size() - 1);
+    }
+
+    double accuracy() const {
+        return relativeAccuracy;
+    }
+
+    // visit(): every non-empty bucket, as (index, negative, count); zeros() are not in a bucket.
+    template <typename Visit>
+    void visit(Visit visitBucket) const {
+        for (int sign = 0; sign < 2; sign++) {
+            const Store& store = sign == 0 ? positive : negative;
+            for (size_t i = 0; i < store.counts.size(); i++) {
+                if (store.counts[i] > 0) {
+                    visitBucket(store.offset + (int32_t)i, sign == 1, store.counts[i]);
+                }
+            }
+        }
+    }
+
+    uint64_t zeros() const {
+        return zeroCount;
+    }
+
+    // addBucket(): restores a bucket reported by visit().
+    void addBucket(int32_t bucket, bool isNegative, uint64_t count) {
+        (isNegative ? negative : positive).add(bucket, count);
+    }
+
+    void addZeros(uint64_t count) {
+        zeroCount += count;
+    }
+
+    int32_t index(double magnitude) const {
+        return (int32_t)std::ceil(std::log(magnitude) / logGamma);
+    }
+
+    // value(): the representative magnitude of a bucket, within `relativeAccuracy` of everything in it.
+    double value(int32_t bucket) const {
+        return 2.0 * std::pow(gamma, bucket) / (gamma + 1.0);
+    }
+
+private:
+    // bucket counts for indices [offset, offset + counts.size()), grown as needed.
+    struct Store {
+        int32_t offset = 0;
+        std::vector<uint64_t> counts;
+        uint64_t total = 0;
+
+        void add(int32_t bucket, uint64_t count) {
+            if (counts.empty()) {
+                offset = bucket;
+                counts.assign(1, 0);
+            } else if (bucket < offset) {
+                counts.insert(counts.begin(), (size_t)(offset - bucket), 0);
+                offset = bucket;
+            } else if ((size_t)(bucket - offset) >= counts.size()) {
+                counts.resize((size_t)(bucket - offset) + 1, 0);
+            }
+            counts[(size_t)(bucket - offset)] += count;
+            total += count;
+        }
+
+        void merge(const Store& other) {
+            for (size_t i = 0; i < other.counts.size(); i++) {
+                if (other.counts[i] > 0) {
+                    add(other.offset + (int32_t)i, other.counts[i]);
+                }
+            }
+        }
+    };
+
+    double relativeAccuracy;
+    double gamma;
+    double logGamma;
+    Store positive;
+    Store negative;                 // magnitudes of negative values.
+    uint64_t zeroCount = 0;
+};
+
+struct PriceStats {
+    uint64_t count = 0;
+    double mean = 0.0;
+    double m2 = 0.0;                // sum of squared differences from the mean.
+    double minimum = INFINITY;
+    double maximum = -INFINITY;
+    QuantileSketch sketch;
+
+    void add(double profit) {
+        count++;
+        double delta = profit - mean;
+        mean += delta / count;
+        m2 += delta * (profit - mean);
+        minimum = std::min(minimum, profit);
+        maximum = std::max(maximum, profit);
+        sketch.add(profit);
+    }
+
+    void merge(const PriceStats& other) {
+        if (other.count == 0) {
+            return;
+        }
+        uint64_t total = count + other.count;
+        double delta = other.mean - mean;
+        mean += delta * other.count / total;
+        m2 += other.m2 + delta * delta * ((double)count * other.count / total);
+        count = total;
+        minimum = std::min(minimum, other.minimum);
+        maximum = std::max(maximum, other.maximum);
+        sketch.merge(other.sketch);
+    }
+
+    // variance(): the sample variance; 0 for fewer than two profits.
+    double variance() const {
+        return count > 1 ? m2 / (count - 1) : 0.0;
+    }
+
+    double quantile(double q) const {
+        return std::clamp(sketch.quantile(q), minimum, maximum);
+    }
+};
+
+// the identity of an input file: a snapshot is current only while all of its inputs still have the same one.
+struct PriceInputState {
+    std::string path;               // absolute.
+    uint64_t size = 0;
+    int64_t modified = 0;           // last write time, in file_time_type ticks.
+};
+
+// priceInputState(): the state of the file at `path`; false if it cannot be read.
+inline bool priceInputState(const std::string& path, PriceInputState& state) {
+    std::error_code error;
+    state.path = std::filesystem::absolute(path, error).lexically_normal().string();
+    if (error) {
+        return false;
+    }
+    state.size = std::filesystem::file_size(path, error);
+    if (error) {
+        return false;
+    }
+    std::filesystem::file_time_type modified = std::filesystem::last_write_time(path, error);
+    state.modified = (int64_t)modified.time_since_epoch().count();
+    return !error;
+}
+
+/*
+`PriceAggregator` builds the PriceStats of every crop from one or more CSV files. Rows that do not parse (headers,
+blank lines, non-numeric profits) are skipped and counted. The state of every file added is recorded in the snapshot.
+*/
+class PriceAggregator {
+public:
+    // addFile(): aggregates `path` with `threads` threads (at least 1); false if the file cannot be read.
+    bool addFile(const std::string& path, unsigned threads = 1) {
+        PriceInputState state;      // taken before reading, so a file changed meanwhile makes the snapshot stale.
+        MappedFile file;
+        if (!priceInputState(path, state) || !file.open(path)) {
+            return false;
+        }
+        inputs.push_back(state);
+        std::string_view data = file.view();
+        threads = std::max(1u, threads);
+        std::vector<size_t> bounds = {0};
+        for (unsigned t = 1; t < threads; t++) {
+            size_t bound = std::max(bounds.back(), data.size() * t / threads);
+            size_t newline = data.find('\n', bound == 0 ? 0 : bound - 1);
+            bounds.push_back(newline == std::string_view::npos ? data.size() : newline + 1);
+        }
+        bounds.push_back(data.size());
+
+        std::vector<Shard> shards(threads);
+        std::vector<std::thread> workers;
+        for (unsigned t = 1; t < threads; t++) {
+            std::string_view range = data.substr(bounds[t], bounds[t + 1] - bounds[t]);
+            workers.emplace_back([&shards, t, range] { aggregate(range, shards[t]); });
+        }
+        aggregate(data.substr(bounds[0], bounds[1] - bounds[0]), shards[0]);
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        for (Shard& shard : shards) {
+            for (auto& entry : shard.crops) {
+                stats[std::string(entry.first)].merge(entry.second);
+            }
+            rows += shard.rows;
+            skipped += shard.skipped;
+        }
+        return true;
+    }
+
+    const std::map<std::string, PriceStats>& crops() const {
+        return stats;
+    }
+
+    uint64_t rowCount() const {
+        return rows;
+    }
+
+    uint64_t skippedCount() const {
+        return skipped;
+    }
+
+    bool writeSnapshot(const std::string& path) const;
+
+private:
+    // the results of one thread; names point into the mapped file.
+    struct Shard {
+        std::unordered_map<std::string_view, PriceStats> crops;
+        uint64_t rows = 0;
+        uint64_t skipped = 0;
+    };
+
+    std::map<std::string, PriceStats> stats;
+    std::vector<PriceInputState> inputs;
+    uint64_t rows = 0;
+    uint64_t skipped = 0;
+
+    static void aggregate(std::string_view data, Shard& shard) {
+        std::string_view lastName;
+        PriceStats* last = nullptr;         // rows of a crop often come in runs.
+        size_t position = 0;
+        while (position < data.size()) {
+            size_t end = data.find('\n', position);
+            if (end == std::string_view::npos) {
+                end = data.size();
+            }
+            std::string_view line = data.substr(position, end - position);
+            position = end + 1;
+            if (!line.empty() && line.back() == '\r') {
+                line.remove_suffix(1);
+            }
+            size_t comma = line.find(',');
+            double profit;
+            if (comma == std::string_view::npos || comma == 0) {
+                shard.skipped += !line.empty();
+                continue;
+            }
+            const char* lineEnd = line.data() + line.size();
+            std::from_chars_result result = std::from_chars(line.data() + comma + 1, lineEnd, profit);
+            if (result.ec != std::errc() || result.ptr != lineEnd || !std::isfinite(profit)) {
+                shard.skipped++;
+                continue;
+            }
+            std::string_view name = line.substr(0, comma);
+            if (last == nullptr || name != lastName) {
+                last = &shard.crops[name];
+                lastName = name;
+            }
+            last->add(profit);
+            shard.rows++;
+        }
+    }
+};
+
+struct PriceSnapshotHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t cropCount;
+    uint32_t slotCount;
+    uint32_t binTotal;
+    uint32_t stringBytes;
+    uint32_t inputCount;
+    uint32_t checksum;
+    uint32_t reserved;
+    double relativeAccuracy;
+    uint64_t fileSize;
+};
+
+struct PriceSummary {
+    uint64_t count;
+    double mean;
+    double variance;
+    double minimum;
+    double maximum;
+    uint64_t zeroCount;             // sketch profits counted as zero.
+    uint32_t nameOffset;
+    uint32_t nameLength;
+    uint32_t firstBin;
+    uint32_t binCount;
+};
+
+struct PriceBin {
+    int32_t index;
+    uint32_t negative;
+    uint64_t count;
+};
+
+struct PriceInput {
+    uint64_t size;
+    int64_t modified;
+    uint32_t pathOffset;
+    uint32_t pathLength;
+};
+
+// FNV-1a, the hash of the snapshot's name table.
+inline uint32_t priceNameHash(std::string_view name) {
+    uint32_t hash = 2166136261u;
+    for (char c : name) {
+        hash = (hash ^ (uint8_t)c) * 16777619u;
+    }
+    return hash;
+}
+
+inline bool PriceAggregator::writeSnapshot(const std::string& path) const {
+    std::vector<PriceSummary> summaries;
+    std::vector<PriceBin> bins;
+    std::vector<char> stringData;
+    for (const auto& entry : stats) {
+        const PriceStats& crop = entry.second;
+        PriceSummary summary{crop.count, crop.mean, crop.variance(), crop.minimum, crop.maximum, crop.sketch.zeros(),
+                             (uint32_t)stringData.size(), (uint32_t)entry.first.size(), (uint32_t)bins.size(), 0};
+        stringData.insert(stringData.end(), entry.first.begin(), entry.first.end());
+        crop.sketch.visit([&bins](int32_t bucket, bool negative, uint64_t count) {
+            bins.push_back(PriceBin{bucket, negative ? 1u : 0u, count});
+        });
+        summary.binCount = (uint32_t)bins.size() - summary.firstBin;
+        summaries.push_back(summary);
+    }
+    std::vector<PriceInput> inputFiles;
+    for (const PriceInputState& input : inputs) {
+        inputFiles.push_back(PriceInput{input.size, input.modified, (uint32_t)stringData.size(),
+                                        (uint32_t)input.path.size()});
+        stringData.insert(stringData.end(), input.path.begin(), input.path.end());
+    }
+    uint32_t slotCount = 4;
+    while (slotCount < 2 * summaries.size()) {
+        slotCount <<= 1;
+    }
+    std::vector<uint32_t> slots(slotCount, 0);
+    for (uint32_t c = 0; c < summaries.size(); c++) {
+        std::string_view name(stringData.data() + summaries[c].nameOffset, summaries[c].nameLength);
+        uint32_t slot = priceNameHash(name) & (slotCount - 1);
+        while (slots[slot] != 0) {
+            slot = (slot + 1) & (slotCount - 1);
+        }
+        slots[slot] = c + 1;
+    }
+
+    std::vector<char> body;
+    auto append = [&body](const void* data, size_t size) {
+        body.resize(modelAlign(body.size()));
+        body.insert(body.end(), static_cast<const char*>(data), static_cast<const char*>(data) + size);
+    };
+    append(summaries.data(), summaries.size() * sizeof(PriceSummary));
+    append(slots.data(), slots.size() * sizeof(uint32_t));
+    append(bins.data(), bins.size() * sizeof(PriceBin));
+    append(inputFiles.data(), inputFiles.size() * sizeof(PriceInput));
+    append(stringData.data(), stringData.size());
+
+    PriceSnapshotHeader header;
+    memcpy(header.magic, PRICE_SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = PRICE_SNAPSHOT_VERSION;
+    header.headerSize = sizeof(PriceSnapshotHeader);
+    header.cropCount = (uint32_t)summaries.size();
+    header.slotCount = slotCount;
+    header.binTotal = (uint32_t)bins.size();
+    header.stringBytes = (uint32_t)stringData.size();
+    header.inputCount = (uint32_t)inputFiles.size();
+    header.reserved = 0;
+    header.checksum = modelChecksum(body.data(), body.size());
+    header.relativeAccuracy = PRICE_SKETCH_ACCURACY;
+    header.fileSize = sizeof(PriceSnapshotHeader) + body.size();
+
+    // write to a temporary file and rename it, so a reader never maps a half-written snapshot.
+    std::string temporaryPath = path + ".tmp";
+    std::ofstream fout(temporaryPath, std::ios::binary | std::ios::trunc);
+    fout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    fout.write(body.data(), body.size());
+    fout.close();
+    if (!fout) {
+        return false;
+    }
+#ifdef _WIN32
+    std::remove(path.c_str());      // Windows' rename() does not replace an existing file.
+#endif
+    return std::rename(temporaryPath.c_str(), path.c_str()) == 0;
+}
+
+/*
+`PriceSnapshot` maps a snapshot file read-only. `open()` returns false if the file is missing, truncated, from
+another format version or fails its checksum; `matches()` then tells whether it is current for a list of inputs.
+*/
+class PriceSnapshot {
+public:
+    PriceSnapshot() = default;
+    PriceSnapshot(const PriceSnapshot&) = delete;
+    PriceSnapshot& operator=(const PriceSnapshot&) = delete;
+
+    bool open(const std::string& path) {
+        close();
+        if (!file.open(path) || file.size() < sizeof(PriceSnapshotHeader) || !validate()) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+        file.close();
+        header = nullptr;
+    }
+
+    bool isOpen() const {
+        return header != nullptr;
+    }
+
+    uint32_t cropCount() const {
+        return header != nullptr ? header->cropCount : 0;
+    }
+
+    const PriceSummary& summary(uint32_t crop) const {
+        return summaries[crop];
+    }
+
+    std::string_view name(uint32_t crop) const {
+        return std::string_view(stringData + summaries[crop].nameOffset, summaries[crop].nameLength);
+    }
+
+    // find(): the crop called `name`, or nullptr.
+    const PriceSummary* find(std::string_view name) const {
+        int64_t crop = indexOf(name);
+        return crop >= 0 ? &summaries[crop] : nullptr;
+    }
+
+    // indexOf(): the index of the crop called `name`, or -1.
+    int64_t indexOf(std::string_view name) const {
+        if (header == nullptr) {
+            return -1;
+        }
+        uint32_t mask = header->slotCount - 1;
+        for (uint32_t slot = priceNameHash(name) & mask; slots[slot] != 0; slot = (slot + 1) & mask) {
+            if (this->name(slots[slot] - 1) == name) {
+                return slots[slot] - 1;
+            }
+        }
+        return -1;
+    }
+
+    // matches(): true if the snapshot was built from exactly `inputs`, in order, and none of them has changed since.
+    bool matches(const std::vector<std::string>& inputs) const {
+        if (header == nullptr || inputs.size() != header->inputCount) {
+            return false;
+        }
+        for (size_t i = 0; i < inputs.size(); i++) {
+            PriceInputState state;
+            std::string_view recorded(stringData + inputFiles[i].pathOffset, inputFiles[i].pathLength);
+            if (!priceInputState(inputs[i], state) || state.path != recorded || state.size != inputFiles[i].size ||
+                state.modified != inputFiles[i].modified) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // quantile(): the q-quantile of a crop's profits, from its sketch buckets.
+    double quantile(const PriceSummary& crop, double q) const {
+        return std::clamp(sketch(crop).quantile(q), crop.minimum, crop.maximum);
+    }
+
+    QuantileSketch sketch(const PriceSummary& crop) const {
+        QuantileSketch result(header->relativeAccuracy);
+        for (uint32_t b = crop.firstBin; b < crop.firstBin + crop.binCount; b++) {
+            result.addBucket(bins[b].index, bins[b].negative != 0, bins[b].count);
+        }
+        result.addZeros(crop.zeroCount);
+        return result;
+    }
+
+private:
+    MappedFile file;
+    const PriceSnapshotHeader* header = nullptr;
+    const PriceSummary* summaries = nullptr;
+    const uint32_t* slots = nullptr;
+    const PriceBin* bins = nullptr;
+    const PriceInput* inputFiles = nullptr;
+    const char* stringData = nullptr;
+
+    bool validate() {
+        const PriceSnapshotHeader* candidate = reinterpret_cast<const PriceSnapshotHeader*>(file.data());
+        if (memcmp(candidate->magic, PRICE_SNAPSHOT_MAGIC, sizeof(candidate->magic)) != 0 ||
+            candidate->version != PRICE_SNAPSHOT_VERSION || candidate->headerSize != sizeof(PriceSnapshotHeader) ||
+            candidate->fileSize != file.size() || candidate->slotCount == 0 ||
+            (candidate->slotCount & (candidate->slotCount - 1)) != 0 || candidate->slotCount <= candidate->cropCount) {
+            return false;
+        }
+        const char* body = file.data() + sizeof(PriceSnapshotHeader);
+        size_t bodySize = file.size() - sizeof(PriceSnapshotHeader);
+        if (modelChecksum(body, bodySize) != candidate->checksum) {
+            return false;
+        }
+        size_t offset = 0;
+        summaries = section<PriceSummary>(body, offset, candidate->cropCount);
+        slots = section<uint32_t>(body, offset, candidate->slotCount);
+        bins = section<PriceBin>(body, offset, candidate->binTotal);
+        inputFiles = section<PriceInput>(body, offset, candidate->inputCount);
+        stringData = section<char>(body, offset, candidate->stringBytes);
+        if (offset != bodySize) {
+            return false;
+        }
+        for (uint32_t i = 0; i < candidate->inputCount; i++) {
+            if ((uint64_t)inputFiles[i].pathOffset + inputFiles[i].pathLength > candidate->stringBytes) {
+                return false;
+            }
+        }
+        header = candidate;
+        return true;
+    }
+
+    template <typename T>
+    static const T* section(const char* body, size_t& offset, size_t count) {
+        offset = modelAlign(offset);
+        const T* start = reinterpret_cast<const T*>(body + offset);
+        offset += count * sizeof(T);
+        return start;
+    }
+};
+
+/*
+loadOrBuildPriceSnapshot(): opens the snapshot at `path` if it was built from `inputs`; otherwise aggregates the inputs
+with `threads` threads, rewrites the snapshot and opens that. False if an input cannot be read. If the snapshot cannot
+be written, `snapshot` is left closed and the statistics are in `aggregator` instead.
+*/
+inline bool loadOrBuildPriceSnapshot(const std::vector<std::string>& inputs, const std::string& path, unsigned threads,
+                                     PriceSnapshot& snapshot, PriceAggregator& aggregator) {
+    if (snapshot.open(path) && snapshot.matches(inputs)) {
+        return true;
+    }
+    snapshot.close();
+    for (const std::string& input : inputs) {
+        if (!aggregator.addFile(input, threads)) {
+            std::cerr << "Cannot read " << input << "\n";
+            return false;
+        }
+    }
+    if (!aggregator.writeSnapshot(path) || !snapshot.open(path)) {
+        std::cerr << "Warning: cannot write " << path << "\n";
+    }
+    return true;
+}
+
+#endif
@@ -1,49 +1,476 @@
 #include <iostream>
 #include <fstream>
 #include <string>
-#include <map>
+#include <string_view>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <list>
+#include <memory>
+#include <csignal>
+#include <functional>
+#include <filesystem>
+#include "price_stats.h"
 
-// Global map to store crop names and their average prices
+#ifndef _WIN32
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+const char* const PRICE_CSV = "price_avg.csv";
+const char* const PRICE_SNAPSHOT = "price_stats.bin";
+const char* const PROFIT_SOCKET = "crop_profit.sock";
+
+// Percentiles printed by --stats.
+const double REPORTED_PERCENTILES[] = {0.10, 0.25, 0.50, 0.75, 0.90};
+
+// Function to build the price statistics
 /*
-A map that associates crop names with their average prices. The map is populated from a CSV file.
+Aggregates every row of the input files in one pass (split across `threads` threads) and writes the snapshot. The
+statistics are also left in `aggregator`, so a caller can use them even if the snapshot could not be written.
 */
-std::map<std::string, double> price_avg_map;
+bool build_price_stats(const std::vector<std::string>& inputs, const std::string& snapshotPath, unsigned threads,
+                       PriceAggregator& aggregator) {
+    for (const std::string& input : inputs) {
+        if (!aggregator.addFile(input, threads)) {
+            std::cerr << "Cannot read " << input << std::endl;
+            return false;
+        }
+    }
+    if (!aggregator.writeSnapshot(snapshotPath)) {
+        std::cerr << "Warning: cannot write " << snapshotPath << std::endl;
+    }
+    return true;
+}
 
-// Function to load the average prices of crops into the map
+// Function to print the profit of a crop
 /*
-Reads data from "price_avg.csv" file and populates the price_avg_map with crop names and their corresponding average prices.
+Prints `crop: mean profit`, and with `stats` the number of reports, standard deviation, range and percentiles.
 */
-void load_price_avg_map() {
-    std::ifstream file("price_avg.csv");
-    std::string line, crop, avg;
-    getline(file, line); // Skip header
-    while (getline(file, line)) {
-        size_t comma = line.find(',');
-        crop = line.substr(0, comma);
-        avg = line.substr(comma + 1);
-        price_avg_map[crop] = std::stod(avg);
-    }
-    file.close();
+void print_profit(const std::string& crop, uint64_t count, double mean, double variance, double minimum,
+                  double maximum, const std::function<double(double)>& quantile, bool stats) {
+    std::cout << crop << ": " << mean << std::endl;
+    if (!stats) {
+        return;
+    }
+    std::cout << "reports: " << count << "\nstddev: " << std::sqrt(variance) << "\nmin: " << minimum << std::endl;
+    for (double q : REPORTED_PERCENTILES) {
+        std::cout << "p" << (int)std::lround(q * 100) << ": " << quantile(q) << std::endl;
+    }
+    std::cout << "max: " << maximum << std::endl;
 }
+
+// Function to quote a string for JSON
+std::string json_string(std::string_view text) {
+    std::string quoted = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+            quoted += c;
+        } else if ((unsigned char)c < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned char)c);
+            quoted += escaped;
+        } else {
+            quoted += c;
+        }
+    }
+    return quoted + "\"";
+}
+
+/*
+`PriceTable` is the resident form of the price statistics: the mapped snapshot, and the JSON answer for every crop,
+rendered once when the table is loaded. Answering a request then costs one hash lookup and one copy per crop name.
+
+A request is one line of crop names separated by commas or spaces, or `*` for every crop. The answer is one line
+holding a JSON object with an entry per name requested: the crop's statistics, or null for an unknown crop.
+*/
+class PriceTable {
+public:
+    // load(): maps the snapshot, rebuilding it first if it is missing or was not built from the current inputs.
+    bool load(const std::vector<std::string>& inputs, const std::string& snapshotPath, unsigned threads) {
+        PriceAggregator aggregator;
+        if (!loadOrBuildPriceSnapshot(inputs, snapshotPath, threads, snapshot, aggregator) || !snapshot.isOpen()) {
+            return false;
+        }
+        answers.clear();
+        for (uint32_t crop = 0; crop < snapshot.cropCount(); crop++) {
+            const PriceSummary& summary = snapshot.summary(crop);
+            QuantileSketch sketch = snapshot.sketch(summary);
+            char numbers[512];
+            int length = std::snprintf(numbers, sizeof(numbers),
+                                       "{\"mean\": %.10g, \"reports\": %llu, \"stddev\": %.10g, \"min\": %.10g",
+                                       summary.mean, (unsigned long long)summary.count, std::sqrt(summary.variance),
+                                       summary.minimum);
+            for (double q : REPORTED_PERCENTILES) {
+                double value = std::clamp(sketch.quantile(q), summary.minimum, summary.maximum);
+                length += std::snprintf(numbers + length, sizeof(numbers) - length, ", \"p%d\": %.10g",
+                                        (int)std::lround(q * 100), value);
+            }
+            std::snprintf(numbers + length, sizeof(numbers) - length, ", \"max\": %.10g}", summary.maximum);
+            answers.push_back(json_string(snapshot.name(crop)) + ": " + numbers);
+        }
+        return true;
+    }
+
+    uint32_t cropCount() const {
+        return snapshot.cropCount();
+    }
+
+    // answer(): appends the answer to one request line to `response`.
+    void answer(std::string_view request, std::string& response) const {
+        response += '{';
+        bool first = true;
+        size_t position = 0;
+        while (position < request.size()) {
+            size_t start = request.find_first_not_of(", \t\r", position);
+            if (start == std::string_view::npos) {
+                break;
+            }
+            size_t end = std::min(request.find_first_of(", \t\r", start), request.size());
+            std::string_view name = request.substr(start, end - start);
+            position = end;
+            if (name == "*") {
+                for (const std::string& crop : answers) {
+                    response += first ? "" : ", ";
+                    response += crop;
+                    first = false;
+                }
+                continue;
+            }
+            response += first ? "" : ", ";
+            first = false;
+            int64_t crop = snapshot.indexOf(name);
+            if (crop >= 0) {
+                response += answers[crop];
+            } else {
+                response += json_string(name) + ": null";
+            }
+        }
+        response += "}\n";
+    }
+
+private:
+    PriceSnapshot snapshot;
+    std::vector<std::string> answers;       // `"name": {statistics}`, by crop index.
+};
+
+/*
+`ProfitServer` keeps a PriceTable resident and answers requests over a Unix domain socket, one answer line per
+request line, in order. Every connection is served on its own thread; on shutdown the open connections are shut
+down and their threads joined before run() returns. A watcher thread polls the input files once a second and, when
+one changes, rebuilds the snapshot, loads it into a new table and swaps that in; requests already running finish
+on the table they started with.
+*/
+class ProfitServer {
+public:
+    ProfitServer(const std::string& socketPath, std::shared_ptr<const PriceTable> table,
+                 const std::vector<std::string>& inputs, const std::string& snapshotPath, unsigned threads)
+        : socketPath(socketPath), inputs(inputs), snapshotPath(snapshotPath), threads(threads),
+          current(std::move(table)) {}
+
+    int run() {
+#ifdef _WIN32
+        std::cerr << "--serve needs Unix domain sockets, which this build does not support\n";
+        return 1;
+#else
+        int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (listener < 0 || socketPath.size() >= sizeof(address.sun_path)) {
+            std::cerr << "socket " << socketPath << " could not be created\n";
+            return 1;
+        }
+        socketPath.copy(address.sun_path, socketPath.size());
+        unlink(socketPath.c_str());
+        if (::bind(listener, (sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 64) != 0) {
+            std::cerr << "socket " << socketPath << " could not be bound\n";
+            close(listener);
+            return 1;
+        }
+        std::signal(SIGPIPE, SIG_IGN);
+        std::signal(SIGINT, requestStop);
+        std::signal(SIGTERM, requestStop);
+        std::cerr << "Serving profits of " << current->cropCount() << " crops on " << socketPath << "\n";
+
+        std::thread watcher(&ProfitServer::watchInputs, this);
+        while (!stopRequested) {
+            reapClients(false);
+            pollfd waiting{listener, POLLIN, 0};
+            if (poll(&waiting, 1, 500) <= 0) {
+                continue;
+            }
+            int client = accept(listener, nullptr, nullptr);
+            if (client >= 0) {
+                clients.emplace_back();
+                clients.back().socket = client;
+                clients.back().worker = std::thread(&ProfitServer::serveClient, this, std::ref(clients.back()));
+            }
+        }
+        reapClients(true);
+        watcher.join();
+        close(listener);
+        unlink(socketPath.c_str());
+        return 0;
+#endif
+    }
+
+private:
+    // a connection and the thread serving it; the socket is closed by the accept loop once the thread is joined.
+    struct Client {
+        int socket = -1;
+        std::thread worker;
+        std::atomic<bool> finished{false};
+    };
+
+    std::string socketPath;
+    std::vector<std::string> inputs;
+    std::string snapshotPath;
+    unsigned threads;
+    std::mutex tableMutex;
+    std::shared_ptr<const PriceTable> current;      // swapped whole on reload, under tableMutex.
+    std::list<Client> clients;                      // only touched by the accept loop in run().
+    inline static volatile std::sig_atomic_t stopRequested = 0;
+
+    static const size_t MAX_LINE_BYTES = 1 << 16;
+
+    static void requestStop(int) {
+        stopRequested = 1;
+    }
+
+    std::shared_ptr<const PriceTable> table() {
+        std::lock_guard<std::mutex> lock(tableMutex);
+        return current;
+    }
+
+    std::vector<std::filesystem::file_time_type> inputTimes() const {
+        std::vector<std::filesystem::file_time_type> times;
+        for (const std::string& input : inputs) {
+            std::error_code error;
+            std::filesystem::file_time_type time = std::filesystem::last_write_time(input, error);
+            times.push_back(error ? std::filesystem::file_time_type::min() : time);
+        }
+        return times;
+    }
+
+    // watchInputs(): reloads the table whenever an input file changes.
+    void watchInputs() {
+        std::vector<std::filesystem::file_time_type> times = inputTimes();
+        while (!stopRequested) {
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+            std::vector<std::filesystem::file_time_type> newTimes = inputTimes();
+            if (newTimes == times) {
+                continue;
+            }
+            std::shared_ptr<PriceTable> reloaded = std::make_shared<PriceTable>();
+            if (!reloaded->load(inputs, snapshotPath, threads)) {
+                std::cerr << "Prices changed but could not be loaded; keeping the current table\n";
+                continue;       // retried on the next poll, e.g. once the file has been written.
+            }
+            times = newTimes;
+            {
+                std::lock_guard<std::mutex> lock(tableMutex);
+                current = reloaded;
+            }
+            std::cerr << "Reloaded prices (" << reloaded->cropCount() << " crops)\n";
+        }
+    }
+
+#ifndef _WIN32
+    /*
+    reapClients(): joins the threads of the connections that have ended and closes their sockets. With `all`, first
+    shuts down every open connection, which ends its thread's recv(), and then reaps them all.
+    */
+    void reapClients(bool all) {
+        for (auto client = clients.begin(); client != clients.end();) {
+            if (all) {
+                shutdown(client->socket, SHUT_RDWR);
+            } else if (!client->finished) {
+                ++client;
+                continue;
+            }
+            client->worker.join();
+            close(client->socket);
+            client = clients.erase(client);
+        }
+    }
+
+    void serveClient(Client& connection) {
+        int client = connection.socket;
+        std::string pending;
+        std::string response;
+        char buffer[4096];
+        while (true) {
+            ssize_t received = recv(client, buffer, sizeof(buffer), 0);
+            if (received <= 0) {
+                break;
+            }
+            pending.append(buffer, received);
+
+            response.clear();
+            size_t start = 0;
+            size_t newline;
+            std::shared_ptr<const PriceTable> prices = table();
+            while ((newline = pending.find('\n', start)) != std::string::npos) {
+                prices->answer(std::string_view(pending.data() + start, newline - start), response);
+                start = newline + 1;
+            }
+            pending.erase(0, start);
+            if (pending.size() > MAX_LINE_BYTES) {
+                response += "{\"error\": \"request line too long\"}\n";
+                sendAll(client, response);
+                break;
+            }
+            if (!response.empty() && !sendAll(client, response)) {
+                break;
+            }
+        }
+        connection.finished = true;
+    }
+
+    static bool sendAll(int client, const std::string& data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t written = send(client, data.data() + sent, data.size() - sent, 0);
+            if (written <= 0) {
+                return false;
+            }
+            sent += written;
+        }
+        return true;
+    }
+#else
+    void reapClients(bool) {}
+    void serveClient(Client&) {}
+#endif
+};
+
 // Main function
 /*
-Main function takes a crop name as a command-line argument and prints its average price. It loads the crop price data from a CSV file into a map and checks if the crop exists in the map. If the crop is found, its average price is printed; otherwise, an error message is displayed.
+`profit_predict <crop_name> [--stats]` prints the expected (mean) profit of a crop over all its historical reports in
+price_avg.csv, and with `--stats` their spread and percentiles. Lookups read the snapshot `price_stats.bin`, which
+is rebuilt first when it is missing or was built from other input files or earlier versions of them.
+
+`profit_predict --build [--input file]... [--snapshot file] [--threads N]` rebuilds the snapshot from one or more
+files of `crop_name,profit` rows (default price_avg.csv) with N threads (default 1, 0 for every core) and reports
+the throughput.
+
+`profit_predict --serve [socket]` keeps the table resident and answers PriceTable requests (any number of crop names
+per line, or `*`) on the Unix domain socket `crop_profit.sock`, reloading it when the inputs change.
+`profit_predict --batch <file|->` answers the request lines of a file, or of stdin as they arrive.
 */
 int main(int argc, char* argv[]) {
-    if (argc != 2) {
-        std::cerr << "Usage: " << argv[0] << " <crop_name>" << std::endl;
+    std::string crop_name;
+    std::vector<std::string> inputs;
+    std::string snapshotPath = PRICE_SNAPSHOT;
+    unsigned threads = 1;
+    bool build = false;
+    bool stats = false;
+    std::string socketPath;
+    std::string batchInput;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--input" && i + 1 < argc) {
+            inputs.push_back(argv[++i]);
+        } else if (arg == "--snapshot" && i + 1 < argc) {
+            snapshotPath = argv[++i];
+        } else if (arg == "--threads" && i + 1 < argc) {
+            int requested = std::stoi(argv[++i]);
+            threads = requested > 0 ? (unsigned)requested : std::max(1u, std::thread::hardware_concurrency());
+        } else if (arg == "--build") {
+            build = true;
+        } else if (arg == "--serve") {
+            socketPath = (i + 1 < argc && argv[i + 1][0] != '-') ? argv[++i] : PROFIT_SOCKET;
+        } else if (arg == "--batch" && i + 1 < argc) {
+            batchInput = argv[++i];
+        } else if (arg == "--stats") {
+            stats = true;
+        } else if (crop_name.empty() && arg[0] != '-') {
+            crop_name = arg;
+        } else {
+            crop_name.clear();
+            build = false;
+            break;
+        }
+    }
+    int modes = (int)build + (int)!crop_name.empty() + (int)!socketPath.empty() + (int)!batchInput.empty();
+    if (modes != 1) {
+        std::cerr << "Usage: " << argv[0] << " <crop_name> [--stats] [--input file]... [--snapshot file]\n"
+                  << "       " << argv[0] << " --build [--input file]... [--snapshot file] [--threads N]\n"
+                  << "       " << argv[0] << " --serve [socket] [--input file]... [--snapshot file]\n"
+                  << "       " << argv[0] << " --batch <file|-> [--input file]... [--snapshot file]" << std::endl;
         return 1;
     }
+    if (inputs.empty()) {
+        inputs.push_back(PRICE_CSV);
+    }
+
+    PriceAggregator aggregator;
+    if (build) {
+        auto startTime = std::chrono::steady_clock::now();
+        if (!build_price_stats(inputs, snapshotPath, threads, aggregator)) {
+            return 1;
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        std::cout << aggregator.crops().size() << " crops from " << aggregator.rowCount() << " rows ("
+                  << aggregator.skippedCount() << " skipped) in " << seconds << " s, "
+                  << aggregator.rowCount() / seconds << " rows/s" << std::endl;
+        return 0;
+    }
 
-    load_price_avg_map();
+    // Resident modes: load the table once and answer many requests
+    if (!socketPath.empty() || !batchInput.empty()) {
+        std::shared_ptr<PriceTable> table = std::make_shared<PriceTable>();
+        if (!table->load(inputs, snapshotPath, threads)) {
+            return 1;
+        }
+        if (!socketPath.empty()) {
+            ProfitServer server(socketPath, table, inputs, snapshotPath, threads);
+            return server.run();
+        }
+        std::ifstream fin;
+        if (batchInput != "-") {
+            fin.open(batchInput);
+            if (!fin) {
+                std::cerr << "Cannot read " << batchInput << std::endl;
+                return 1;
+            }
+        }
+        std::istream& in = batchInput == "-" ? std::cin : fin;
+        std::string line;
+        std::string response;
+        while (std::getline(in, line)) {
+            response.clear();
+            table->answer(line, response);
+            std::cout << response << std::flush;
+        }
+        return 0;
+    }
 
-    std::string crop_name = argv[1];
-    if (price_avg_map.find(crop_name) != price_avg_map.end()) {
-        std::cout << crop_name << ": " << price_avg_map[crop_name] << std::endl;
-    } else {
-        std::cerr << "Crop not found: " << crop_name << std::endl;
+    PriceSnapshot snapshot;
+    if (!loadOrBuildPriceSnapshot(inputs, snapshotPath, threads, snapshot, aggregator)) {
         return 1;
     }
-
-    return 0;
-}
\ No newline at end of file
+    if (snapshot.isOpen()) {
+        const PriceSummary* crop = snapshot.find(crop_name);
+        if (crop != nullptr) {
+            print_profit(crop_name, crop->count, crop->mean, crop->variance, crop->minimum, crop->maximum,
+                         [&](double q) { return snapshot.quantile(*crop, q); }, stats);
+            return 0;
+        }
+    } else {
+        auto found = aggregator.crops().find(crop_name);
+        if (found != aggregator.crops().end()) {
+            const PriceStats& crop = found->second;
+            print_profit(crop_name, crop.count, crop.mean, crop.variance(), crop.minimum, crop.maximum,
+                         [&](double q) { return crop.quantile(q); }, stats);
+            return 0;
+        }
+    }
+    std::cerr << "Crop not found: " << crop_name << std::endl;
+    return 1;
+}
@@ -0,0 +1,583 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <chrono>
+#include <thread>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <unordered_map>
+#include <nlohmann/json.hpp>
+#include "predictor.h"
+#include "price_stats.h"
+
+using json = nlohmann::json;
+using namespace std;
+
+const char* const PRICE_CSV = "price_avg.csv";
+const char* const PRICE_SNAPSHOT = "price_stats.bin";
+
+// Input field names of the model's attributes, in model order; instance.json calls the pH field "ph_level".
+const vector<vector<string>> ATTRIBUTE_FIELDS = {
+    {"N"}, {"P"}, {"K"}, {"temperature"}, {"humidity"}, {"ph", "ph_level"}, {"rainfall"}
+};
+
+// Input field names that identify a candidate field in a batch.
+const vector<string> FIELD_ID_NAMES = {"field", "id"};
+
+// one ranked crop of a field: score = likelihood * profit.
+struct Recommendation {
+    int crop;
+    double likelihood;
+    double profit;
+    double score;
+};
+
+/*
+expectedProfits(): mean profit of every crop in the price statistics, from the snapshot loadOrBuildPriceSnapshot()
+opens (as profit_predict does) or, if it cannot be written, from the statistics it aggregated.
+*/
+bool expectedProfits(const vector<string>& inputs, const string& snapshotPath, unsigned threads,
+                     unordered_map<string, double>& profit) {
+    PriceSnapshot snapshot;
+    PriceAggregator aggregator;
+    if (!loadOrBuildPriceSnapshot(inputs, snapshotPath, threads, snapshot, aggregator)) {
+        return false;
+    }
+    profit.clear();
+    if (snapshot.isOpen()) {
+        for (uint32_t crop = 0; crop < snapshot.cropCount(); crop++) {
+            profit.emplace(string(snapshot.name(crop)), snapshot.summary(crop).mean);
+        }
+    } else {
+        for (const auto& crop : aggregator.crops()) {
+            profit.emplace(crop.first, crop.second.mean);
+        }
+    }
+    return true;
+}
+
+/*
+`Recommender` ranks the crops for a field by score = likelihood * expected profit. A crop's likelihood is its share of
+the training rows in the leaf the field reaches (for a forest, that share averaged over the trees), so crops the
+tree did not predict still rank when their profit makes up for it; its expected profit is the mean of its price
+reports. Crops without reports are not ranked.
+
+With a single tree the ranking only depends on the leaf, so every leaf's ranking is computed once when the model is
+loaded and ranking a field is one walk down the tree. A forest sums the leaves of all its trees and picks the top k.
+Read-only once loaded, so one Recommender serves every thread.
+*/
+class Recommender {
+public:
+    bool loadTree(const string& binaryPath, const string& jsonPath, const unordered_map<string, double>& profits) {
+        if (!tree.load(binaryPath, jsonPath)) {
+            return false;
+        }
+        isForest = false;
+        cropNames.clear();
+        profit.clear();
+        rankingStart.assign(tree.nodeCount() + 1, 0);
+        rankings.clear();
+        for (size_t node = 0; node < tree.nodeCount(); node++) {
+            rankingStart[node] = (uint32_t)rankings.size();
+            if (!tree.isLeaf(node)) {
+                continue;
+            }
+            Predictor::ClassCounts counts = tree.leafClassCounts(node);
+            double rows = 0.0;
+            for (size_t i = 0; i < counts.size; i++) {
+                rows += counts.count[i];
+            }
+            for (size_t i = 0; i < counts.size; i++) {
+                int crop = (int)counts.label[i];
+                double cropProfit = profitOf(crop, profits);
+                if (!isnan(cropProfit) && rows > 0) {
+                    double likelihood = counts.count[i] / rows;
+                    rankings.push_back({crop, likelihood, cropProfit, likelihood * cropProfit});
+                }
+            }
+            sort(rankings.begin() + rankingStart[node], rankings.end(), [this](const Recommendation& a,
+                                                                               const Recommendation& b) {
+                return ranksBefore(a, b);
+            });
+        }
+        rankingStart[tree.nodeCount()] = (uint32_t)rankings.size();
+        return true;
+    }
+
+    bool loadForest(const string& path, const unordered_map<string, double>& profits) {
+        if (!forest.loadJson(path)) {
+            return false;
+        }
+        isForest = true;
+        cropNames.clear();
+        profit.clear();
+        for (size_t crop = 0; crop < forest.classCount(); crop++) {
+            profitOf((int)crop, profits);
+        }
+        return true;
+    }
+
+    string_view cropName(int crop) const {
+        return isForest ? forest.labelName(crop) : tree.labelName(crop);
+    }
+
+    // unpriced(): names of the crops the model knows that have no price reports.
+    vector<string> unpriced() const {
+        vector<string> names;
+        for (size_t crop = 0; crop < profit.size(); crop++) {
+            if (isnan(profit[crop]) && !cropNames[crop].empty()) {
+                names.push_back(cropNames[crop]);
+            }
+        }
+        return names;
+    }
+
+    /*
+    rank(): the `top` best crops for `row`, best first, in `out`. Returns false if the row reaches no leaf.
+    `likelihood` is scratch space, so that a thread ranking many fields allocates nothing per field.
+    */
+    template <typename Row>
+    bool rank(const Row& row, size_t rowSize, size_t top, vector<Recommendation>& out,
+              vector<double>& likelihood) const {
+        out.clear();
+        if (!isForest) {
+            int leaf = tree.predictLeaf(row, rowSize);
+            if (leaf == Predictor::FAILED) {
+                return false;
+            }
+            size_t count = min<size_t>(top, rankingStart[leaf + 1] - rankingStart[leaf]);
+            out.assign(rankings.begin() + rankingStart[leaf], rankings.begin() + rankingStart[leaf] + count);
+            return true;
+        }
+        if (forest.likelihood(row, rowSize, likelihood) == 0) {
+            return false;
+        }
+        for (size_t crop = 0; crop < likelihood.size(); crop++) {
+            if (likelihood[crop] > 0 && !isnan(profit[crop])) {
+                out.push_back({(int)crop, likelihood[crop], profit[crop], likelihood[crop] * profit[crop]});
+            }
+        }
+        size_t count = min(top, out.size());
+        partial_sort(out.begin(), out.begin() + count, out.end(), [this](const Recommendation& a,
+                                                                         const Recommendation& b) {
+            return ranksBefore(a, b);
+        });
+        out.resize(count);
+        return true;
+    }
+
+private:
+    bool isForest = false;
+    Predictor tree;
+    ForestPredictor forest;
+    vector<double> profit;                  // expected profit per crop id; NaN without price reports.
+    vector<string> cropNames;               // names of the crop ids looked up so far.
+    vector<uint32_t> rankingStart;          // tree leaf l's ranking is rankings[rankingStart[l], rankingStart[l + 1]).
+    vector<Recommendation> rankings;
+
+    // profitOf(): expected profit of a crop id, looked up by name once and cached.
+    double profitOf(int crop, const unordered_map<string, double>& profits) {
+        if (profit.size() <= (size_t)crop) {
+            profit.resize(crop + 1, numeric_limits<double>::quiet_NaN());
+            cropNames.resize(crop + 1);
+        }
+        if (cropNames[crop].empty()) {
+            cropNames[crop] = string(cropName(crop));
+            auto found = profits.find(cropNames[crop]);
+            if (found != profits.end()) {
+                profit[crop] = found->second;
+            }
+        }
+        return profit[crop];
+    }
+
+    // best score first; ties by likelihood, then by name, so rankings are deterministic.
+    bool ranksBefore(const Recommendation& a, const Recommendation& b) const {
+        if (a.score != b.score) {
+            return a.score > b.score;
+        }
+        if (a.likelihood != b.likelihood) {
+            return a.likelihood > b.likelihood;
+        }
+        return cropName(a.crop) < cropName(b.crop);
+    }
+};
+
+/*
+`Conditions` are the soil and weather values shared by every field of a request (read from an instance.json-style
+object); a field's own values override them.
+*/
+struct Conditions {
+    vector<string> value = vector<string>(ATTRIBUTE_FIELDS.size());
+    vector<bool> isSet = vector<bool>(ATTRIBUTE_FIELDS.size(), false);
+
+    bool load(const string& path) {
+        ifstream fin(path);
+        json conditions = json::parse(fin, nullptr, false);
+        if (!conditions.is_object()) {
+            return false;
+        }
+        for (size_t attr = 0; attr < ATTRIBUTE_FIELDS.size(); attr++) {
+            for (const string& field : ATTRIBUTE_FIELDS[attr]) {
+                auto found = conditions.find(field);
+                if (found != conditions.end() && !isSet[attr]) {
+                    value[attr] = found->is_string() ? found->get<string>() : found->dump();
+                    isSet[attr] = true;
+                }
+            }
+        }
+        return true;
+    }
+};
+
+/*
+`BatchRecommender` ranks a batch of candidate fields, either CSV with a header row or JSONL with one object per line.
+A field gives any of the model's attributes (as in Crop_recommendation.csv or instance.json) and optionally a `field`
+or `id` to name it; attributes it leaves out come from the conditions. The lines are split across threads that parse
+and rank them in place, and the results are written in input order: for CSV one `field,rank,crop,likelihood,profit,
+score` row per recommendation, for JSONL one {"field": ..., "recommendations": [...]} object per field. A field that
+cannot be ranked gets rank 0 and crop "Prediction failed" (CSV) or an "error" (JSONL). Throughput goes to stderr.
+*/
+class BatchRecommender {
+public:
+    BatchRecommender(const Recommender& recommender, const Conditions& conditions, size_t top, int threadCount)
+        : recommender(recommender), conditions(conditions), top(top), threadCount(threadCount) {}
+
+    bool run(istream& in, ostream& out) {
+        auto startTime = chrono::steady_clock::now();
+        stringstream buffer;
+        buffer << in.rdbuf();
+        string input = buffer.str();
+        vector<string_view> lines;
+        splitLines(input, lines);
+        if (lines.empty()) {
+            return true;
+        }
+        size_t begin = 0;
+        isJson = lines[0].find('{') != string_view::npos;
+        if (!isJson) {
+            if (!readHeader(lines[0])) {
+                return false;
+            }
+            begin = 1;
+            out << "field,rank,crop,likelihood,profit,score\n";
+        }
+
+        size_t count = lines.size() - begin;
+        size_t workers = min<size_t>(threadCount, max<size_t>(1, count / 1024));
+        vector<string> output(workers);
+        vector<thread> threads;
+        for (size_t w = 0; w < workers; w++) {
+            size_t sliceBegin = begin + count * w / workers;
+            size_t sliceEnd = begin + count * (w + 1) / workers;
+            if (w + 1 == workers) {
+                rankSlice(lines, begin, sliceBegin, sliceEnd, output[w]);
+            } else {
+                threads.emplace_back(&BatchRecommender::rankSlice, this, cref(lines), begin, sliceBegin, sliceEnd,
+                                     ref(output[w]));
+            }
+        }
+        for (thread& worker : threads) {
+            worker.join();
+        }
+        for (const string& slice : output) {
+            out << slice;
+        }
+        out.flush();
+        if (!out) {
+            cerr << "recommendations could not be written\n";
+            return false;
+        }
+
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+        cerr << count << " fields in " << seconds << " s (" << (seconds > 0 ? count / seconds : 0.0)
+             << " fields/s, " << workers << " threads)\n";
+        return true;
+    }
+
+private:
+    const Recommender& recommender;
+    const Conditions& conditions;
+    size_t top;
+    int threadCount;
+    bool isJson = false;
+    vector<int> columnOfAttr;       // CSV column holding each model attribute, or -1 to use the conditions.
+    int idColumn = -1;
+    size_t columnsNeeded = 0;
+
+    static void splitLines(const string& input, vector<string_view>& lines) {
+        size_t start = 0;
+        while (start < input.size()) {
+            size_t end = input.find('\n', start);
+            if (end == string::npos) {
+                end = input.size();
+            }
+            string_view line(input.data() + start, end - start);
+            if (!line.empty() && line.back() == '\r') {
+                line.remove_suffix(1);
+            }
+            if (line.find_first_not_of(" \t") != string_view::npos) {
+                lines.push_back(line);
+            }
+            start = end + 1;
+        }
+    }
+
+    static void splitFields(string_view line, vector<string_view>& fields, size_t limit) {
+        fields.clear();
+        size_t start = 0;
+        while (fields.size() < limit) {
+            size_t comma = line.find(',', start);
+            fields.push_back(line.substr(start, comma == string_view::npos ? string_view::npos : comma - start));
+            if (comma == string_view::npos) {
+                break;
+            }
+            start = comma + 1;
+        }
+    }
+
+    bool readHeader(string_view header) {
+        vector<string_view> names;
+        splitFields(header, names, SIZE_MAX);
+        auto columnOf = [&names](const vector<string>& fields) {
+            for (size_t column = 0; column < names.size(); column++) {
+                if (find(fields.begin(), fields.end(), names[column]) != fields.end()) {
+                    return (int)column;
+                }
+            }
+            return -1;
+        };
+        columnOfAttr.assign(ATTRIBUTE_FIELDS.size(), -1);
+        for (size_t attr = 0; attr < ATTRIBUTE_FIELDS.size(); attr++) {
+            columnOfAttr[attr] = columnOf(ATTRIBUTE_FIELDS[attr]);
+            if (columnOfAttr[attr] == -1 && !conditions.isSet[attr]) {
+                cerr << "CSV header has no " << ATTRIBUTE_FIELDS[attr][0] << " column and no condition sets it\n";
+                return false;
+            }
+            columnsNeeded = max<size_t>(columnsNeeded, columnOfAttr[attr] + 1);
+        }
+        idColumn = columnOf(FIELD_ID_NAMES);
+        columnsNeeded = max<size_t>(columnsNeeded, idColumn + 1);
+        return true;
+    }
+
+    void rankSlice(const vector<string_view>& lines, size_t first, size_t begin, size_t end, string& output) const {
+        vector<string_view> fields;
+        vector<string_view> row(ATTRIBUTE_FIELDS.size());
+        vector<string> text(ATTRIBUTE_FIELDS.size());      // JSON values, kept alive while the row is ranked.
+        vector<Recommendation> ranking;
+        vector<double> likelihood;
+        string id;
+        for (size_t i = begin; i < end; i++) {
+            id = to_string(i - first + 1);
+            bool parsed = isJson ? parseJsonField(lines[i], row, text, id) : parseCsvField(lines[i], fields, row, id);
+            bool ranked = parsed && recommender.rank(row, row.size(), top, ranking, likelihood);
+            if (isJson) {
+                writeJson(output, id, parsed, ranked, ranking);
+            } else {
+                writeCsv(output, id, ranked, ranking);
+            }
+        }
+    }
+
+    bool parseCsvField(string_view line, vector<string_view>& fields, vector<string_view>& row, string& id) const {
+        splitFields(line, fields, columnsNeeded);
+        if (idColumn >= 0 && (size_t)idColumn < fields.size()) {
+            id = fields[idColumn];
+        }
+        if (fields.size() < columnsNeeded) {
+            return false;
+        }
+        for (size_t attr = 0; attr < row.size(); attr++) {
+            row[attr] = columnOfAttr[attr] >= 0 ? fields[columnOfAttr[attr]] : string_view(conditions.value[attr]);
+        }
+        return true;
+    }
+
+    // parseJsonField(): the field's own values, the conditions for the rest; `id` becomes the field's id as JSON.
+    bool parseJsonField(string_view line, vector<string_view>& row, vector<string>& text, string& id) const {
+        json field = json::parse(line.begin(), line.end(), nullptr, false);
+        if (!field.is_object()) {
+            return false;
+        }
+        for (const string& name : FIELD_ID_NAMES) {
+            auto found = field.find(name);
+            if (found != field.end()) {
+                id = found->dump();
+                break;
+            }
+        }
+        for (size_t attr = 0; attr < row.size(); attr++) {
+            const json* value = nullptr;
+            for (const string& name : ATTRIBUTE_FIELDS[attr]) {
+                auto found = field.find(name);
+                if (found != field.end()) {
+                    value = &*found;
+                    break;
+                }
+            }
+            if (value == nullptr) {
+                if (!conditions.isSet[attr]) {
+                    return false;
+                }
+                row[attr] = conditions.value[attr];
+                continue;
+            }
+            text[attr] = value->is_string() ? value->get<string>() : value->dump();
+            row[attr] = text[attr];
+        }
+        return true;
+    }
+
+    void writeCsv(string& output, const string& id, bool ranked, const vector<Recommendation>& ranking) const {
+        if (!ranked) {
+            output += id + ",0,Prediction failed,,,\n";
+            return;
+        }
+        char numbers[96];
+        for (size_t r = 0; r < ranking.size(); r++) {
+            snprintf(numbers, sizeof(numbers), ",%.6g,%.10g,%.10g\n", ranking[r].likelihood, ranking[r].profit,
+                     ranking[r].score);
+            output += id + "," + to_string(r + 1) + ",";
+            output += recommender.cropName(ranking[r].crop);
+            output += numbers;
+        }
+    }
+
+    void writeJson(string& output, const string& id, bool parsed, bool ranked,
+                   const vector<Recommendation>& ranking) const {
+        output += "{\"field\": " + id;
+        if (!ranked) {
+            output += parsed ? ", \"error\": \"Prediction failed\"}\n" : ", \"error\": \"invalid field\"}\n";
+            return;
+        }
+        output += ", \"recommendations\": [";
+        char numbers[128];
+        for (size_t r = 0; r < ranking.size(); r++) {
+            snprintf(numbers, sizeof(numbers), ", \"likelihood\": %.6g, \"profit\": %.10g, \"score\": %.10g}",
+                     ranking[r].likelihood, ranking[r].profit, ranking[r].score);
+            output += (r > 0 ? ", {\"crop\": " : "{\"crop\": ") + json(recommender.cropName(ranking[r].crop)).dump() +
+                      numbers;
+        }
+        output += "]}\n";
+    }
+};
+
+/*
+main program: recommends the crops to plant by combining the crop classifier with the price statistics.
+
+    recommend [--top K] [--conditions instance.json] [--batch <fields.csv|fields.jsonl|-> [--output <file|->]]
+              [--forest [crop_forest.json]] [--input file]... [--snapshot file] [--threads N]
+
+Without --batch it ranks the one field described by the conditions (instance.json); with --batch it ranks every
+candidate field of the batch, which share the conditions. The model (crop_prediction.bin / .json, or the forest) and
+the price statistics (price_stats.bin, rebuilt from price_avg.csv or the --input files when stale) are loaded once.
+*/
+int main(int argc, char* argv[]) {
+    size_t top = 3;
+    string conditionsPath;
+    string batchInput;
+    string batchOutput = "-";
+    string forestPath;
+    vector<string> inputs;
+    string snapshotPath = PRICE_SNAPSHOT;
+    int threadCount = max(1, (int)thread::hardware_concurrency());
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--top" && i + 1 < argc) {
+            top = max(1, stoi(argv[++i]));
+        } else if (arg == "--conditions" && i + 1 < argc) {
+            conditionsPath = argv[++i];
+        } else if (arg == "--batch" && i + 1 < argc) {
+            batchInput = argv[++i];
+        } else if (arg == "--output" && i + 1 < argc) {
+            batchOutput = argv[++i];
+        } else if (arg == "--forest") {
+            forestPath = (i + 1 < argc && argv[i + 1][0] != '-') ? argv[++i] : "crop_forest.json";
+        } else if (arg == "--input" && i + 1 < argc) {
+            inputs.push_back(argv[++i]);
+        } else if (arg == "--snapshot" && i + 1 < argc) {
+            snapshotPath = argv[++i];
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threadCount = max(1, stoi(argv[++i]));
+        } else {
+            cerr << "Usage: " << argv[0] << " [--top K] [--conditions instance.json]"
+                 << " [--batch <fields.csv|fields.jsonl|-> [--output <file|->]] [--forest [crop_forest.json]]"
+                 << " [--input file]... [--snapshot file] [--threads N]\n";
+            return 1;
+        }
+    }
+    if (inputs.empty()) {
+        inputs.push_back(PRICE_CSV);
+    }
+
+    Conditions conditions;
+    if (conditionsPath.empty() && batchInput.empty()) {
+        conditionsPath = "instance.json";
+    }
+    if (!conditionsPath.empty() && !conditions.load(conditionsPath)) {
+        cerr << conditionsPath << " could not be loaded\n";
+        return 1;
+    }
+
+    unordered_map<string, double> profits;
+    if (!expectedProfits(inputs, snapshotPath, threadCount, profits)) {
+        return 1;
+    }
+    Recommender recommender;
+    if (!forestPath.empty() ? !recommender.loadForest(forestPath, profits)
+                            : !recommender.loadTree("crop_prediction.bin", "crop_prediction.json", profits)) {
+        cerr << (!forestPath.empty() ? forestPath : "crop_prediction.bin / crop_prediction.json")
+             << " could not be loaded\n";
+        return 1;
+    }
+    for (const string& name : recommender.unpriced()) {
+        cerr << "Warning: no price reports for " << name << "; it is not ranked\n";
+    }
+
+    // Batch mode: rank every candidate field ("-" is stdin / stdout)
+    if (!batchInput.empty()) {
+        ifstream fin;
+        ofstream fout;
+        if (batchInput != "-") {
+            fin.open(batchInput, ios::binary);
+            if (!fin) {
+                cerr << batchInput << " file could not be opened\n";
+                return 1;
+            }
+        }
+        if (batchOutput != "-") {
+            fout.open(batchOutput, ios::binary);
+            if (!fout) {
+                cerr << "Cannot write " << batchOutput << "\n";
+                return 1;
+            }
+        }
+        BatchRecommender batch(recommender, conditions, top, threadCount);
+        return batch.run(batchInput == "-" ? cin : fin, batchOutput == "-" ? cout : fout) ? 0 : 1;
+    }
+
+    vector<string_view> row(ATTRIBUTE_FIELDS.size());
+    for (size_t attr = 0; attr < row.size(); attr++) {
+        if (!conditions.isSet[attr]) {
+            cerr << conditionsPath << " has no " << ATTRIBUTE_FIELDS[attr][0] << "\n";
+            return 1;
+        }
+        row[attr] = conditions.value[attr];
+    }
+    vector<Recommendation> ranking;
+    vector<double> likelihood;
+    if (!recommender.rank(row, row.size(), top, ranking, likelihood)) {
+        cout << "Prediction failed" << endl;
+        return 1;
+    }
+    for (size_t r = 0; r < ranking.size(); r++) {
+        cout << r + 1 << ". " << recommender.cropName(ranking[r].crop) << ": likelihood " << ranking[r].likelihood
+             << ", profit " << ranking[r].profit << ", score " << ranking[r].score << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,294 @@
+#ifndef ROLLUP_H
+#define ROLLUP_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "mapped_file.h"
+#include "tsdb.h"
+
+/*
+Multi-resolution rollups of the sensor readings, kept next to the time-series store (see tsdb.h).
+
+For each resolution (1 second, 1 minute and 1 hour) every bucket of that width holds the count, minimum, maximum,
+mean and last value of the soil moisture and pH readings that fell into it. The buckets of a resolution live in a
+fixed-size ring file, `rollup-1s.tsdb` and so on: the bucket starting at time t is slot (t / width) % capacity, so a
+bucket is found by arithmetic instead of a search, and old buckets are overwritten once the ring wraps (after a day
+of 1 s buckets, 90 days of 1 min buckets and 10 years of 1 h buckets). A slot records its bucket's start time, and a
+slot whose start does not match is empty.
+
+`add()` updates the open bucket of every resolution and writes a bucket out when a reading lands in a later one;
+`flush()` also writes the open buckets, so readers see partial buckets within one flush. `query()` returns a fixed
+number of points for any time range by reading the coarsest resolution that is still finer than one point, so a
+month costs about as much as a minute.
+*/
+
+struct RollupLevel {
+    const char* name;
+    int64_t width;              // milliseconds per bucket.
+    uint32_t capacity;          // buckets kept.
+};
+
+const RollupLevel ROLLUP_LEVELS[] = {
+    {"1s", 1000, 24 * 3600},
+    {"1m", 60 * 1000, 90 * 24 * 60},
+    {"1h", 3600 * 1000, 10 * 365 * 24},
+};
+const int ROLLUP_LEVEL_COUNT = sizeof(ROLLUP_LEVELS) / sizeof(ROLLUP_LEVELS[0]);
+
+// one bucket as stored in a ring file; index 0 of each array is soil moisture, 1 is pH.
+struct RollupBucket {
+    int64_t start;              // 0 for an empty slot.
+    uint32_t count;
+    uint32_t reserved;
+    float minimum[2];
+    float maximum[2];
+    float mean[2];
+    float last[2];
+};
+
+// one point of a query result: the readings between `start` (inclusive) and `end` (exclusive).
+struct RollupPoint {
+    int64_t start;
+    int64_t end;
+    uint64_t count;             // 0 if there were none; the statistics are then NaN.
+    double minimum[2];
+    double maximum[2];
+    double mean[2];
+    double last[2];
+};
+
+class SensorRollups {
+public:
+    explicit SensorRollups(std::string directory, bool syncWrites = false)
+        : directory(std::move(directory)), syncWrites(syncWrites) {
+    }
+
+    ~SensorRollups() {
+        close();
+    }
+
+    // openForWriting(): opens (creating if needed) the ring file of every resolution for add() and flush().
+    bool openForWriting() {
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+        for (int l = 0; l < ROLLUP_LEVEL_COUNT; l++) {
+            std::string path = levelPath(l);
+            files[l] = std::fopen(path.c_str(), "r+b");
+            if (files[l] == nullptr) {
+                files[l] = std::fopen(path.c_str(), "w+b");
+            }
+            if (files[l] == nullptr) {
+                close();
+                return false;
+            }
+            open[l] = Accumulator();
+        }
+        return true;
+    }
+
+    void add(const SensorSample& sample) {
+        for (int l = 0; l < ROLLUP_LEVEL_COUNT; l++) {
+            int64_t start = bucketStart(sample.time, ROLLUP_LEVELS[l].width);
+            Accumulator& bucket = open[l];
+            if (bucket.count > 0 && bucket.start != start) {
+                writeBucket(l, bucket);
+                bucket = Accumulator();
+            }
+            if (bucket.count == 0) {
+                resume(l, start, bucket);
+            }
+            bucket.add(sample);
+        }
+    }
+
+    // flush(): writes the open buckets, so readers see them before they are complete.
+    void flush() {
+        for (int l = 0; l < ROLLUP_LEVEL_COUNT; l++) {
+            if (files[l] == nullptr) {
+                continue;
+            }
+            if (open[l].count > 0 && open[l].dirty) {
+                writeBucket(l, open[l]);
+            }
+            if (syncWrites) {
+                tsdbSync(files[l]);
+            } else {
+                std::fflush(files[l]);
+            }
+        }
+    }
+
+    // diskBytes(): size of the ring files.
+    uint64_t diskBytes() const {
+        uint64_t total = 0;
+        for (int l = 0; l < ROLLUP_LEVEL_COUNT; l++) {
+            std::error_code error;
+            uint64_t size = std::filesystem::file_size(levelPath(l), error);
+            total += error ? 0 : size;
+        }
+        return total;
+    }
+
+    void close() {
+        flush();
+        for (int l = 0; l < ROLLUP_LEVEL_COUNT; l++) {
+            if (files[l] != nullptr) {
+                std::fclose(files[l]);
+                files[l] = nullptr;
+            }
+        }
+    }
+
+    /*
+    query(): `points` points of equal width covering [from, to). Each point merges the buckets of the coarsest
+    resolution whose width is at most the point width (the 1 s one for narrower points), so at most about 60
+    buckets are read per point, and never more than the range holds at 1 h resolution.
+    */
+    std::vector<RollupPoint> query(int64_t from, int64_t to, int points) const {
+        points = std::max(1, points);
+        to = std::max(to, from + 1);
+        int64_t pointWidth = std::max<int64_t>(1, (to - from + points - 1) / points);
+        int level = 0;
+        while (level + 1 < ROLLUP_LEVEL_COUNT && ROLLUP_LEVELS[level + 1].width <= pointWidth) {
+            level++;
+        }
+        const RollupLevel& resolution = ROLLUP_LEVELS[level];
+
+        std::vector<RollupPoint> result(points);
+        std::vector<Accumulator> merged(points);
+        for (int p = 0; p < points; p++) {
+            result[p].start = from + p * pointWidth;
+            result[p].end = std::min(to, result[p].start + pointWidth);
+        }
+
+        MappedFile file;
+        if (file.open(levelPath(level)) && file.size() >= sizeof(RollupBucket)) {
+            const RollupBucket* slots = reinterpret_cast<const RollupBucket*>(file.data());
+            size_t slotCount = file.size() / sizeof(RollupBucket);
+            // a bucket counts towards the point that holds its start (the first point, for one that began before
+            // `from`); the ring holds at most `capacity` of them.
+            int64_t oldestKept = bucketStart(to - 1, resolution.width) - (int64_t)(resolution.capacity - 1) * resolution.width;
+            int64_t first = std::max(bucketStart(from, resolution.width), oldestKept);
+            for (int64_t start = first; start < to; start += resolution.width) {
+                size_t slot = slotOf(start, resolution);
+                if (slot >= slotCount || slots[slot].start != start || slots[slot].count == 0) {
+                    continue;
+                }
+                merged[std::max<int64_t>(0, start - from) / pointWidth].merge(slots[slot]);
+            }
+        }
+        for (int p = 0; p < points; p++) {
+            merged[p].finish(result[p]);
+        }
+        return result;
+    }
+
+    static int64_t bucketStart(int64_t time, int64_t width) {
+        int64_t start = time / width * width;
+        return start > time ? start - width : start;        // round towards minus infinity.
+    }
+
+private:
+    // running statistics of a bucket (or of the buckets merged into one query point).
+    struct Accumulator {
+        int64_t start = 0;
+        uint64_t count = 0;
+        double minimum[2] = {INFINITY, INFINITY};
+        double maximum[2] = {-INFINITY, -INFINITY};
+        double sum[2] = {0.0, 0.0};
+        double last[2] = {NAN, NAN};
+        int64_t lastStart = INT64_MIN;      // start of the bucket `last` came from, when merging.
+        bool dirty = false;
+
+        void add(const SensorSample& sample) {
+            double level[2] = {sample.soilMoistureLevel, sample.phLevel};
+            for (int v = 0; v < 2; v++) {
+                minimum[v] = std::min(minimum[v], level[v]);
+                maximum[v] = std::max(maximum[v], level[v]);
+                sum[v] += level[v];
+                last[v] = level[v];
+            }
+            count++;
+            dirty = true;
+        }
+
+        void merge(const RollupBucket& bucket) {
+            for (int v = 0; v < 2; v++) {
+                minimum[v] = std::min(minimum[v], (double)bucket.minimum[v]);
+                maximum[v] = std::max(maximum[v], (double)bucket.maximum[v]);
+                sum[v] += (double)bucket.mean[v] * bucket.count;
+                if (bucket.start > lastStart) {
+                    last[v] = bucket.last[v];
+                }
+            }
+            lastStart = std::max(lastStart, bucket.start);
+            count += bucket.count;
+        }
+
+        void finish(RollupPoint& point) const {
+            point.count = count;
+            for (int v = 0; v < 2; v++) {
+                point.minimum[v] = count > 0 ? minimum[v] : NAN;
+                point.maximum[v] = count > 0 ? maximum[v] : NAN;
+                point.mean[v] = count > 0 ? sum[v] / count : NAN;
+                point.last[v] = count > 0 ? last[v] : NAN;
+            }
+        }
+    };
+
+    std::string directory;
+    bool syncWrites;
+    std::FILE* files[ROLLUP_LEVEL_COUNT] = {};
+    Accumulator open[ROLLUP_LEVEL_COUNT];   // bucket being filled, per resolution.
+
+    std::string levelPath(int level) const {
+        std::string name = std::string("rollup-") + ROLLUP_LEVELS[level].name + ".tsdb";
+        return (std::filesystem::path(directory) / name).string();
+    }
+
+    static size_t slotOf(int64_t start, const RollupLevel& resolution) {
+        int64_t bucket = start / resolution.width;
+        return (size_t)(((bucket % resolution.capacity) + resolution.capacity) % resolution.capacity);
+    }
+
+    void writeBucket(int level, Accumulator& bucket) {
+        RollupBucket stored{};
+        stored.start = bucket.start;
+        stored.count = (uint32_t)bucket.count;
+        for (int v = 0; v < 2; v++) {
+            stored.minimum[v] = (float)bucket.minimum[v];
+            stored.maximum[v] = (float)bucket.maximum[v];
+            stored.mean[v] = (float)(bucket.sum[v] / bucket.count);
+            stored.last[v] = (float)bucket.last[v];
+        }
+        std::fseek(files[level], (long)(slotOf(bucket.start, ROLLUP_LEVELS[level]) * sizeof(RollupBucket)), SEEK_SET);
+        std::fwrite(&stored, sizeof(stored), 1, files[level]);
+        bucket.dirty = false;
+    }
+
+    // resume(): starts the bucket at `start`, continuing from what an earlier run wrote to its slot, if anything.
+    void resume(int level, int64_t start, Accumulator& bucket) {
+        bucket.start = start;
+        RollupBucket stored;
+        std::FILE* file = files[level];
+        std::fseek(file, (long)(slotOf(start, ROLLUP_LEVELS[level]) * sizeof(RollupBucket)), SEEK_SET);
+        if (std::fread(&stored, sizeof(stored), 1, file) != 1 || stored.start != start || stored.count == 0) {
+            return;
+        }
+        bucket.count = stored.count;
+        for (int v = 0; v < 2; v++) {
+            bucket.minimum[v] = stored.minimum[v];
+            bucket.maximum[v] = stored.maximum[v];
+            bucket.sum[v] = (double)stored.mean[v] * stored.count;
+            bucket.last[v] = stored.last[v];
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,389 @@
+#ifndef RULE_ENGINE_H
+#define RULE_ENGINE_H
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+Alert rules for chms.cpp, loaded from a config file with one rule per line (`#` starts a comment):
+
+    # name      metric    condition  threshold  clear  for  actions
+    dry         moisture  below      30         35     0    alarm,irrigate
+    drying      moisture  falls_by   8          4      3    alarm
+
+`condition` is `below` or `above` (the reading against `threshold`) or `falls_by` or `rises_by` (its change per
+second against `threshold`). A rule fires its actions once the condition has held for `for` seconds, and then stays
+quiet until the value is back past `clear` (`-` means the threshold itself), so a reading that hovers around the
+threshold does not raise an alert on every tick. `actions` is a comma-separated list of action names.
+*/
+
+// one matched action, as handed to the action queue.
+struct AlertAction {
+    uint32_t rule;
+    uint32_t action;
+    uint32_t field;
+    float value;                // reading (or change per second) that triggered the rule.
+};
+
+/*
+`RuleEngine` compiles the rules into a flat program: one instruction per rule, sorted by the column it reads, each
+normalized so that the condition is `sign * value > threshold` and the release `sign * value <= clear`. Columns are
+the metric readings and, for rate rules, their change per second, computed once per tick. `evaluate()` runs the
+program over a batch of fields: for every instruction one branch-free loop over all fields updates the per-field
+state (ticks the condition has held, alert active), and only the fields that fired are looked at again to queue
+their actions.
+*/
+class RuleEngine {
+public:
+    RuleEngine(std::vector<std::string> metricNames, double tickSeconds)
+        : metricNames(std::move(metricNames)), tickSeconds(tickSeconds) {
+    }
+
+    // compile(): replaces the rules with the ones in `text`; on error returns false and describes it in `error`.
+    bool compile(const std::string& text, std::string& error) {
+        std::vector<Instruction> compiled;
+        std::vector<std::string> names;
+        std::vector<std::vector<uint32_t>> actions;
+        std::istringstream lines(text);
+        std::string line;
+        for (int lineNumber = 1; std::getline(lines, line); lineNumber++) {
+            line = line.substr(0, line.find('#'));
+            std::istringstream fields(line);
+            std::string name, metric, condition, threshold, clear, duration, actionList, extra;
+            if (!(fields >> name)) {
+                continue;
+            }
+            if (!(fields >> metric >> condition >> threshold >> clear >> duration >> actionList) || (fields >> extra)) {
+                error = "line " + std::to_string(lineNumber) +
+                        ": expected name, metric, condition, threshold, clear, for and actions";
+                return false;
+            }
+            Instruction instruction;
+            auto metricIt = std::find(metricNames.begin(), metricNames.end(), metric);
+            if (metricIt == metricNames.end()) {
+                error = "line " + std::to_string(lineNumber) + ": unknown metric " + metric;
+                return false;
+            }
+            int metricIndex = (int)(metricIt - metricNames.begin());
+            if (condition == "below" || condition == "above") {
+                instruction.column = metricIndex;
+            } else if (condition == "falls_by" || condition == "rises_by") {
+                instruction.column = (int)metricNames.size() + metricIndex;
+            } else {
+                error = "line " + std::to_string(lineNumber) + ": unknown condition " + condition;
+                return false;
+            }
+            instruction.sign = (condition == "below" || condition == "falls_by") ? -1.0f : 1.0f;
+            float thresholdValue, clearValue;
+            double seconds;
+            try {
+                thresholdValue = std::stof(threshold);
+                clearValue = clear == "-" ? thresholdValue : std::stof(clear);
+                seconds = std::stod(duration);
+            } catch (const std::exception&) {
+                error = "line " + std::to_string(lineNumber) + ": threshold, clear and for must be numbers";
+                return false;
+            }
+            if (condition == "falls_by") {
+                // "falls by more than x" is "changes by less than -x".
+                thresholdValue = -thresholdValue;
+                clearValue = -clearValue;
+            }
+            instruction.threshold = instruction.sign * thresholdValue;
+            instruction.clear = instruction.sign * clearValue;
+            if (instruction.clear > instruction.threshold) {
+                error = "line " + std::to_string(lineNumber) + ": clear level " + clear + " is on the alert side of " +
+                        threshold;
+                return false;
+            }
+            instruction.holdTicks = 1 + (uint32_t)std::max(0.0, std::ceil(seconds / tickSeconds - 1e-9));
+            instruction.rule = (uint32_t)names.size();
+            names.push_back(name);
+
+            std::vector<uint32_t> ruleActions;
+            std::istringstream actionNames(actionList);
+            std::string actionName;
+            while (std::getline(actionNames, actionName, ',')) {
+                if (!actionName.empty()) {
+                    ruleActions.push_back(intern(actionName));
+                }
+            }
+            actions.push_back(ruleActions);
+            compiled.push_back(instruction);
+        }
+        std::stable_sort(compiled.begin(), compiled.end(),
+                         [](const Instruction& a, const Instruction& b) { return a.column < b.column; });
+        program = compiled;
+        ruleNames = names;
+        ruleActions = actions;
+        fieldCount = 0;
+        return true;
+    }
+
+    bool load(const std::string& path, std::string& error) {
+        std::ifstream fin(path);
+        if (!fin) {
+            error = "cannot open " + path;
+            return false;
+        }
+        std::stringstream text;
+        text << fin.rdbuf();
+        return compile(text.str(), error);
+    }
+
+    /*
+    evaluate(): runs one tick of every rule over `count` fields, where `metrics[m][i]` is metric m of field i, and
+    appends the actions of the rules that fired to `fired`. The first call (and the first after a change in the
+    number of fields) only records the readings for the rate rules.
+    */
+    void evaluate(const float* const* metrics, size_t count, std::vector<AlertAction>& fired) {
+        size_t metricCount = metricNames.size();
+        bool first = count != fieldCount;
+        if (first) {
+            resize(count);
+        }
+        for (size_t m = 0; m < metricCount; m++) {
+            const float* current = metrics[m];
+            float* previous = previousValues[m].data();
+            float* rate = rates[m].data();
+            float scale = (float)(1.0 / tickSeconds);
+            for (size_t i = 0; i < count; i++) {
+                rate[i] = first ? 0.0f : (current[i] - previous[i]) * scale;
+                previous[i] = current[i];
+            }
+        }
+
+        for (size_t r = 0; r < program.size(); r++) {
+            const Instruction& instruction = program[r];
+            const float* column = instruction.column < (int)metricCount ? metrics[instruction.column]
+                                                                          : rates[instruction.column - metricCount].data();
+            uint32_t* held = heldTicks[r].data();
+            uint8_t* active = alertActive[r].data();
+            uint8_t* fire = firing.data();
+            float sign = instruction.sign;
+            float threshold = instruction.threshold;
+            float clear = instruction.clear;
+            uint32_t holdTicks = instruction.holdTicks;
+            uint32_t anyFired = 0;
+            for (size_t i = 0; i < count; i++) {
+                float value = sign * column[i];
+                uint32_t holding = value > threshold;
+                uint32_t h = holding ? std::min(held[i] + 1, holdTicks) : 0;
+                uint32_t was = active[i];
+                uint32_t fires = (was == 0) & (h >= holdTicks);
+                uint32_t releases = (was != 0) & (value <= clear);
+                held[i] = h;
+                active[i] = (uint8_t)(fires | (was & (releases ^ 1)));
+                fire[i] = (uint8_t)fires;
+                anyFired |= fires;
+            }
+            if (anyFired) {
+                for (size_t i = 0; i < count; i++) {
+                    if (fire[i]) {
+                        for (uint32_t action : ruleActions[instruction.rule]) {
+                            fired.push_back(AlertAction{instruction.rule, action, (uint32_t)i, column[i]});
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    size_t ruleCount() const {
+        return program.size();
+    }
+
+    const std::string& ruleName(uint32_t rule) const {
+        return ruleNames[rule];
+    }
+
+    const std::vector<std::string>& actionNames() const {
+        return actions;
+    }
+
+    // actionId(): id of an action name used by the rules, or -1 if none uses it.
+    int actionId(const std::string& name) const {
+        auto it = std::find(actions.begin(), actions.end(), name);
+        return it == actions.end() ? -1 : (int)(it - actions.begin());
+    }
+
+private:
+    struct Instruction {
+        int column = 0;             // metric index, or metric count + metric index for its rate.
+        float sign = 1.0f;
+        float threshold = 0.0f;     // fires while sign * value > threshold ...
+        float clear = 0.0f;         // ... and re-arms once sign * value <= clear.
+        uint32_t holdTicks = 1;     // ticks the condition must hold to fire.
+        uint32_t rule = 0;
+    };
+
+    std::vector<std::string> metricNames;
+    double tickSeconds;
+    std::vector<Instruction> program;
+    std::vector<std::string> ruleNames;
+    std::vector<std::vector<uint32_t>> ruleActions;     // by rule.
+    std::vector<std::string> actions;                   // action names, by id.
+
+    size_t fieldCount = 0;
+    std::vector<std::vector<float>> previousValues;     // by metric, then field.
+    std::vector<std::vector<float>> rates;
+    std::vector<std::vector<uint32_t>> heldTicks;       // by instruction, then field.
+    std::vector<std::vector<uint8_t>> alertActive;
+    std::vector<uint8_t> firing;
+
+    uint32_t intern(const std::string& name) {
+        auto it = std::find(actions.begin(), actions.end(), name);
+        if (it != actions.end()) {
+            return (uint32_t)(it - actions.begin());
+        }
+        actions.push_back(name);
+        return (uint32_t)actions.size() - 1;
+    }
+
+    void resize(size_t count) {
+        fieldCount = count;
+        previousValues.assign(metricNames.size(), std::vector<float>(count, 0.0f));
+        rates.assign(metricNames.size(), std::vector<float>(count, 0.0f));
+        heldTicks.assign(program.size(), std::vector<uint32_t>(count, 0));
+        alertActive.assign(program.size(), std::vector<uint8_t>(count, 0));
+        firing.assign(count, 0);
+    }
+};
+
+/*
+`AlertActionQueue` runs matched actions on its own thread, so a slow action (an alarm, a notification) never delays
+rule evaluation. The queue is bounded: when `capacity` actions are waiting, new ones are dropped and counted.
+Handlers are registered per action id before `start()`; actions without a handler are only counted. `runNow()`
+runs actions on the caller's thread instead, for simulations that must handle them in a fixed order.
+*/
+class AlertActionQueue {
+public:
+    using Handler = std::function<void(const AlertAction&)>;
+
+    explicit AlertActionQueue(size_t capacity = 1 << 16) : capacity(capacity) {
+    }
+
+    ~AlertActionQueue() {
+        stop();
+    }
+
+    void setHandler(int action, Handler handler) {
+        if (action < 0) {
+            return;
+        }
+        if ((size_t)action >= handlers.size()) {
+            handlers.resize(action + 1);
+        }
+        handlers[action] = std::move(handler);
+    }
+
+    bool hasHandler(int action) const {
+        return action >= 0 && (size_t)action < handlers.size() && handlers[action];
+    }
+
+    void start() {
+        stopping = false;
+        worker = std::thread(&AlertActionQueue::workerLoop, this);
+    }
+
+    // push(): queues a tick's actions; returns how many were dropped because the queue was full.
+    size_t push(const std::vector<AlertAction>& batch) {
+        if (batch.empty()) {
+            return 0;
+        }
+        size_t droppedNow = 0;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (const AlertAction& action : batch) {
+                if (pending.size() >= capacity) {
+                    droppedNow++;
+                    continue;
+                }
+                pending.push_back(action);
+            }
+            queued += batch.size() - droppedNow;
+            dropped += droppedNow;
+        }
+        wake.notify_one();
+        return droppedNow;
+    }
+
+    // runNow(): runs a tick's actions on the calling thread, without the queue.
+    void runNow(const std::vector<AlertAction>& batch) {
+        for (const AlertAction& action : batch) {
+            run(action);
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        queued += batch.size();
+    }
+
+    // stop(): runs the actions still queued, then stops the thread.
+    void stop() {
+        if (!worker.joinable()) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        worker.join();
+    }
+
+    uint64_t queuedCount() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return queued;
+    }
+
+    uint64_t droppedCount() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return dropped;
+    }
+
+private:
+    size_t capacity;
+    std::vector<Handler> handlers;          // by action id.
+    std::deque<AlertAction> pending;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::thread worker;
+    uint64_t queued = 0;
+    uint64_t dropped = 0;
+    bool stopping = false;
+
+    void workerLoop() {
+        std::vector<AlertAction> batch;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wake.wait(lock, [this] { return stopping || !pending.empty(); });
+            if (pending.empty()) {
+                return;
+            }
+            batch.assign(pending.begin(), pending.end());
+            pending.clear();
+            lock.unlock();
+            for (const AlertAction& action : batch) {
+                run(action);
+            }
+            lock.lock();
+        }
+    }
+
+    void run(const AlertAction& action) {
+        if (action.action < handlers.size() && handlers[action.action]) {
+            handlers[action.action](action);
+        }
+    }
+};
+
+#endif
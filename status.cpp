@@ -0,0 +1,108 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include "status_shm.h"
+
+using namespace std;
+
+// Live status reader
+/*
+Prints one consistent snapshot of the shared-memory status that chms publishes (see status_shm.h):
+
+    status [--name crop_status] [--field N]... [--all] [--json]
+
+By default it prints when the status was last updated, the minimum, mean and maximum levels over all plots (when
+there are several) and the levels of plot 0. `--field N` (repeatable) prints other plots instead and `--all` prints
+every plot. `--json` prints the same as JSON: for a single plot an object with the `soil_moisture_level` and
+`ph_level` keys of data.json, otherwise one with a `levels` array.
+*/
+int main(int argc, char* argv[]) {
+    string name = DEFAULT_STATUS_NAME;
+    vector<size_t> fields;
+    bool all = false;
+    bool json = false;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--name" && i + 1 < argc) {
+            name = argv[++i];
+        } else if (arg == "--field" && i + 1 < argc) {
+            fields.push_back(stoul(argv[++i]));
+        } else if (arg == "--all") {
+            all = true;
+        } else if (arg == "--json") {
+            json = true;
+        } else {
+            cerr << "Usage: " << argv[0] << " [--name crop_status] [--field N]... [--all] [--json]\n";
+            return 1;
+        }
+    }
+
+    StatusReader reader;
+    if (!reader.open(name)) {
+        cerr << "No status " << name << " (is chms running?)" << endl;
+        return 1;
+    }
+    StatusSnapshot snapshot;
+    auto startTime = chrono::steady_clock::now();
+    if (!reader.snapshot(snapshot)) {
+        cerr << "Status " << name << " is being updated too fast to read" << endl;
+        return 1;
+    }
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - startTime).count();
+
+    size_t count = snapshot.soilMoistureLevel.size();
+    if (all) {
+        fields.clear();
+        for (size_t f = 0; f < count; f++) {
+            fields.push_back(f);
+        }
+    } else if (fields.empty() && count > 0) {
+        fields.push_back(0);
+    }
+    for (size_t f : fields) {
+        if (f >= count) {
+            cerr << "No field " << f << " (there are " << count << ")" << endl;
+            return 1;
+        }
+    }
+
+    if (json) {
+        cout << "{\"time\": " << snapshot.time << ", \"updates\": " << snapshot.updates << ", \"fields\": " << count;
+        if (fields.size() == 1) {
+            cout << ", \"soil_moisture_level\": " << snapshot.soilMoistureLevel[fields[0]]
+                 << ", \"ph_level\": " << snapshot.phLevel[fields[0]] << "}" << endl;
+            return 0;
+        }
+        cout << ", \"levels\": [";
+        for (size_t i = 0; i < fields.size(); i++) {
+            cout << (i > 0 ? ", " : "") << "{\"field\": " << fields[i] << ", \"soil_moisture_level\": "
+                 << snapshot.soilMoistureLevel[fields[i]] << ", \"ph_level\": " << snapshot.phLevel[fields[i]] << "}";
+        }
+        cout << "]}" << endl;
+        return 0;
+    }
+
+    int64_t now = chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count();
+    cout << name << ": " << count << " fields, update " << snapshot.updates << " at " << snapshot.time << " ms ("
+         << (now - snapshot.time) / 1000.0 << " s ago), read in " << ms << " ms" << endl;
+    if (count > 1) {
+        const vector<float>* levels[2] = {&snapshot.soilMoistureLevel, &snapshot.phLevel};
+        const char* names[2] = {"soil_moisture_level", "ph_level"};
+        for (int v = 0; v < 2; v++) {
+            auto range = minmax_element(levels[v]->begin(), levels[v]->end());
+            double sum = 0.0;
+            for (float level : *levels[v]) {
+                sum += level;
+            }
+            cout << names[v] << ": min " << *range.first << ", mean " << sum / count << ", max " << *range.second
+                 << endl;
+        }
+    }
+    for (size_t f : fields) {
+        cout << "field " << f << ": soil_moisture_level " << snapshot.soilMoistureLevel[f] << ", ph_level "
+             << snapshot.phLevel[f] << endl;
+    }
+    return 0;
+}
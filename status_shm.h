@@ -0,0 +1,303 @@
+#ifndef STATUS_SHM_H
+#define STATUS_SHM_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*
+Live crop status in shared memory, so readers get the current soil moisture and pH of every plot without going
+through the filesystem.
+
+The region (POSIX shared memory object `/<name>`, or the `Local\<name>` file mapping on Windows) holds a StatusHeader
+followed by two float arrays, the soil moisture levels of all plots and then their pH levels. One writer, the
+StatusPublisher, overwrites the arrays on every update under a seqlock: it makes the header's sequence number odd,
+copies the new levels in and makes it even again. A StatusReader copies the arrays out and keeps the copy only if
+the sequence number was even and unchanged across the copy; otherwise an update overlapped it and it copies again.
+Readers never block the writer or each other and only retry while an update is in progress, so a snapshot is always
+one consistent update, never a half-written one.
+
+On POSIX the region outlives the writer, so the last status stays readable after chms exits; each publisher replaces
+it when it opens. On Windows it disappears when the last process using it closes it.
+*/
+
+const char STATUS_MAGIC[4] = {'C', 'R', 'S', 'T'};
+const uint32_t STATUS_VERSION = 1;
+const char* const DEFAULT_STATUS_NAME = "crop_status";
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "the seqlock needs lock-free 64-bit atomics");
+
+struct StatusHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t fieldCount;
+    std::atomic<uint64_t> sequence;     // odd while an update is being written.
+    int64_t time;                       // milliseconds since the Unix epoch of the last update.
+    uint64_t updates;                   // updates published since the region was created.
+    char reserved[24];
+};
+static_assert(sizeof(StatusHeader) == 64, "the levels start on their own cache line");
+
+inline size_t statusRegionSize(uint64_t fieldCount) {
+    return sizeof(StatusHeader) + 2 * fieldCount * sizeof(float);
+}
+
+// one consistent copy of (part of) the region: the levels of plots [first, first + soilMoistureLevel.size()).
+struct StatusSnapshot {
+    int64_t time = 0;
+    uint64_t updates = 0;
+    uint64_t fieldCount = 0;
+    size_t first = 0;
+    std::vector<float> soilMoistureLevel;
+    std::vector<float> phLevel;
+};
+
+// the mapping of a region, shared by the writer and the readers.
+class StatusMapping {
+public:
+    StatusMapping() = default;
+    StatusMapping(const StatusMapping&) = delete;
+    StatusMapping& operator=(const StatusMapping&) = delete;
+
+    ~StatusMapping() {
+        close();
+    }
+
+    bool create(const std::string& name, size_t size) {
+        close();
+#ifdef _WIN32
+        handle = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, (DWORD)((uint64_t)size >> 32),
+                                    (DWORD)size, ("Local\\" + name).c_str());
+        if (handle == nullptr) {
+            return false;
+        }
+        address = MapViewOfFile(handle, FILE_MAP_ALL_ACCESS, 0, 0, size);
+#else
+        std::string path = "/" + name;
+        shm_unlink(path.c_str());           // readers still mapping the old region keep it until they reopen.
+        int fd = shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+        if (fd < 0) {
+            return false;
+        }
+        if (ftruncate(fd, (off_t)size) != 0) {
+            ::close(fd);
+            return false;
+        }
+        address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (address == MAP_FAILED) {
+            address = nullptr;
+        }
+#endif
+        mappedSize = size;
+        if (address == nullptr) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    bool openReadOnly(const std::string& name) {
+        close();
+#ifdef _WIN32
+        handle = OpenFileMappingA(FILE_MAP_READ, FALSE, ("Local\\" + name).c_str());
+        if (handle == nullptr) {
+            return false;
+        }
+        address = MapViewOfFile(handle, FILE_MAP_READ, 0, 0, 0);
+        MEMORY_BASIC_INFORMATION info;
+        if (address != nullptr && VirtualQuery(address, &info, sizeof(info)) != 0) {
+            mappedSize = info.RegionSize;
+        }
+#else
+        int fd = shm_open(("/" + name).c_str(), O_RDONLY, 0);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        mappedSize = (size_t)info.st_size;
+        address = mmap(nullptr, mappedSize, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (address == MAP_FAILED) {
+            address = nullptr;
+        }
+#endif
+        if (address == nullptr) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+#ifdef _WIN32
+        if (address != nullptr) {
+            UnmapViewOfFile(address);
+        }
+        if (handle != nullptr) {
+            CloseHandle(handle);
+            handle = nullptr;
+        }
+#else
+        if (address != nullptr) {
+            munmap(address, mappedSize);
+        }
+#endif
+        address = nullptr;
+        mappedSize = 0;
+    }
+
+    void* data() const {
+        return address;
+    }
+
+    size_t size() const {
+        return mappedSize;
+    }
+
+private:
+    void* address = nullptr;
+    size_t mappedSize = 0;
+#ifdef _WIN32
+    HANDLE handle = nullptr;
+#endif
+};
+
+// StatusPublisher: the single writer of a region.
+class StatusPublisher {
+public:
+    // open(): replaces the region `name` with one for `fieldCount` plots, all levels 0 and no updates yet.
+    bool open(const std::string& name, size_t fieldCount) {
+        if (!mapping.create(name, statusRegionSize(fieldCount))) {
+            return false;
+        }
+        header = static_cast<StatusHeader*>(mapping.data());
+        std::memset(static_cast<void*>(header), 0, mapping.size());
+        header->version = STATUS_VERSION;
+        header->fieldCount = fieldCount;
+        header->sequence.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(header->magic, STATUS_MAGIC, sizeof(STATUS_MAGIC));      // readers ignore it until now.
+        return true;
+    }
+
+    bool isOpen() const {
+        return header != nullptr;
+    }
+
+    size_t fieldCount() const {
+        return header != nullptr ? (size_t)header->fieldCount : 0;
+    }
+
+    // publish(): the levels of every plot, as of `time`; arrays of fieldCount() values.
+    void publish(const float* soilMoistureLevel, const float* phLevel, int64_t time) {
+        if (header == nullptr) {
+            return;
+        }
+        size_t count = (size_t)header->fieldCount;
+        float* levels = reinterpret_cast<float*>(header + 1);
+        uint64_t sequence = header->sequence.load(std::memory_order_relaxed);
+        header->sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(levels, soilMoistureLevel, count * sizeof(float));
+        std::memcpy(levels + count, phLevel, count * sizeof(float));
+        header->time = time;
+        header->updates++;
+        header->sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    void close() {
+        mapping.close();
+        header = nullptr;
+    }
+
+private:
+    StatusMapping mapping;
+    StatusHeader* header = nullptr;
+};
+
+// StatusReader: the reader library; any number of processes can read a region at once.
+class StatusReader {
+public:
+    // open(): maps the region `name` read-only; false if there is none or it is not a valid status region.
+    bool open(const std::string& name) {
+        if (!mapping.openReadOnly(name)) {
+            return false;
+        }
+        header = static_cast<const StatusHeader*>(mapping.data());
+        if (mapping.size() < sizeof(StatusHeader) || std::memcmp(header->magic, STATUS_MAGIC, 4) != 0 ||
+            header->version != STATUS_VERSION || mapping.size() < statusRegionSize(header->fieldCount)) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    size_t fieldCount() const {
+        return header != nullptr ? (size_t)header->fieldCount : 0;
+    }
+
+    /*
+    snapshot(): copies the levels of plots [first, first + count) (clamped to the plots there are) from one update.
+    Returns false if no consistent copy could be made within `attempts` tries, which only happens if the writer
+    died in the middle of an update or updates faster than the copy takes.
+    */
+    bool snapshot(StatusSnapshot& out, size_t first = 0, size_t count = SIZE_MAX, int attempts = 10000) const {
+        if (header == nullptr) {
+            return false;
+        }
+        size_t fields = (size_t)header->fieldCount;
+        first = std::min(first, fields);
+        count = std::min(count, fields - first);
+        const float* levels = reinterpret_cast<const float*>(header + 1);
+        out.fieldCount = fields;
+        out.first = first;
+        out.soilMoistureLevel.resize(count);
+        out.phLevel.resize(count);
+        for (int attempt = 0; attempt < attempts; attempt++) {
+            uint64_t before = header->sequence.load(std::memory_order_acquire);
+            if (before & 1) {
+                std::this_thread::yield();
+                continue;
+            }
+            std::memcpy(out.soilMoistureLevel.data(), levels + first, count * sizeof(float));
+            std::memcpy(out.phLevel.data(), levels + fields + first, count * sizeof(float));
+            out.time = header->time;
+            out.updates = header->updates;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (header->sequence.load(std::memory_order_relaxed) == before) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void close() {
+        mapping.close();
+        header = nullptr;
+    }
+
+private:
+    StatusMapping mapping;
+    const StatusHeader* header = nullptr;
+};
+
+#endif
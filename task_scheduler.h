@@ -0,0 +1,147 @@
+#ifndef TASK_SCHEDULER_H
+#define TASK_SCHEDULER_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Counts the unfinished tasks spawned into it, so that a parent can wait for exactly its own children.
+class TaskGroup {
+public:
+    std::atomic<int> pending{0};
+};
+
+/*
+`TaskScheduler` is a small work-stealing thread pool. Every worker owns a deque of tasks: it pushes and pops its own
+tasks at the back (newest first, which keeps the traversal depth-first) and, once that is empty, steals from the front
+of another worker's deque (the oldest and usually largest piece of work). A thread that calls `wait()` runs tasks while
+it waits, and the thread that owns the scheduler acts as worker 0, so a pool of N threads starts N - 1 new ones.
+*/
+class TaskScheduler {
+public:
+    explicit TaskScheduler(int threadCount) : queues(std::max(1, threadCount)) {
+        for (int i = 1; i < (int)queues.size(); i++) {
+            workers.emplace_back(&TaskScheduler::workerLoop, this, i);
+        }
+    }
+
+    ~TaskScheduler() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    int threadCount() const {
+        return (int)queues.size();
+    }
+
+    // index of the worker running the calling thread; threads outside this pool count as worker 0.
+    int workerIndex() const {
+        return currentScheduler == this ? currentWorker : 0;
+    }
+
+    void spawn(TaskGroup& group, std::function<void()> task) {
+        group.pending++;
+        WorkQueue& queue = queues[workerIndex()];
+        {
+            std::lock_guard<std::mutex> lock(queue.lock);
+            queue.tasks.push_back(Task{std::move(task), &group});
+        }
+        queued++;
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+        }
+        wake.notify_one();
+    }
+
+    // wait(): runs queued tasks (its own first, then stolen ones) until every task of `group` has finished.
+    void wait(TaskGroup& group) {
+        while (group.pending > 0) {
+            if (!runOne(workerIndex())) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+private:
+    struct Task {
+        std::function<void()> run;
+        TaskGroup* group;
+    };
+
+    struct WorkQueue {
+        std::mutex lock;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<WorkQueue> queues;          // one deque per worker.
+    std::vector<std::thread> workers;       // background workers 1..N-1.
+    std::atomic<int> queued{0};             // tasks sitting in any deque.
+    std::mutex sleepMutex;
+    std::condition_variable wake;           // idle workers sleep here until a task is spawned.
+    bool stopping = false;
+    static inline thread_local const TaskScheduler* currentScheduler = nullptr;
+    static inline thread_local int currentWorker = 0;
+
+    bool runOne(int self) {
+        Task task;
+        if (!popOwn(self, task) && !steal(self, task)) {
+            return false;
+        }
+        queued--;
+        task.run();
+        task.group->pending--;
+        return true;
+    }
+
+    bool popOwn(int self, Task& task) {
+        WorkQueue& queue = queues[self];
+        std::lock_guard<std::mutex> lock(queue.lock);
+        if (queue.tasks.empty()) {
+            return false;
+        }
+        task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+        return true;
+    }
+
+    bool steal(int self, Task& task) {
+        for (int k = 1; k < (int)queues.size(); k++) {
+            WorkQueue& victim = queues[(self + k) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.lock);
+            if (!victim.tasks.empty()) {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void workerLoop(int index) {
+        currentScheduler = this;
+        currentWorker = index;
+        while (true) {
+            if (runOne(index)) {
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wake.wait(lock, [this] { return stopping || queued > 0; });
+            if (stopping) {
+                return;
+            }
+        }
+    }
+};
+
+#endif
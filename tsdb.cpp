@@ -0,0 +1,257 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <climits>
+#include <algorithm>
+#include "rollup.h"
+#include "tsdb.h"
+
+using namespace std;
+
+// Sensor time-series store tool
+/*
+Commands on the store written by chms.cpp (default directory `sensor_tsdb`):
+
+    info                                    blocks, readings, time span and disk usage (store and rollups)
+    scan   [range]                          count, min, max and mean of both levels over the range, and the read time
+    export [range] [--output <file|->]      readings in the range as CSV: time,soil_moisture_level,ph_level
+    query  [range] [--points N]             N points (default 300) summarizing the range, from the rollups (rollup.h)
+    import <sensor_data.csv> [--start MS] [--period-ms P]
+                                            appends a legacy CSV log that has no timestamps, one reading every P ms
+    prune  --before MS                      deletes the segments that only hold readings older than MS
+
+A range is `--from MS` and/or `--to MS` (milliseconds since the Unix epoch), or `--last S`: the S seconds up to the
+newest reading.
+*/
+int main(int argc, char* argv[]) {
+    string directory = "sensor_tsdb";
+    string command;
+    string importPath;
+    string outputPath = "-";
+    int64_t from = INT64_MIN;
+    int64_t to = INT64_MAX;
+    int64_t lastSeconds = -1;
+    int64_t before = INT64_MIN;
+    int64_t importStart = chrono::duration_cast<chrono::milliseconds>(
+                              chrono::system_clock::now().time_since_epoch()).count();
+    int64_t importPeriod = 1000;
+    int points = 300;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--dir" && i + 1 < argc) {
+            directory = argv[++i];
+        } else if (arg == "--from" && i + 1 < argc) {
+            from = stoll(argv[++i]);
+        } else if (arg == "--to" && i + 1 < argc) {
+            to = stoll(argv[++i]);
+        } else if (arg == "--last" && i + 1 < argc) {
+            lastSeconds = max(0LL, stoll(argv[++i]));
+        } else if (arg == "--points" && i + 1 < argc) {
+            points = max(1, stoi(argv[++i]));
+        } else if (arg == "--output" && i + 1 < argc) {
+            outputPath = argv[++i];
+        } else if (arg == "--before" && i + 1 < argc) {
+            before = stoll(argv[++i]);
+        } else if (arg == "--start" && i + 1 < argc) {
+            importStart = stoll(argv[++i]);
+        } else if (arg == "--period-ms" && i + 1 < argc) {
+            importPeriod = max(1LL, stoll(argv[++i]));
+        } else if (command.empty() && arg[0] != '-') {
+            command = arg;
+        } else if (command == "import" && importPath.empty() && arg[0] != '-') {
+            importPath = arg;
+        } else {
+            command.clear();
+            break;
+        }
+    }
+    if (command != "info" && command != "scan" && command != "export" && command != "query" &&
+        (command != "import" || importPath.empty()) &&
+        (command != "prune" || before == INT64_MIN)) {
+        cerr << "Usage: " << argv[0] << " [--dir sensor_tsdb] info\n"
+             << "       " << argv[0] << " [--dir sensor_tsdb] scan [--from MS] [--to MS] [--last S]\n"
+             << "       " << argv[0] << " [--dir sensor_tsdb] export [--from MS] [--to MS] [--last S] [--output <file|->]\n"
+             << "       " << argv[0] << " [--dir sensor_tsdb] query [--from MS] [--to MS] [--last S] [--points N]\n"
+             << "       " << argv[0] << " [--dir sensor_tsdb] import <sensor_data.csv> [--start MS] [--period-ms P]\n"
+             << "       " << argv[0] << " [--dir sensor_tsdb] prune --before MS\n";
+        return 1;
+    }
+
+    TimeSeriesStore store(directory);
+    if (command == "import" || command == "prune") {
+        if (!store.open()) {
+            cerr << "Cannot open " << directory << endl;
+            return 1;
+        }
+    } else if (!store.load()) {
+        cerr << "No store at " << directory << endl;
+        return 1;
+    }
+
+    if (command == "import") {
+        ifstream fin(importPath);
+        if (!fin) {
+            cerr << "Cannot open " << importPath << endl;
+            return 1;
+        }
+        int64_t time = max(importStart, store.lastTime() == INT64_MIN ? importStart : store.lastTime() + importPeriod);
+        SensorRollups rollups(directory);
+        if (!rollups.openForWriting()) {
+            cerr << "Cannot write the rollups in " << directory << endl;
+            return 1;
+        }
+        string line;
+        size_t imported = 0;
+        while (getline(fin, line)) {
+            SensorSample sample{time, 0.0, 0.0};
+            char comma;
+            stringstream fields(line);
+            if (!(fields >> sample.soilMoistureLevel >> comma >> sample.phLevel) || comma != ',') {
+                continue;               // header rows (one per chms run in old logs)
+            }
+            if (store.append(sample)) {
+                rollups.add(sample);
+            }
+            time += importPeriod;
+            imported++;
+        }
+        store.close();
+        rollups.close();
+        cout << "Imported " << imported << " readings from " << importPath << endl;
+        return 0;
+    }
+    if (command == "prune") {
+        size_t removed = store.prune(before);
+        store.close();
+        cout << "Deleted " << removed << " segments" << endl;
+        return 0;
+    }
+
+    size_t sealed = 0;
+    for (const TsdbIndexEntry& entry : store.blocks()) {
+        sealed += entry.count;
+    }
+    if (command == "info") {
+        size_t total = 0;
+        int64_t first = INT64_MAX;
+        int64_t last = INT64_MIN;
+        store.scan(INT64_MIN, INT64_MAX, [&](const SensorSample& sample) {
+            first = min(first, sample.time);
+            last = max(last, sample.time);
+            total++;
+        });
+        uint64_t bytes = store.diskBytes();
+        cout << directory << ": " << store.blocks().size() << " blocks, " << total << " readings (" << total - sealed
+             << " in the head block), " << bytes << " bytes on disk";
+        if (total > 0) {
+            cout << ", " << (double)bytes / total << " bytes/reading, time " << first << " .. " << last << " ms";
+        }
+        cout << "; rollups " << SensorRollups(directory).diskBytes() << " bytes" << endl;
+        return 0;
+    }
+
+    if (lastSeconds >= 0 || (command == "query" && (from == INT64_MIN || to == INT64_MAX))) {
+        // the oldest and newest readings are in the first and last blocks or the head, so only those are read.
+        int64_t oldest = INT64_MAX;
+        int64_t newest = INT64_MIN;
+        int64_t tail = store.blocks().empty() ? INT64_MIN : store.blocks().back().firstTime;
+        store.scan(tail, INT64_MAX, [&](const SensorSample& sample) {
+            oldest = min(oldest, sample.time);
+            newest = max(newest, sample.time);
+        });
+        if (!store.blocks().empty()) {
+            oldest = store.blocks().front().firstTime;
+        }
+        if (newest == INT64_MIN) {
+            cerr << "No readings in " << directory << endl;
+            return 1;
+        }
+        if (lastSeconds >= 0) {
+            to = newest;
+            from = newest - lastSeconds * 1000;
+        } else {
+            from = from == INT64_MIN ? oldest : from;
+            to = to == INT64_MAX ? newest : to;
+        }
+    }
+
+    if (command == "query") {
+        SensorRollups rollups(directory);
+        auto startTime = chrono::steady_clock::now();
+        vector<RollupPoint> result = rollups.query(from, to + 1, points);
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - startTime).count();
+        ofstream fout;
+        if (outputPath != "-") {
+            fout.open(outputPath);
+            if (!fout) {
+                cerr << "Cannot write " << outputPath << endl;
+                return 1;
+            }
+        }
+        ostream& out = outputPath == "-" ? cout : fout;
+        out << "time,count,soil_moisture_min,soil_moisture_max,soil_moisture_mean,soil_moisture_last,"
+            << "ph_min,ph_max,ph_mean,ph_last\n";
+        for (const RollupPoint& point : result) {
+            out << point.start << ',' << point.count;
+            for (int v = 0; v < 2; v++) {
+                out << ',' << point.minimum[v] << ',' << point.maximum[v] << ',' << point.mean[v] << ',' << point.last[v];
+            }
+            out << '\n';
+        }
+        out.flush();
+        if (!out) {
+            cerr << "Cannot write " << outputPath << endl;
+            return 1;
+        }
+        cerr << result.size() << " points over " << (to - from) / 1000.0 << " s in " << ms << " ms" << endl;
+        return 0;
+    }
+
+    if (command == "scan") {
+        size_t count = 0;
+        double minimum[2] = {1e300, 1e300};
+        double maximum[2] = {-1e300, -1e300};
+        double sum[2] = {0.0, 0.0};
+        auto startTime = chrono::steady_clock::now();
+        store.scan(from, to, [&](const SensorSample& sample) {
+            double level[2] = {sample.soilMoistureLevel, sample.phLevel};
+            for (int v = 0; v < 2; v++) {
+                minimum[v] = min(minimum[v], level[v]);
+                maximum[v] = max(maximum[v], level[v]);
+                sum[v] += level[v];
+            }
+            count++;
+        });
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - startTime).count();
+        cout << count << " readings in " << ms << " ms" << endl;
+        const char* names[2] = {"soil_moisture_level", "ph_level"};
+        for (int v = 0; v < 2 && count > 0; v++) {
+            cout << names[v] << ": min " << minimum[v] << ", max " << maximum[v] << ", mean " << sum[v] / count
+                 << endl;
+        }
+        return 0;
+    }
+
+    ofstream fout;
+    if (outputPath != "-") {
+        fout.open(outputPath);
+        if (!fout) {
+            cerr << "Cannot write " << outputPath << endl;
+            return 1;
+        }
+    }
+    ostream& out = outputPath == "-" ? cout : fout;
+    out << "time,soil_moisture_level,ph_level\n";
+    store.scan(from, to, [&](const SensorSample& sample) {
+        out << sample.time << ',' << sample.soilMoistureLevel << ',' << sample.phLevel << '\n';
+    });
+    out.flush();
+    if (!out) {
+        cerr << "Cannot write " << outputPath << endl;
+        return 1;
+    }
+    return 0;
+}
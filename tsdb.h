@@ -0,0 +1,697 @@
+#ifndef TSDB_H
+#define TSDB_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "mapped_file.h"
+#include "model_format.h"
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+/*
+Append-only time-series store for the readings of chms.cpp.
+
+A store is a directory. Readings are grouped into blocks of up to `blockPoints` points or `blockSpan` milliseconds;
+a block is compressed column by column the way Gorilla (Pelkonen et al., VLDB 2015) does it: timestamps as
+delta-of-deltas, which cost one bit per reading on a steady sampling period, and each value column as the XOR with
+the previous value, which costs one bit when a level did not change and only its meaningful bits otherwise.
+
+Sealed blocks are appended to segment files (`segment-000001.tsdb`, ...) that roll over at `segmentBytes`:
+
+    TsdbBlockHeader                      count, first/last time, the size of every column and a CRC-32 of them
+    uint8_t time[columnBytes[0]]         timestamp bit stream
+    uint8_t moisture[columnBytes[1]]     soil moisture bit stream
+    uint8_t ph[columnBytes[2]]           pH bit stream
+
+`index.tsdb` holds one fixed-size TsdbIndexEntry per sealed block, in time order, so a range scan binary-searches the
+index and reads only the blocks that overlap the range: its cost grows with the window, not with the history.
+The block still being filled is kept in `head.tsdb` (same block format, rewritten by `flush()`), so readers in other
+processes see readings within one flush of their arrival. If the index is lost it is rebuilt from the segments.
+*/
+
+// one sensor reading; `time` is in milliseconds since the Unix epoch.
+struct SensorSample {
+    int64_t time;
+    double soilMoistureLevel;
+    double phLevel;
+};
+
+const char TSDB_BLOCK_MAGIC[4] = {'C', 'R', 'P', 'T'};
+const int TSDB_COLUMNS = 3;
+
+struct TsdbBlockHeader {
+    char magic[4];
+    uint32_t count;
+    int64_t firstTime;
+    int64_t lastTime;
+    uint32_t columnBytes[TSDB_COLUMNS];
+    uint32_t checksum;
+};
+
+struct TsdbIndexEntry {
+    int64_t firstTime;
+    int64_t lastTime;
+    uint32_t segment;
+    uint32_t offset;            // of the block header in the segment file.
+    uint32_t length;            // header and columns.
+    uint32_t count;
+};
+
+struct TsdbOptions {
+    uint32_t blockPoints = 4096;                // readings per block at most.
+    int64_t blockSpan = 15 * 60 * 1000;         // milliseconds a block covers at most.
+    uint32_t segmentBytes = 4 << 20;            // size at which a new segment file is started.
+    bool syncWrites = false;                    // fsync every segment, index and head file write.
+};
+
+// tsdbSync(): flushes `file` and forces it to stable storage.
+inline void tsdbSync(std::FILE* file) {
+    std::fflush(file);
+#ifdef _WIN32
+    _commit(_fileno(file));
+#else
+    fsync(fileno(file));
+#endif
+}
+
+// tsdbAppend(): appends `size` bytes to the file at `path`, creating it if needed.
+inline bool tsdbAppend(const std::string& path, const void* data, size_t size, bool sync) {
+    std::FILE* file = std::fopen(path.c_str(), "ab");
+    if (file == nullptr) {
+        return false;
+    }
+    bool ok = std::fwrite(data, 1, size, file) == size;
+    if (sync) {
+        tsdbSync(file);
+    }
+    return std::fclose(file) == 0 && ok;
+}
+
+// `TsdbBitWriter` appends bit fields, most significant bit first.
+class TsdbBitWriter {
+public:
+    std::vector<uint8_t> bytes;
+
+    void write(uint64_t value, int bits) {
+        while (bits > 0) {
+            int used = (int)(bitCount & 7);
+            if (used == 0) {
+                bytes.push_back(0);
+            }
+            int n = std::min(8 - used, bits);
+            uint8_t field = (uint8_t)((value >> (bits - n)) & ((1u << n) - 1));
+            bytes.back() |= (uint8_t)(field << (8 - used - n));
+            bits -= n;
+            bitCount += n;
+        }
+    }
+
+    void clear() {
+        bytes.clear();
+        bitCount = 0;
+    }
+
+private:
+    uint64_t bitCount = 0;
+};
+
+// `TsdbBitReader` reads what TsdbBitWriter wrote; reading past the end sets `overrun` and yields zero bits.
+class TsdbBitReader {
+public:
+    bool overrun = false;
+
+    TsdbBitReader(const uint8_t* data, size_t size) : data(data), bitSize((uint64_t)size * 8) {
+    }
+
+    uint64_t read(int bits) {
+        uint64_t value = 0;
+        while (bits > 0) {
+            if (position >= bitSize) {
+                overrun = true;
+                return 0;
+            }
+            int used = (int)(position & 7);
+            int n = std::min(8 - used, bits);
+            uint8_t field = (uint8_t)((data[position >> 3] >> (8 - used - n)) & ((1u << n) - 1));
+            value = (value << n) | field;
+            bits -= n;
+            position += n;
+        }
+        return value;
+    }
+
+private:
+    const uint8_t* data;
+    uint64_t bitSize;
+    uint64_t position = 0;
+};
+
+/*
+`TsdbBlockEncoder` compresses readings as they arrive. The first timestamp is kept in the block header; every later
+one is written as the change of its delta: '0' for no change, then '10', '110' and '1110' followed by 7, 9 and 12
+bits, and '1111' followed by 64 bits. Values are XORed with their predecessor: '0' if equal, '10' and the XOR's
+meaningful bits if they fit in the previous leading/trailing zero window, else '11', 5 bits of leading zeros, 6 bits
+of length and the meaningful bits. Unlike the paper, a much narrower XOR gets a new window even when it fits the old
+one; on chms readings that halves the size of the moisture column.
+*/
+class TsdbBlockEncoder {
+public:
+    uint32_t count = 0;
+    int64_t firstTime = 0;
+    int64_t lastTime = 0;
+
+    void append(const SensorSample& sample) {
+        if (count == 0) {
+            firstTime = sample.time;
+        } else {
+            int64_t delta = sample.time - lastTime;
+            writeDeltaOfDelta(delta - previousDelta);
+            previousDelta = delta;
+        }
+        lastTime = sample.time;
+        moisture.append(columns[1], sample.soilMoistureLevel);
+        ph.append(columns[2], sample.phLevel);
+        count++;
+    }
+
+    // bytes(): the block in its on-disk form, header first.
+    std::vector<uint8_t> bytes() const {
+        TsdbBlockHeader header;
+        memcpy(header.magic, TSDB_BLOCK_MAGIC, sizeof(header.magic));
+        header.count = count;
+        header.firstTime = firstTime;
+        header.lastTime = lastTime;
+        uint32_t crc = 0;
+        for (int c = 0; c < TSDB_COLUMNS; c++) {
+            header.columnBytes[c] = (uint32_t)columns[c].bytes.size();
+            crc = modelChecksum(columns[c].bytes.data(), columns[c].bytes.size(), crc);
+        }
+        header.checksum = crc;
+        std::vector<uint8_t> block(sizeof(header));
+        memcpy(block.data(), &header, sizeof(header));
+        for (int c = 0; c < TSDB_COLUMNS; c++) {
+            block.insert(block.end(), columns[c].bytes.begin(), columns[c].bytes.end());
+        }
+        return block;
+    }
+
+    void clear() {
+        *this = TsdbBlockEncoder();
+    }
+
+private:
+    struct XorState {
+        uint64_t previous = 0;
+        int leading = -1;           // zero window of the last XOR written with its own window; -1 before the first.
+        int trailing = 0;
+
+        void append(TsdbBitWriter& out, double value) {
+            uint64_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            uint64_t x = bits ^ previous;
+            previous = bits;
+            if (x == 0) {
+                out.write(0, 1);
+                return;
+            }
+            int lead = std::min(__builtin_clzll(x), 31);
+            int trail = __builtin_ctzll(x);
+            int meaningful = 64 - lead - trail;
+            // reuse the previous window only while that is cheaper than sending a new one (11 bits more).
+            if (leading >= 0 && lead >= leading && trail >= trailing && 64 - leading - trailing <= meaningful + 11) {
+                out.write(2, 2);
+                out.write(x >> trailing, 64 - leading - trailing);
+                return;
+            }
+            out.write(3, 2);
+            out.write((uint64_t)lead, 5);
+            out.write((uint64_t)(meaningful - 1), 6);
+            out.write(x >> trail, meaningful);
+            leading = lead;
+            trailing = trail;
+        }
+    };
+
+    TsdbBitWriter columns[TSDB_COLUMNS];
+    XorState moisture;
+    XorState ph;
+    int64_t previousDelta = 0;
+
+    void writeDeltaOfDelta(int64_t dod) {
+        TsdbBitWriter& out = columns[0];
+        if (dod == 0) {
+            out.write(0, 1);
+        } else if (dod >= -63 && dod <= 64) {
+            out.write(2, 2);
+            out.write((uint64_t)(dod + 63), 7);
+        } else if (dod >= -255 && dod <= 256) {
+            out.write(6, 3);
+            out.write((uint64_t)(dod + 255), 9);
+        } else if (dod >= -2047 && dod <= 2048) {
+            out.write(14, 4);
+            out.write((uint64_t)(dod + 2047), 12);
+        } else {
+            out.write(15, 4);
+            out.write((uint64_t)dod, 64);
+        }
+    }
+};
+
+/*
+decodeTsdbBlock(): appends the readings of the block at `data` to `out`; false (and nothing appended) if the block
+is truncated, fails its checksum or does not decode to `count` readings.
+*/
+inline bool decodeTsdbBlock(const uint8_t* data, size_t size, std::vector<SensorSample>& out) {
+    TsdbBlockHeader header;
+    if (size < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, TSDB_BLOCK_MAGIC, sizeof(header.magic)) != 0 || header.count == 0) {
+        return false;
+    }
+    const uint8_t* column[TSDB_COLUMNS];
+    size_t offset = sizeof(header);
+    for (int c = 0; c < TSDB_COLUMNS; c++) {
+        if (header.columnBytes[c] > size - offset) {
+            return false;
+        }
+        column[c] = data + offset;
+        offset += header.columnBytes[c];
+    }
+    if (modelChecksum(data + sizeof(header), offset - sizeof(header)) != header.checksum) {
+        return false;
+    }
+
+    TsdbBitReader times(column[0], header.columnBytes[0]);
+    TsdbBitReader values[2] = {TsdbBitReader(column[1], header.columnBytes[1]),
+                               TsdbBitReader(column[2], header.columnBytes[2])};
+    uint64_t previous[2] = {0, 0};
+    int leading[2] = {0, 0};
+    int trailing[2] = {0, 0};
+    int64_t time = header.firstTime;
+    int64_t delta = 0;
+    size_t start = out.size();
+    for (uint32_t i = 0; i < header.count; i++) {
+        if (i > 0) {
+            int64_t dod;
+            if (times.read(1) == 0) {
+                dod = 0;
+            } else if (times.read(1) == 0) {
+                dod = (int64_t)times.read(7) - 63;
+            } else if (times.read(1) == 0) {
+                dod = (int64_t)times.read(9) - 255;
+            } else if (times.read(1) == 0) {
+                dod = (int64_t)times.read(12) - 2047;
+            } else {
+                dod = (int64_t)times.read(64);
+            }
+            delta += dod;
+            time += delta;
+        }
+        double level[2];
+        for (int v = 0; v < 2; v++) {
+            TsdbBitReader& in = values[v];
+            if (in.read(1) != 0) {
+                if (in.read(1) != 0) {
+                    leading[v] = (int)in.read(5);
+                    int meaningful = (int)in.read(6) + 1;
+                    trailing[v] = 64 - leading[v] - meaningful;
+                    if (trailing[v] < 0) {
+                        out.resize(start);
+                        return false;
+                    }
+                }
+                previous[v] ^= in.read(64 - leading[v] - trailing[v]) << trailing[v];
+            }
+            memcpy(&level[v], &previous[v], sizeof(double));
+        }
+        out.push_back(SensorSample{time, level[0], level[1]});
+    }
+    if (times.overrun || values[0].overrun || values[1].overrun || time != header.lastTime) {
+        out.resize(start);
+        return false;
+    }
+    return true;
+}
+
+/*
+`TimeSeriesStore` is the store directory. One process appends (chms.cpp's log writer); any number may scan. Readings
+must arrive in strictly increasing time order: `append()` rejects one that is not newer than the last, since the
+head recovery in open() and scan() tell sealed readings from head ones by time.
+*/
+class TimeSeriesStore {
+public:
+    explicit TimeSeriesStore(std::string directory, const TsdbOptions& options = TsdbOptions())
+        : directory(std::move(directory)), options(options) {
+    }
+
+    ~TimeSeriesStore() {
+        close();
+    }
+
+    // open(): creates the directory if needed and loads the index (rebuilding it if missing) and the head block.
+    bool open() {
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+        if (!std::filesystem::is_directory(directory)) {
+            return false;
+        }
+        index.clear();
+        head.clear();
+        if (!loadIndex()) {
+            rebuildIndex();
+            writeIndex();
+        }
+        MappedFile headFile;
+        std::vector<SensorSample> pending;
+        if (headFile.open(path("head.tsdb")) && headFile.size() > 0) {
+            decodeTsdbBlock(reinterpret_cast<const uint8_t*>(headFile.data()), headFile.size(), pending);
+        }
+        for (const SensorSample& sample : pending) {
+            if (sample.time > lastTime()) {         // a crash may leave a head that was already sealed.
+                head.append(sample);
+            }
+        }
+        opened = true;
+        return true;
+    }
+
+    /*
+    append(): adds a reading to the head block, sealing the block first if it is full or spans too long. If the seal
+    fails (e.g. the disk is full) the reading still goes into the head, which flush() keeps writing, and the next
+    append() retries the seal, so no reading is lost. False only if the reading is not newer than the last one.
+    */
+    bool append(const SensorSample& sample) {
+        if (sample.time <= lastTime()) {
+            return false;
+        }
+        if (head.count > 0 && (head.count >= options.blockPoints || sample.time - head.firstTime >= options.blockSpan)) {
+            seal();
+        }
+        head.append(sample);
+        headDirty = true;
+        return true;
+    }
+
+    // flush(): makes the head block visible to readers by rewriting head.tsdb.
+    bool flush() {
+        if (!headDirty) {
+            return true;
+        }
+        headDirty = false;
+        std::string headPath = path("head.tsdb");
+        if (head.count == 0) {
+            std::remove(headPath.c_str());
+            return true;
+        }
+        return writeFile(headPath, head.bytes(), options.syncWrites);
+    }
+
+    // close(): seals the head block into a segment, so a closed store has no head file; `sync` forces that to disk.
+    bool close(bool sync = false) {
+        if (!opened) {
+            return true;
+        }
+        opened = false;
+        options.syncWrites = options.syncWrites || sync;
+        bool ok = head.count == 0 || seal();
+        headDirty = true;
+        return flush() && ok;
+    }
+
+    /*
+    scan(): calls `visit(sample)` for every reading with `from <= time <= to`, in time order, and returns how many
+    there were. Reads only the index entries and blocks that overlap the range, plus the head block.
+    */
+    template <typename Visit>
+    size_t scan(int64_t from, int64_t to, Visit visit) const {
+        size_t visited = 0;
+        std::vector<SensorSample> samples;
+        auto emit = [&] {
+            for (const SensorSample& sample : samples) {
+                if (sample.time >= from && sample.time <= to) {
+                    visit(sample);
+                    visited++;
+                }
+            }
+            samples.clear();
+        };
+
+        auto first = std::lower_bound(index.begin(), index.end(), from,
+                                      [](const TsdbIndexEntry& entry, int64_t t) { return entry.lastTime < t; });
+        MappedFile segment;
+        uint32_t mappedSegment = 0;
+        for (auto entry = first; entry != index.end() && entry->firstTime <= to; ++entry) {
+            if (mappedSegment != entry->segment) {
+                mappedSegment = segment.open(segmentPath(entry->segment)) ? entry->segment : 0;
+            }
+            if (mappedSegment == 0 || (uint64_t)entry->offset + entry->length > segment.size()) {
+                continue;
+            }
+            decodeTsdbBlock(reinterpret_cast<const uint8_t*>(segment.data()) + entry->offset, entry->length, samples);
+            emit();
+        }
+
+        int64_t lastSealed = index.empty() ? INT64_MIN : index.back().lastTime;
+        if (opened) {
+            if (head.count > 0 && head.lastTime >= from && head.firstTime <= to) {
+                std::vector<uint8_t> block = head.bytes();
+                decodeTsdbBlock(block.data(), block.size(), samples);
+            }
+        } else {
+            MappedFile headFile;
+            if (headFile.open(path("head.tsdb")) && headFile.size() > 0) {
+                decodeTsdbBlock(reinterpret_cast<const uint8_t*>(headFile.data()), headFile.size(), samples);
+            }
+        }
+        // the writer may have sealed the head since the index was read; its readings are in a block already.
+        samples.erase(std::remove_if(samples.begin(), samples.end(),
+                                     [lastSealed](const SensorSample& sample) { return sample.time <= lastSealed; }),
+                      samples.end());
+        emit();
+        return visited;
+    }
+
+    // load(): opens an existing store for reading only; unlike open() it never creates or rewrites anything.
+    bool load() {
+        index.clear();
+        head.clear();
+        if (!std::filesystem::is_directory(directory)) {
+            return false;
+        }
+        if (!loadIndex()) {
+            rebuildIndex();
+        }
+        return true;
+    }
+
+    /*
+    prune(): deletes the segments whose readings are all older than `before` and drops their blocks from the index.
+    Returns the number of segments deleted.
+    */
+    size_t prune(int64_t before) {
+        uint32_t keepFrom = 0;
+        for (const TsdbIndexEntry& entry : index) {
+            if (entry.lastTime >= before) {
+                keepFrom = entry.segment;
+                break;
+            }
+        }
+        if (keepFrom == 0 && !index.empty()) {
+            keepFrom = index.back().segment;        // the segment being appended to is always kept.
+        }
+        size_t removed = 0;
+        for (uint32_t segment : segmentNumbers()) {
+            if (segment < keepFrom && std::remove(segmentPath(segment).c_str()) == 0) {
+                removed++;
+            }
+        }
+        index.erase(std::remove_if(index.begin(), index.end(),
+                                   [keepFrom](const TsdbIndexEntry& entry) { return entry.segment < keepFrom; }),
+                    index.end());
+        writeIndex();
+        return removed;
+    }
+
+    const std::vector<TsdbIndexEntry>& blocks() const {
+        return index;
+    }
+
+    uint32_t headCount() const {
+        return head.count;
+    }
+
+    int64_t firstTime() const {
+        return !index.empty() ? index.front().firstTime : head.firstTime;
+    }
+
+    int64_t lastTime() const {
+        if (head.count > 0) {
+            return head.lastTime;
+        }
+        return index.empty() ? INT64_MIN : index.back().lastTime;
+    }
+
+    // diskBytes(): size of the segments, the index and the head file; other files in the directory are not counted.
+    uint64_t diskBytes() const {
+        std::vector<std::string> files = {path("index.tsdb"), path("head.tsdb")};
+        for (uint32_t segment : segmentNumbers()) {
+            files.push_back(segmentPath(segment));
+        }
+        uint64_t total = 0;
+        for (const std::string& file : files) {
+            std::error_code error;
+            uint64_t size = std::filesystem::file_size(file, error);
+            total += error ? 0 : size;
+        }
+        return total;
+    }
+
+private:
+    std::string directory;
+    TsdbOptions options;
+    std::vector<TsdbIndexEntry> index;          // sealed blocks in time order.
+    TsdbBlockEncoder head;                      // block being filled.
+    bool headDirty = false;                     // head changed since head.tsdb was written.
+    bool opened = false;
+
+    std::string path(const char* name) const {
+        return (std::filesystem::path(directory) / name).string();
+    }
+
+    std::string segmentPath(uint32_t segment) const {
+        char name[32];
+        snprintf(name, sizeof(name), "segment-%06u.tsdb", segment);
+        return path(name);
+    }
+
+    std::vector<uint32_t> segmentNumbers() const {
+        std::vector<uint32_t> numbers;
+        std::error_code error;
+        for (const auto& file : std::filesystem::directory_iterator(directory, error)) {
+            unsigned number;
+            std::string name = file.path().filename().string();
+            if (sscanf(name.c_str(), "segment-%u.tsdb", &number) == 1 && number > 0) {
+                numbers.push_back(number);
+            }
+        }
+        std::sort(numbers.begin(), numbers.end());
+        return numbers;
+    }
+
+    static bool writeFile(const std::string& filePath, const std::vector<uint8_t>& bytes, bool sync) {
+        std::string temporaryPath = filePath + ".tmp";
+        std::remove(temporaryPath.c_str());
+        if (!tsdbAppend(temporaryPath, bytes.data(), bytes.size(), sync)) {
+            return false;
+        }
+#ifdef _WIN32
+        std::remove(filePath.c_str());  // only POSIX rename() replaces an existing file, and atomically.
+#endif
+        return std::rename(temporaryPath.c_str(), filePath.c_str()) == 0;
+    }
+
+    // seal(): appends the head block to the current segment (starting a new one if it is full) and to the index.
+    bool seal() {
+        std::vector<uint8_t> block = head.bytes();
+        uint32_t segment = index.empty() ? 1 : index.back().segment;
+        std::error_code error;
+        uint64_t segmentSize = std::filesystem::file_size(segmentPath(segment), error);
+        if (error) {
+            segmentSize = 0;
+        }
+        if (segmentSize > 0 && segmentSize + block.size() > options.segmentBytes) {
+            segment++;
+            segmentSize = 0;
+        }
+        if (!tsdbAppend(segmentPath(segment), block.data(), block.size(), options.syncWrites)) {
+            return false;
+        }
+        TsdbIndexEntry entry{head.firstTime, head.lastTime, segment, (uint32_t)segmentSize, (uint32_t)block.size(),
+                             head.count};
+        if (!tsdbAppend(path("index.tsdb"), &entry, sizeof(entry), options.syncWrites)) {
+            // keep the readings in the head and drop the unindexed block, so the next seal() writes it again.
+            std::filesystem::resize_file(segmentPath(segment), segmentSize, error);
+            return false;
+        }
+        index.push_back(entry);
+        head.clear();
+        headDirty = true;
+        return true;
+    }
+
+    // loadIndex(): reads index.tsdb, keeping the entries whose blocks are complete on disk.
+    bool loadIndex() {
+        MappedFile file;
+        if (!file.open(path("index.tsdb"))) {
+            return false;
+        }
+        size_t entryCount = file.size() / sizeof(TsdbIndexEntry);
+        index.resize(entryCount);
+        memcpy(index.data(), file.data(), entryCount * sizeof(TsdbIndexEntry));
+        std::error_code error;
+        size_t valid = 0;
+        while (valid < index.size()) {
+            const TsdbIndexEntry& entry = index[valid];
+            uint64_t segmentSize = std::filesystem::file_size(segmentPath(entry.segment), error);
+            if (error || (uint64_t)entry.offset + entry.length > segmentSize ||
+                (valid > 0 && entry.firstTime < index[valid - 1].lastTime)) {
+                break;
+            }
+            valid++;
+        }
+        index.resize(valid);
+        return true;
+    }
+
+    // rebuildIndex(): recovers the index by walking the block headers of every segment.
+    void rebuildIndex() {
+        index.clear();
+        for (uint32_t segment : segmentNumbers()) {
+            MappedFile file;
+            if (!file.open(segmentPath(segment))) {
+                continue;
+            }
+            const uint8_t* data = reinterpret_cast<const uint8_t*>(file.data());
+            size_t offset = 0;
+            std::vector<SensorSample> samples;
+            while (offset + sizeof(TsdbBlockHeader) <= file.size()) {
+                TsdbBlockHeader header;
+                memcpy(&header, data + offset, sizeof(header));
+                uint64_t length = sizeof(header);
+                for (int c = 0; c < TSDB_COLUMNS; c++) {
+                    length += header.columnBytes[c];
+                }
+                samples.clear();
+                if (length > file.size() - offset || !decodeTsdbBlock(data + offset, length, samples)) {
+                    break;
+                }
+                if (index.empty() || header.firstTime >= index.back().lastTime) {
+                    index.push_back(TsdbIndexEntry{header.firstTime, header.lastTime, segment, (uint32_t)offset,
+                                                   (uint32_t)length, header.count});
+                }
+                offset += length;
+            }
+        }
+    }
+
+    void writeIndex() {
+        std::vector<uint8_t> bytes(index.size() * sizeof(TsdbIndexEntry));
+        if (!bytes.empty()) {
+            memcpy(bytes.data(), index.data(), bytes.size());
+        }
+        writeFile(path("index.tsdb"), bytes, options.syncWrites);
+    }
+};
+
+#endif